@@ -36,6 +36,7 @@
 #include <stdlib.h>
 
 #include "oalsound.h"
+#include "softsound.h"
 
 #include "i_module.h"
 #include "cmdlib.h"
@@ -260,11 +261,15 @@ void I_InitSound ()
 		return;
 	}
 
-	// Keep it simple: let everything except "null" init the sound.
+	// Keep it simple: let everything except "null" and "software" init the sound.
 	if (stricmp(snd_backend, "null") == 0)
 	{
 		GSnd = new NullSoundRenderer;
 	}
+	else if (stricmp(snd_backend, "software") == 0)
+	{
+		GSnd = new SoftSoundRenderer;
+	}
 	else
 	{
 		#ifndef NO_OPENAL
@@ -174,6 +174,11 @@ extern bool nosound;
 void I_InitSound ();
 void I_CloseSound();
 
+// Implemented by the platform code. Returns nullptr if the software mixer
+// cannot play through a sound device there.
+class FSoftSoundSink;
+FSoftSoundSink *I_CreateSoundDeviceSink(int rate, int blocksize);
+
 extern ReverbContainer *DefaultEnvironments[26];
 
 bool IsOpenALPresent();
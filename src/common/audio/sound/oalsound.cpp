@@ -2076,20 +2076,7 @@ void OpenALSoundRenderer::LoadReverb(const ReverbContainer *env)
 
 FSoundChan *OpenALSoundRenderer::FindLowestChannel()
 {
-	FSoundChan *schan = soundEngine->GetChannels();
-	FSoundChan *lowest = NULL;
-	while(schan)
-	{
-		if(schan->SysChannel != NULL)
-		{
-			if(!lowest || schan->Priority < lowest->Priority ||
-			   (schan->Priority == lowest->Priority &&
-				schan->DistanceSqr > lowest->DistanceSqr))
-				lowest = schan;
-		}
-		schan = schan->NextChan;
-	}
-	return lowest;
+	return soundEngine->FindLowestChannel();
 }
 
 #endif // NO_OPENAL
@@ -0,0 +1,352 @@
+/*
+** s_channelindex.cpp
+** Priority and per-sound index over the active sound channels
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include "s_soundinternal.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "i_time.h"
+
+//==========================================================================
+//
+// FSoundChanIndex :: Add
+//
+// Channels must be added in the order they are linked into the main
+// channel list, so that the newest one also wins ties in the heap.
+//
+//==========================================================================
+
+void FSoundChanIndex::Add(FSoundChan *chan)
+{
+	assert(chan->HeapIndex == 0);
+	chan->StartSeq = ++NextSeq;
+	Heap.Push(chan);
+	chan->HeapIndex = Heap.Size();
+	SiftUp(Heap.Size() - 1);
+}
+
+//==========================================================================
+//
+// FSoundChanIndex :: Remove
+//
+//==========================================================================
+
+void FSoundChanIndex::Remove(FSoundChan *chan)
+{
+	UnlinkSound(chan);
+	if (chan->HeapIndex == 0)
+		return;
+
+	unsigned i = chan->HeapIndex - 1;
+	chan->HeapIndex = 0;
+	FSoundChan *last;
+	Heap.Pop(last);
+	if (i < Heap.Size())
+	{
+		Place(i, last);
+		SiftUp(i);
+		SiftDown(last->HeapIndex - 1);
+	}
+}
+
+//==========================================================================
+//
+// FSoundChanIndex :: Update
+//
+// Must be called after the priority, the distance or the system channel
+// of an indexed channel changed.
+//
+//==========================================================================
+
+void FSoundChanIndex::Update(FSoundChan *chan)
+{
+	if (chan->HeapIndex == 0)
+		return;
+
+	unsigned i = chan->HeapIndex - 1;
+	SiftUp(i);
+	SiftDown(chan->HeapIndex - 1);
+}
+
+//==========================================================================
+//
+// FSoundChanIndex :: SetSound
+//
+// Files the channel under its current sound ID.
+//
+//==========================================================================
+
+void FSoundChanIndex::SetSound(FSoundChan *chan)
+{
+	int index = chan->SoundID.index();
+	if (chan->IndexedSound == index)
+		return;
+
+	UnlinkSound(chan);
+	if (index <= 0)
+		return;
+
+	if ((unsigned)index >= SoundHeads.Size())
+	{
+		unsigned oldsize = SoundHeads.Size();
+		SoundHeads.Resize(index + 1);
+		for (unsigned i = oldsize; i < SoundHeads.Size(); i++)
+		{
+			SoundHeads[i] = nullptr;
+		}
+	}
+	chan->NextSameSound = SoundHeads[index];
+	chan->PrevSameSound = nullptr;
+	if (chan->NextSameSound != nullptr)
+	{
+		chan->NextSameSound->PrevSameSound = chan;
+	}
+	SoundHeads[index] = chan;
+	chan->IndexedSound = index;
+}
+
+//==========================================================================
+//
+// FSoundChanIndex :: UnlinkSound
+//
+//==========================================================================
+
+void FSoundChanIndex::UnlinkSound(FSoundChan *chan)
+{
+	if (chan->IndexedSound == 0)
+		return;
+
+	if (chan->PrevSameSound != nullptr)
+	{
+		chan->PrevSameSound->NextSameSound = chan->NextSameSound;
+	}
+	else
+	{
+		SoundHeads[chan->IndexedSound] = chan->NextSameSound;
+	}
+	if (chan->NextSameSound != nullptr)
+	{
+		chan->NextSameSound->PrevSameSound = chan->PrevSameSound;
+	}
+	chan->NextSameSound = chan->PrevSameSound = nullptr;
+	chan->IndexedSound = 0;
+}
+
+//==========================================================================
+//
+// FSoundChanIndex :: Heap maintenance
+//
+//==========================================================================
+
+void FSoundChanIndex::Place(unsigned i, FSoundChan *chan)
+{
+	Heap[i] = chan;
+	chan->HeapIndex = i + 1;
+}
+
+void FSoundChanIndex::SiftUp(unsigned i)
+{
+	FSoundChan *chan = Heap[i];
+	while (i > 0)
+	{
+		unsigned parent = (i - 1) / 2;
+		if (!StopsBefore(chan, Heap[parent]))
+			break;
+		Place(i, Heap[parent]);
+		i = parent;
+	}
+	Place(i, chan);
+}
+
+void FSoundChanIndex::SiftDown(unsigned i)
+{
+	FSoundChan *chan = Heap[i];
+	const unsigned size = Heap.Size();
+	while (true)
+	{
+		unsigned child = i * 2 + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && StopsBefore(Heap[child + 1], Heap[child]))
+			child++;
+		if (!StopsBefore(Heap[child], chan))
+			break;
+		Place(i, Heap[child]);
+		i = child;
+	}
+	Place(i, chan);
+}
+
+//==========================================================================
+//
+// CCMD snd_channelbench
+//
+// Compares the old linear scans over the channel list with the index, on
+// a made up set of channels that never reach the sound backend. Both must
+// pick the same channels. Many channels share their priority and some are
+// at distance 0 like 2D sounds, so the tiebreak gets exercised as well.
+//
+// snd_channelbench [channels] [sounds] [iterations]
+//
+//==========================================================================
+
+CCMD(snd_channelbench)
+{
+	const int numchans = argv.argc() > 1 ? clamp(atoi(argv[1]), 16, 65536) : 1024;
+	const int numsounds = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 4096) : 64;
+	const int iterations = argv.argc() > 3 ? clamp(atoi(argv[3]), 1, 10000000) : 100000;
+	const float limit_range = 256.f * 256.f;
+	const int near_limit = 4;
+
+	uint32_t seed;
+	auto rand = [&]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+	auto randf = [&](float range) { return (rand() & 0xffff) * (range / 65536.f); };
+
+	TArray<FSoundChan> chans(numchans, true);
+	TArray<float> distances(numchans, true);
+	FSoundChan *list = nullptr;
+	FSoundChanIndex index;
+
+	seed = 1;
+	for (int i = 0; i < numchans; i++)
+	{
+		FSoundChan *chan = &chans[i];
+		memset(chan, 0, sizeof(*chan));
+		chan->SysChannel = (i & 7) ? chan : nullptr;
+		chan->ChanFlags = (i & 7) ? CHANF_NONE : CHANF_EVICTED;
+		chan->Priority = i % 10 == 0 ? 80 : 0;
+		chan->DistanceSqr = distances[i] = i % 3 == 0 ? 0.f : randf(4096.f) * randf(4096.f);
+		chan->SoundID = FSoundID::fromInt(1 + rand() % numsounds);
+		chan->Point[0] = randf(4096.f);
+		chan->Point[1] = randf(4096.f);
+		chan->Point[2] = randf(256.f);
+		chan->NextChan = list;
+		list = chan;
+		index.Add(chan);
+		index.SetSound(chan);
+	}
+
+	// Voice stealing: stop the lowest channel and give its voice to a new
+	// sound at some other distance.
+	double stealms[2];
+	TArray<int> picks(iterations, true);
+	int mismatches = 0, firstmismatch = -1;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < numchans; i++)
+		{
+			chans[i].DistanceSqr = distances[i];
+			index.Update(&chans[i]);
+		}
+		seed = 2;
+		const uint64_t start = I_nsTime();
+		for (int it = 0; it < iterations; it++)
+		{
+			FSoundChan *lowest = nullptr;
+			if (pass == 0)
+			{
+				for (FSoundChan *chan = list; chan != nullptr; chan = chan->NextChan)
+				{
+					if (chan->SysChannel != nullptr)
+					{
+						if (!lowest || chan->Priority < lowest->Priority ||
+							(chan->Priority == lowest->Priority && chan->DistanceSqr > lowest->DistanceSqr))
+							lowest = chan;
+					}
+				}
+			}
+			else
+			{
+				lowest = index.Lowest();
+			}
+			const int picked = int(lowest - &chans[0]);
+			if (pass == 0)
+			{
+				picks[it] = picked;
+			}
+			else if (picks[it] != picked && mismatches++ == 0)
+			{
+				firstmismatch = it;
+			}
+			const unsigned r = rand();
+			lowest->DistanceSqr = (r & 3) == 0 ? 0.f : randf(4096.f) * randf(4096.f);
+			if (pass == 1) index.Update(lowest);
+		}
+		stealms[pass] = (I_nsTime() - start) * 1e-6;
+	}
+
+	// Sound limiting: count the nearby copies of a sound, like CheckSoundLimit.
+	double limitms[2];
+	int64_t limitsum[2] = { 0, 0 };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		seed = 3;
+		const uint64_t start = I_nsTime();
+		for (int it = 0; it < iterations; it++)
+		{
+			const int sound = 1 + rand() % numsounds;
+			const FVector3 pos(randf(4096.f), randf(4096.f), randf(256.f));
+			int count = 0;
+			FSoundChan *chan = pass == 0 ? list : index.FirstOf(sound);
+			for (; chan != nullptr && count < near_limit; chan = pass == 0 ? chan->NextChan : chan->NextSameSound)
+			{
+				if (!(chan->ChanFlags & CHANF_EVICTED) && chan->SoundID.index() == sound)
+				{
+					FVector3 chanorigin(chan->Point[0], chan->Point[1], chan->Point[2]);
+					if ((chanorigin - pos).LengthSquared() <= limit_range)
+					{
+						count++;
+					}
+				}
+			}
+			limitsum[pass] += count;
+		}
+		limitms[pass] = (I_nsTime() - start) * 1e-6;
+	}
+
+	for (auto &chan : chans)
+	{
+		index.Remove(&chan);
+	}
+
+	Printf("Voice stealing, %d channels, %d steals: scan %.2f ms, heap %.2f ms (%.1fx)\n",
+		numchans, iterations, stealms[0], stealms[1], stealms[0] / max(stealms[1], 1e-6));
+	if (mismatches > 0)
+	{
+		Printf(TEXTCOLOR_RED "Heap picked a different channel than the scan in %d steals, first at steal %d\n", mismatches, firstmismatch);
+	}
+	assert(mismatches == 0);
+	Printf("Sound limit, %d sounds, %d checks: scan %.2f ms, per-sound lists %.2f ms (%.1fx)%s\n",
+		numsounds, iterations, limitms[0], limitms[1], limitms[0] / max(limitms[1], 1e-6),
+		limitsum[0] == limitsum[1] ? "" : ", results differ");
+}
@@ -38,6 +38,7 @@
 
 
 #include "s_soundinternal.h"
+#include "s_soundcache.h"
 #include "m_swap.h"
 #include "superfasthash.h"
 #include "s_music.h"
@@ -93,6 +94,8 @@ void SoundEngine::Clear()
 	UnloadAllSounds();
 	S_sfx.Clear();
 	ClearRandoms();
+	PendingLoads.Clear();
+	SoundDecodeCache.Clear();
 }
 
 //==========================================================================
@@ -143,6 +146,16 @@ void SoundEngine::CacheMarkedSounds()
 		MarkUsed(chan->SoundID);
 	}
 
+	// Get the decoders going first. Everything they are still busy with
+	// once the rest has been loaded is picked up by UpdateSounds.
+	for (unsigned i = 1; i < S_sfx.Size(); ++i)
+	{
+		if (S_sfx[i].bUsed)
+		{
+			PrefetchSound(&S_sfx[i]);
+		}
+	}
+	DeferDecodes = true;
 	for (unsigned i = 1; i < S_sfx.Size(); ++i)
 	{
 		if (S_sfx[i].bUsed)
@@ -150,6 +163,7 @@ void SoundEngine::CacheMarkedSounds()
 			CacheSound(&S_sfx[i]);
 		}
 	}
+	DeferDecodes = false;
 	for (unsigned i = 1; i < S_sfx.Size(); ++i)
 	{
 		if (!S_sfx[i].bUsed && S_sfx[i].link == sfxinfo_t::NO_LINK)
@@ -157,6 +171,90 @@ void SoundEngine::CacheMarkedSounds()
 			UnloadSound(&S_sfx[i]);
 		}
 	}
+	SoundDecodeCache.Trim();
+}
+
+//==========================================================================
+//
+// S_PrefetchSound
+//
+// Queues a sound for background decoding if it is in a format that
+// must go through the decoder.
+//
+//==========================================================================
+
+static bool NeedsDecoder(const TArray<uint8_t>& sfxdata)
+{
+	int size = sfxdata.Size();
+	if (size <= 8)
+	{
+		return false;
+	}
+	int32_t dmxlen = LittleLong(((int32_t *)sfxdata.Data())[1]);
+	if (strncmp((const char *)sfxdata.Data(), "Creative Voice File", 19) == 0)
+	{
+		return false;
+	}
+	if (sfxdata[0] == 3 && sfxdata[1] == 0 && dmxlen <= size - 8)
+	{
+		return false;
+	}
+	return true;
+}
+
+void SoundEngine::PrefetchSound(sfxinfo_t* sfx)
+{
+	if (GSnd == nullptr || GSnd->IsNull() || sfx->bTentative)
+	{
+		return;
+	}
+	while (!sfx->bRandomHeader && isValidSoundId(sfx->link))
+	{
+		sfx = &S_sfx[sfx->link.index()];
+	}
+	if (sfx->bRandomHeader)
+	{
+		const FRandomSoundList* list = &S_rnd[sfx->link.index()];
+		for (unsigned i = 0; i < list->Choices.Size(); ++i)
+		{
+			PrefetchSound(&S_sfx[list->Choices[i].index()]);
+		}
+	}
+	else if (!sfx->data.isValid() && !sfx->bLoadRAW && sfx->lumpnum != sfx_empty && !SoundDecodeCache.IsCached(sfx->lumpnum))
+	{
+		auto sfxdata = ReadSound(sfx->lumpnum);
+		if (NeedsDecoder(sfxdata))
+		{
+			SoundDecodeCache.Prefetch(sfx->lumpnum, std::move(sfxdata));
+		}
+	}
+}
+
+//==========================================================================
+//
+// S_LoadPendingSounds
+//
+// Hands the sounds to the backend whose decoding was not finished when
+// the level got precached.
+//
+//==========================================================================
+
+void SoundEngine::LoadPendingSounds()
+{
+	for (unsigned i = 0; i < PendingLoads.Size(); )
+	{
+		sfxinfo_t* sfx = &S_sfx[PendingLoads[i]];
+		if (SoundDecodeCache.IsPending(sfx->lumpnum))
+		{
+			i++;
+			continue;
+		}
+		if (sfx->bUsed && !sfx->data.isValid())
+		{
+			LoadSound(sfx);
+		}
+		PendingLoads.Delete(i);
+	}
 }
 
 //==========================================================================
@@ -225,6 +323,7 @@ FSoundChan *SoundEngine::GetChannel(void *syschan)
 	}
 	LinkChannel(chan, &Channels);
 	chan->SysChannel = syschan;
+	ChannelIndex.Add(chan);
 	return chan;
 }
 
@@ -239,6 +338,7 @@ FSoundChan *SoundEngine::GetChannel(void *syschan)
 void SoundEngine::ReturnChannel(FSoundChan *chan)
 {
 	UnlinkChannel(chan);
+	ChannelIndex.Remove(chan);
 	memset(chan, 0, sizeof(*chan));
 	LinkChannel(chan, &FreeChannels);
 }
@@ -630,6 +730,8 @@ FSoundChan *SoundEngine::StartSound(int type, const void *source,
 		{
 			chan->Source = source;
 		}
+		ChannelIndex.SetSound(chan);
+		ChannelIndex.Update(chan);
 	}
 
 	return chan;
@@ -702,6 +804,11 @@ void SoundEngine::RestartChannel(FSoundChan *chan)
 	{
 		chan->ChanFlags = oldflags;
 	}
+	else
+	{
+		ChannelIndex.SetSound(chan);
+		ChannelIndex.Update(chan);
+	}
 }
 
 //==========================================================================
@@ -741,35 +848,56 @@ sfxinfo_t *SoundEngine::LoadSound(sfxinfo_t *sfx)
 			}
 		}
 
+		// Don't hold up precaching for a sound that is still being decoded.
+		if (DeferDecodes && SoundDecodeCache.IsPending(sfx->lumpnum))
+		{
+			PendingLoads.Push(int(sfx - &S_sfx[0]));
+			return sfx;
+		}
+
 		DPrintf(DMSG_NOTIFY, "Loading sound \"%s\" (%td)\n", sfx->name.GetChars(), sfx - &S_sfx[0]);
 
-		auto sfxdata = ReadSound(sfx->lumpnum);
-		int size = sfxdata.Size();
-		if (size > 8)
+		// If this was decoded before there is no need to read the lump again.
+		FDecodedSound* decoded = sfx->bLoadRAW ? nullptr : SoundDecodeCache.Find(sfx->lumpnum);
+		if (decoded != nullptr)
 		{
-			int32_t dmxlen = LittleLong(((int32_t *)sfxdata.Data())[1]);
-
-			// If the sound is voc, use the custom loader.
-			if (strncmp ((const char *)sfxdata.Data(), "Creative Voice File", 19) == 0)
-			{
-				sfx->data = GSnd->LoadSoundVoc(sfxdata.Data(), size);
-			}
-			// If the sound is raw, just load it as such.
-			else if (sfx->bLoadRAW)
-			{
-				sfx->data = GSnd->LoadSoundRaw(sfxdata.Data(), size, sfx->RawRate, 1, 8, sfx->LoopStart);
-			}
-			// Otherwise, try the sound as DMX format.
-			else if (((uint8_t *)sfxdata.Data())[0] == 3 && ((uint8_t *)sfxdata.Data())[1] == 0 && dmxlen <= size - 8)
-			{
-				int frequency = LittleShort(((uint16_t *)sfxdata.Data())[1]);
-				if (frequency == 0) frequency = 11025;
-				sfx->data = GSnd->LoadSoundRaw(sfxdata.Data()+8, dmxlen, frequency, 1, 8, sfx->LoopStart);
-			}
-			// If that fails, let the sound system try and figure it out.
-			else
+			sfx->data = GSnd->LoadSoundRaw(decoded->Data.Data(), decoded->Data.Size(), decoded->Frequency, decoded->Channels, decoded->Bits, decoded->LoopStart, decoded->LoopEnd);
+		}
+		else
+		{
+			auto sfxdata = ReadSound(sfx->lumpnum);
+			int size = sfxdata.Size();
+			if (size > 8)
 			{
-				sfx->data = GSnd->LoadSound(sfxdata.Data(), size);
+				int32_t dmxlen = LittleLong(((int32_t *)sfxdata.Data())[1]);
+
+				// If the sound is voc, use the custom loader.
+				if (strncmp ((const char *)sfxdata.Data(), "Creative Voice File", 19) == 0)
+				{
+					sfx->data = GSnd->LoadSoundVoc(sfxdata.Data(), size);
+				}
+				// If the sound is raw, just load it as such.
+				else if (sfx->bLoadRAW)
+				{
+					sfx->data = GSnd->LoadSoundRaw(sfxdata.Data(), size, sfx->RawRate, 1, 8, sfx->LoopStart);
+				}
+				// Otherwise, try the sound as DMX format.
+				else if (((uint8_t *)sfxdata.Data())[0] == 3 && ((uint8_t *)sfxdata.Data())[1] == 0 && dmxlen <= size - 8)
+				{
+					int frequency = LittleShort(((uint16_t *)sfxdata.Data())[1]);
+					if (frequency == 0) frequency = 11025;
+					sfx->data = GSnd->LoadSoundRaw(sfxdata.Data()+8, dmxlen, frequency, 1, 8, sfx->LoopStart);
+				}
+				// Otherwise decode it and keep the result around for the next time.
+				else if ((decoded = SoundDecodeCache.Decode(sfx->lumpnum, sfxdata)) != nullptr)
+				{
+					sfx->data = GSnd->LoadSoundRaw(decoded->Data.Data(), decoded->Data.Size(), decoded->Frequency, decoded->Channels, decoded->Bits, decoded->LoopStart, decoded->LoopEnd);
+				}
+				// If that fails, let the sound system try and figure it out.
+				else
+				{
+					sfx->data = GSnd->LoadSound(sfxdata.Data(), size);
+				}
 			}
 		}
 
@@ -829,10 +957,11 @@ bool SoundEngine::CheckSoundLimit(sfxinfo_t *sfx, const FVector3 &pos, int near_
 	FSoundChan *chan;
 	int count;
 
-	for (chan = Channels, count = 0; chan != NULL && count < near_limit; chan = chan->NextChan)
+	// Only channels playing this very sound can count.
+	for (chan = ChannelIndex.FirstOf(int(sfx - &S_sfx[0])), count = 0; chan != NULL && count < near_limit; chan = chan->NextSameSound)
 	{
 		if (chan->ChanFlags & CHANF_FORGETTABLE) continue;
-		if (!(chan->ChanFlags & CHANF_EVICTED) && &S_sfx[chan->SoundID.index()] == sfx)
+		if (!(chan->ChanFlags & CHANF_EVICTED))
 		{
 			FVector3 chanorigin;
 
@@ -1268,6 +1397,7 @@ void SoundEngine::UpdateSounds(int time)
 			if (ValidatePosVel(chan, pos, vel))
 			{
 				GSnd->UpdateSoundParams3D(&listener, chan, !!(chan->ChanFlags & CHANF_AREA), pos, vel);
+				ChannelIndex.Update(chan);
 			}
 		}
 		chan->ChanFlags &= ~CHANF_JUSTSTARTED;
@@ -1276,6 +1406,11 @@ void SoundEngine::UpdateSounds(int time)
 	GSnd->UpdateListener(&listener);
 	GSnd->UpdateSounds();
 
+	if (PendingLoads.Size() > 0)
+	{
+		LoadPendingSounds();
+	}
+
 	if (time >= RestartEvictionsAt)
 	{
 		RestartEvictionsAt = 0;
@@ -1368,6 +1503,7 @@ void SoundEngine::ChannelEnded(FISoundChannel *ichan)
 		{
 			schan->ChanFlags |= CHANF_EVICTED;
 			schan->SysChannel = NULL;
+			ChannelIndex.Update(schan);
 		}
 
 	}
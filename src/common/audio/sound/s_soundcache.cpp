@@ -0,0 +1,480 @@
+/*
+** s_soundcache.cpp
+** Background decoding and caching of compressed sound effects
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Only the decoding runs on the workers. Reading the lump and handing the
+** PCM data to the sound backend stay on the game thread.
+*/
+
+#include <zmusic.h>
+
+#include "s_soundcache.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "printf.h"
+#include "i_time.h"
+#include "cmdlib.h"
+
+CVAR(Int, snd_decodecachesize, 64, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// in MB
+
+FSoundDecodeCache SoundDecodeCache;
+
+//==========================================================================
+//
+// FSoundDecodeCache :: ~FSoundDecodeCache
+//
+//==========================================================================
+
+FSoundDecodeCache::~FSoundDecodeCache()
+{
+	Clear();
+	StopWorkers();
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: DecodeLump
+//
+// Does the same as OpenALSoundRenderer::LoadSound, except for uploading
+// the data. Runs on the worker threads, so it must not touch anything
+// besides its arguments.
+//
+//==========================================================================
+
+void FSoundDecodeCache::DecodeLump(const TArray<uint8_t> &data, FDecodedSound &sound)
+{
+	ChannelConfig chans;
+	SampleType type;
+	int srate;
+	uint32_t loop_start = 0, loop_end = ~0u;
+	zmusic_bool startass = false, endass = false;
+
+	sound.Valid = false;
+	FindLoopTags(data.Data(), data.Size(), &loop_start, &startass, &loop_end, &endass);
+	auto decoder = CreateDecoder(data.Data(), data.Size(), true);
+	if (!decoder)
+		return;
+
+	SoundDecoder_GetInfo(decoder, &srate, &chans, &type);
+	int channels = chans == ChannelConfig_Mono ? 1 : chans == ChannelConfig_Stereo ? 2 : 0;
+	int bits = type == SampleType_UInt8 ? 8 : type == SampleType_Int16 ? 16 : 0;
+	if (channels == 0 || bits == 0)
+	{
+		// Let the backend complain about this.
+		SoundDecoder_Close(decoder);
+		return;
+	}
+
+	TArray<uint8_t> &pcm = sound.Data;
+	unsigned total = 0;
+	unsigned got;
+
+	pcm.Resize(32768);
+	while ((got = (unsigned)SoundDecoder_Read(decoder, (char*)&pcm[total], pcm.Size() - total)) > 0)
+	{
+		total += got;
+		pcm.Resize(total * 2);
+	}
+	SoundDecoder_Close(decoder);
+	pcm.Resize(total);
+	pcm.ShrinkToFit();
+	if (total == 0)
+	{
+		return;
+	}
+
+	if (!startass) loop_start = Scale(loop_start, srate, 1000);
+	if (!endass && loop_end != ~0u) loop_end = Scale(loop_end, srate, 1000);
+	const uint32_t samples = total / (channels * bits / 8);
+	if (loop_start > samples) loop_start = 0;
+	if (loop_end > samples) loop_end = samples;
+
+	sound.Frequency = srate;
+	sound.Channels = channels;
+	sound.Bits = bits;
+	// Passing a loop that spans the whole sound would only make LoadSoundRaw
+	// complain if the backend can't do loop points.
+	if (loop_end > loop_start && (loop_start > 0 || loop_end < samples))
+	{
+		sound.LoopStart = loop_start;
+		sound.LoopEnd = loop_end;
+	}
+	else
+	{
+		sound.LoopStart = 0;
+		sound.LoopEnd = -1;
+	}
+	sound.Valid = true;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: StartWorkers
+//
+//==========================================================================
+
+void FSoundDecodeCache::StartWorkers()
+{
+	if (Workers.Size() > 0)
+		return;
+
+	Quit = false;
+	int count = clamp<int>(std::thread::hardware_concurrency() / 2, 1, 4);
+	for (int i = 0; i < count; i++)
+	{
+		Workers.Push(std::thread([this]() { WorkerProc(); }));
+	}
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: StopWorkers
+//
+//==========================================================================
+
+void FSoundDecodeCache::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Quit = true;
+	}
+	WorkReady.notify_all();
+	for (auto &thread : Workers)
+	{
+		thread.join();
+	}
+	Workers.Clear();
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: WorkerProc
+//
+//==========================================================================
+
+void FSoundDecodeCache::WorkerProc()
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	while (true)
+	{
+		WorkReady.wait(lock, [this]() { return Quit || Queue.Size() > 0; });
+		if (Quit)
+			break;
+
+		FEntry *entry = Queue[0];
+		Queue.Delete(0);
+		entry->State = Decoding;
+		Busy++;
+		lock.unlock();
+
+		uint64_t start = I_nsTime();
+		DecodeLump(entry->Source, entry->Sound);
+		uint64_t time = I_nsTime() - start;
+
+		lock.lock();
+		Busy--;
+		Finished(entry, time, true);
+	}
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Finished
+//
+// The lock must be held.
+//
+//==========================================================================
+
+void FSoundDecodeCache::Finished(FEntry *entry, uint64_t time, bool background)
+{
+	entry->Source.Reset();
+	entry->State = Ready;
+	Memory += entry->Sound.Data.Size();
+	if (background)
+	{
+		BackgroundDecodes++;
+		BackgroundTime += time;
+	}
+	else
+	{
+		SyncDecodes++;
+		SyncTime += time;
+	}
+	WorkDone.notify_all();
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Prefetch
+//
+// Queues a lump for decoding unless it is already known.
+//
+//==========================================================================
+
+void FSoundDecodeCache::Prefetch(int lumpnum, TArray<uint8_t> &&data)
+{
+	StartWorkers();
+
+	std::lock_guard<std::mutex> lock(Lock);
+	if (Entries.CheckKey(lumpnum) != nullptr)
+		return;
+
+	auto entry = new FEntry;
+	entry->Source = std::move(data);
+	entry->State = Queued;
+	entry->LastUse = ++UseCounter;
+	Entries.Insert(lumpnum, entry);
+	Queue.Push(entry);
+	WorkReady.notify_one();
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: IsPending
+//
+//==========================================================================
+
+bool FSoundDecodeCache::IsPending(int lumpnum)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	auto pentry = Entries.CheckKey(lumpnum);
+	return pentry != nullptr && (*pentry)->State != Ready;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: IsCached
+//
+//==========================================================================
+
+bool FSoundDecodeCache::IsCached(int lumpnum)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	return Entries.CheckKey(lumpnum) != nullptr;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Find
+//
+// Returns the decoded sound for a lump, or nullptr if it was never queued
+// or could not be decoded. If it is still being decoded this waits for it.
+// If it is still queued it gets decoded right here, which is never slower
+// than waiting for a worker to pick it up.
+//
+//==========================================================================
+
+FDecodedSound *FSoundDecodeCache::Find(int lumpnum)
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	auto pentry = Entries.CheckKey(lumpnum);
+	if (pentry == nullptr)
+	{
+		return nullptr;
+	}
+
+	FEntry *entry = *pentry;
+	if (entry->State == Queued)
+	{
+		Queue.Delete(Queue.Find(entry));
+		entry->State = Decoding;
+		lock.unlock();
+
+		uint64_t start = I_nsTime();
+		DecodeLump(entry->Source, entry->Sound);
+		uint64_t time = I_nsTime() - start;
+
+		lock.lock();
+		Finished(entry, time, false);
+		Waits++;
+	}
+	else if (entry->State == Decoding)
+	{
+		WorkDone.wait(lock, [=]() { return entry->State == Ready; });
+		Waits++;
+	}
+	else
+	{
+		Hits++;
+	}
+	entry->LastUse = ++UseCounter;
+	return entry->Sound.Valid ? &entry->Sound : nullptr;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Decode
+//
+// For sounds that weren't precached: decode them now and keep the result.
+//
+//==========================================================================
+
+FDecodedSound *FSoundDecodeCache::Decode(int lumpnum, const TArray<uint8_t> &data)
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	auto pentry = Entries.CheckKey(lumpnum);
+	if (pentry != nullptr)
+	{
+		// Only happens for lumps the decoder failed on.
+		lock.unlock();
+		return Find(lumpnum);
+	}
+	Misses++;
+
+	auto entry = new FEntry;
+	entry->State = Decoding;
+	entry->LastUse = ++UseCounter;
+	Entries.Insert(lumpnum, entry);
+	lock.unlock();
+
+	uint64_t start = I_nsTime();
+	DecodeLump(data, entry->Sound);
+	uint64_t time = I_nsTime() - start;
+
+	lock.lock();
+	Finished(entry, time, false);
+	lock.unlock();
+
+	Trim();
+	return entry->Sound.Valid ? &entry->Sound : nullptr;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Trim
+//
+// Throws out the least recently used sounds until the cache fits into
+// snd_decodecachesize again. The most recent entry is always kept because
+// its data is probably just being passed to the backend.
+//
+//==========================================================================
+
+void FSoundDecodeCache::Trim()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	size_t budget = (size_t)max<int>(snd_decodecachesize, 0) << 20;
+
+	while (Memory > budget)
+	{
+		TMap<int, FEntry *>::Iterator it(Entries);
+		TMap<int, FEntry *>::Pair *pair;
+		int oldest = -1;
+		uint64_t oldestuse = UseCounter;
+
+		while (it.NextPair(pair))
+		{
+			FEntry *entry = pair->Value;
+			if (entry->State == Ready && entry->Sound.Data.Size() > 0 && entry->LastUse < oldestuse)
+			{
+				oldest = pair->Key;
+				oldestuse = entry->LastUse;
+			}
+		}
+		if (oldest == -1)
+			break;
+
+		FEntry *entry = Entries[oldest];
+		Memory -= entry->Sound.Data.Size();
+		Entries.Remove(oldest);
+		delete entry;
+		Evictions++;
+	}
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: Clear
+//
+// Lump numbers become meaningless when the file system gets reinitialized,
+// so everything must go.
+//
+//==========================================================================
+
+void FSoundDecodeCache::Clear()
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	Queue.Clear();
+	WorkDone.wait(lock, [this]() { return Busy == 0; });
+
+	TMap<int, FEntry *>::Iterator it(Entries);
+	TMap<int, FEntry *>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		delete pair->Value;
+	}
+	Entries.Clear();
+	Memory = 0;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: GetStats
+//
+//==========================================================================
+
+FString FSoundDecodeCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	unsigned lookups = Hits + Waits + Misses;
+	FString out;
+	out.Format("Cache: %u sounds, %.1f / %d MB, %u queued, %d decoding, %u evicted\n"
+		"Lookups: %u, hits %u (%.1f%%), waited %u, misses %u\n"
+		"Decode: %u background in %.1f ms, %u on the game thread in %.1f ms",
+		Entries.CountUsed(), Memory / 1048576., *snd_decodecachesize, Queue.Size(), Busy, Evictions,
+		lookups, Hits, lookups ? Hits * 100. / lookups : 0., Waits, Misses,
+		BackgroundDecodes, BackgroundTime / 1e6, SyncDecodes, SyncTime / 1e6);
+	return out;
+}
+
+//==========================================================================
+//
+// FSoundDecodeCache :: ResetStats
+//
+//==========================================================================
+
+void FSoundDecodeCache::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Hits = Waits = Misses = Evictions = 0;
+	BackgroundDecodes = SyncDecodes = 0;
+	BackgroundTime = SyncTime = 0;
+}
+
+ADD_STAT(soundcache)
+{
+	return SoundDecodeCache.GetStats();
+}
+
+CCMD(snd_resetcachestats)
+{
+	SoundDecodeCache.ResetStats();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "tarray.h"
+#include "zstring.h"
+
+// A compressed sound lump (Ogg, FLAC, MP3, ...) decoded to 8 or 16 bit PCM,
+// ready to be passed to SoundRenderer::LoadSoundRaw.
+struct FDecodedSound
+{
+	TArray<uint8_t> Data;
+	int Frequency = 0;
+	int Channels = 0;
+	int Bits = 0;
+	int LoopStart = 0;
+	int LoopEnd = -1;
+	bool Valid = false;		// false if the decoder could not handle the lump
+};
+
+// Keeps the decoded sounds around across levels and decodes the sounds
+// a level needs on worker threads, so that neither precaching nor the first
+// play of a sound has to wait for the decoder. The cache is keyed by lump
+// number and only touched by the game thread, except for the entries the
+// workers are decoding.
+class FSoundDecodeCache
+{
+public:
+	~FSoundDecodeCache();
+
+	void Prefetch(int lumpnum, TArray<uint8_t> &&data);
+	bool IsPending(int lumpnum);
+	bool IsCached(int lumpnum);
+	FDecodedSound *Find(int lumpnum);
+	FDecodedSound *Decode(int lumpnum, const TArray<uint8_t> &data);
+	void Trim();
+	void Clear();
+
+	FString GetStats();
+	void ResetStats();
+
+private:
+	enum EState
+	{
+		Queued,
+		Decoding,
+		Ready
+	};
+
+	struct FEntry
+	{
+		FDecodedSound Sound;
+		TArray<uint8_t> Source;		// the lump data while the sound is queued
+		EState State;
+		uint64_t LastUse;
+	};
+
+	static void DecodeLump(const TArray<uint8_t> &data, FDecodedSound &sound);
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerProc();
+	void Finished(FEntry *entry, uint64_t time, bool background);
+
+	std::mutex Lock;
+	std::condition_variable WorkReady;
+	std::condition_variable WorkDone;
+	TArray<std::thread> Workers;
+	bool Quit = false;
+
+	TMap<int, FEntry *> Entries;
+	TArray<FEntry *> Queue;
+	int Busy = 0;
+	uint64_t UseCounter = 0;
+	size_t Memory = 0;
+
+	unsigned Hits = 0;
+	unsigned Waits = 0;
+	unsigned Misses = 0;
+	unsigned Evictions = 0;
+	unsigned BackgroundDecodes = 0;
+	unsigned SyncDecodes = 0;
+	uint64_t BackgroundTime = 0;
+	uint64_t SyncTime = 0;
+};
+
+extern FSoundDecodeCache SoundDecodeCache;
@@ -127,6 +127,61 @@ struct FSoundChan : public FISoundChannel
 	float		LimitRange;
 	const void *Source;
 	float Point[3];	// Sound is not attached to any source.
+
+	// Bookkeeping for FSoundChanIndex. All 0 means not indexed.
+	FSoundChan	*NextSameSound;
+	FSoundChan	*PrevSameSound;
+	int			IndexedSound;
+	unsigned	HeapIndex;	// 1-based
+	uint64_t	StartSeq;	// order of Add calls, to break ties
+};
+
+// Index over the active channels, so that neither the sound limit checks
+// nor the backends looking for a voice to steal need to scan all of them.
+// The heap keeps the channel that should be stopped first on top: playing
+// before evicted ones, then lowest priority, then farthest away, then the
+// newest one, which is the channel a scan of the main channel list would
+// have found first. Whenever any of these change, Update must be called.
+// The per-sound lists keep the newest channel first, like the main
+// channel list.
+class FSoundChanIndex
+{
+public:
+	void Add(FSoundChan *chan);
+	void Remove(FSoundChan *chan);
+	void Update(FSoundChan *chan);
+	void SetSound(FSoundChan *chan);
+
+	FSoundChan *Lowest() const
+	{
+		return Heap.Size() > 0 && Heap[0]->SysChannel != nullptr ? Heap[0] : nullptr;
+	}
+	FSoundChan *FirstOf(int soundindex) const
+	{
+		return (unsigned)soundindex < SoundHeads.Size() ? SoundHeads[soundindex] : nullptr;
+	}
+	unsigned Size() const
+	{
+		return Heap.Size();
+	}
+
+	static bool StopsBefore(const FSoundChan *a, const FSoundChan *b)
+	{
+		if ((a->SysChannel != nullptr) != (b->SysChannel != nullptr)) return a->SysChannel != nullptr;
+		if (a->Priority != b->Priority) return a->Priority < b->Priority;
+		if (a->DistanceSqr != b->DistanceSqr) return a->DistanceSqr > b->DistanceSqr;
+		return a->StartSeq > b->StartSeq;
+	}
+
+private:
+	void UnlinkSound(FSoundChan *chan);
+	void Place(unsigned i, FSoundChan *chan);
+	void SiftUp(unsigned i);
+	void SiftDown(unsigned i);
+
+	TArray<FSoundChan *> Heap;
+	TArray<FSoundChan *> SoundHeads;
+	uint64_t NextSeq = 0;
 };
 
 
@@ -196,6 +251,11 @@ protected:
 	TMap<int, FSoundID> ResIdMap;
 	TArray<FRandomSoundList> S_rnd;
 	bool blockNewSounds = false;
+	FSoundChanIndex ChannelIndex;
+
+	// Sounds whose decoding was still running when the level was precached.
+	TArray<int> PendingLoads;
+	bool DeferDecodes = false;
 
 private:
 	void LinkChannel(FSoundChan* chan, FSoundChan** head);
@@ -216,6 +276,9 @@ private:
 	bool CheckSingular(FSoundID sound_id);
 	virtual TArray<uint8_t> ReadSound(int lumpnum) = 0;
 
+	void PrefetchSound(sfxinfo_t* sfx);
+	void LoadPendingSounds();
+
 protected:
 	virtual bool CheckSoundLimit(sfxinfo_t* sfx, const FVector3& pos, int near_limit, float limit_range, int sourcetype, const void* actor, int channel, float attenuation);
 	virtual FSoundID ResolveSound(const void *ent, int srctype, FSoundID soundid, float &attenuation);
@@ -269,6 +332,12 @@ public:
 	void SetVolume(FSoundChan* chan, float vol);
 
 	FSoundChan* GetChannel(void* syschan);
+	// Must be called after a channel's sound or priority was changed from outside.
+	void ReindexChannel(FSoundChan* chan)
+	{
+		ChannelIndex.SetSound(chan);
+		ChannelIndex.Update(chan);
+	}
 	void RestoreEvictedChannels();
 	void CalcPosVel(FSoundChan* chan, FVector3* pos, FVector3* vel);
 
@@ -335,6 +404,11 @@ public:
 	{
 		return Channels;
 	}
+	// The channel a backend should stop first when it runs out of voices.
+	FSoundChan* FindLowestChannel() const
+	{
+		return ChannelIndex.Lowest();
+	}
 	const char *GetSoundName(FSoundID id)
 	{
 		return !id.isvalid() ? "" : S_sfx[id.index()].name.GetChars();
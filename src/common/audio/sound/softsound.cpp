@@ -0,0 +1,1536 @@
+/*
+** softsound.cpp
+** System interface for sound; mixes all channels in software
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** This is not meant to replace OpenAL for normal play. It gives us a
+** backend that can also run without any audio device, so sound can be
+** captured to a WAV file or discarded for automated tests, and its cost
+** does not grow with a per-source overhead when snd_channels is raised.
+** For normal play the output goes to the sound device where the platform
+** code provides a sink for it (SDL); elsewhere this backend refuses to
+** start without snd_softsink set to "null" or "wav".
+*/
+
+#include <chrono>
+#include <math.h>
+
+#ifndef NO_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "c_cvars.h"
+#include "softsound.h"
+#include "c_dispatch.h"
+#include "v_text.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "i_time.h"
+#include "m_fixed.h"
+#include "m_swap.h"
+#include "printf.h"
+#include <zmusic.h>
+
+EXTERN_CVAR(Int, snd_channels)
+EXTERN_CVAR(Int, snd_samplerate)
+EXTERN_CVAR(Int, snd_buffersize)
+EXTERN_CVAR(Bool, snd_waterreverb)
+
+CVAR(String, snd_softsink, "device", CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(String, snd_softwavefile, "soundout.wav", CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+extern ReverbContainer *ForcedEnvironment;
+const char *GetSampleTypeName(SampleType type);
+const char *GetChannelConfigName(ChannelConfig chan);
+
+#define AREA_SOUND_RADIUS	(32.f)
+
+#define PITCH_MULT			(0.7937005f) /* Approx. 4 semitones lower; what Nash suggested */
+
+#define FRACUNIT64			(4294967296.0)
+
+static inline float mB2Gain(float x)
+{
+	return powf(10.f, x / 2000.f);
+}
+
+//==========================================================================
+//
+// Resamplers
+//
+// All voices are resampled with linear interpolation straight into the
+// planar mix buffers. The gain is ramped across the block to avoid
+// zipper noise when volumes or panning change.
+//
+//==========================================================================
+
+static int ResampleMono(const float *src, uint64_t &pos, uint64_t step, int frames,
+	float *outl, float *outr, float gl, float gr, float dgl, float dgr, bool simd)
+{
+	int i = 0;
+#ifndef NO_SSE
+	if (simd)
+	{
+		__m128 vgl = _mm_setr_ps(gl, gl + dgl, gl + 2 * dgl, gl + 3 * dgl);
+		__m128 vgr = _mm_setr_ps(gr, gr + dgr, gr + 2 * dgr, gr + 3 * dgr);
+		const __m128 vdgl = _mm_set1_ps(4 * dgl);
+		const __m128 vdgr = _mm_set1_ps(4 * dgr);
+		const __m128 fracscale = _mm_set1_ps(float(1. / FRACUNIT64));
+		for (; i + 4 <= frames; i += 4)
+		{
+			alignas(16) float s0[4], s1[4], frac[4];
+			for (int k = 0; k < 4; k++)
+			{
+				const uint32_t idx = uint32_t(pos >> 32);
+				s0[k] = src[idx];
+				s1[k] = src[idx + 1];
+				frac[k] = float(uint32_t(pos));
+				pos += step;
+			}
+			__m128 a = _mm_load_ps(s0);
+			__m128 b = _mm_load_ps(s1);
+			__m128 f = _mm_mul_ps(_mm_load_ps(frac), fracscale);
+			__m128 v = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+			_mm_storeu_ps(outl + i, _mm_add_ps(_mm_loadu_ps(outl + i), _mm_mul_ps(v, vgl)));
+			_mm_storeu_ps(outr + i, _mm_add_ps(_mm_loadu_ps(outr + i), _mm_mul_ps(v, vgr)));
+			vgl = _mm_add_ps(vgl, vdgl);
+			vgr = _mm_add_ps(vgr, vdgr);
+		}
+		gl += dgl * i;
+		gr += dgr * i;
+	}
+#endif
+	for (; i < frames; i++)
+	{
+		const uint32_t idx = uint32_t(pos >> 32);
+		const float frac = float(uint32_t(pos) * (1. / FRACUNIT64));
+		const float v = src[idx] + (src[idx + 1] - src[idx]) * frac;
+		outl[i] += v * gl;
+		outr[i] += v * gr;
+		gl += dgl;
+		gr += dgr;
+		pos += step;
+	}
+	return frames;
+}
+
+static int ResampleStereo(const float *src, uint64_t &pos, uint64_t step, int frames,
+	float *outl, float *outr, float gl, float gr, float dgl, float dgr, bool simd)
+{
+	int i = 0;
+#ifndef NO_SSE
+	if (simd)
+	{
+		__m128 vgl = _mm_setr_ps(gl, gl + dgl, gl + 2 * dgl, gl + 3 * dgl);
+		__m128 vgr = _mm_setr_ps(gr, gr + dgr, gr + 2 * dgr, gr + 3 * dgr);
+		const __m128 vdgl = _mm_set1_ps(4 * dgl);
+		const __m128 vdgr = _mm_set1_ps(4 * dgr);
+		const __m128 fracscale = _mm_set1_ps(float(1. / FRACUNIT64));
+		for (; i + 4 <= frames; i += 4)
+		{
+			alignas(16) float l0[4], l1[4], r0[4], r1[4], frac[4];
+			for (int k = 0; k < 4; k++)
+			{
+				const uint32_t idx = uint32_t(pos >> 32) * 2;
+				l0[k] = src[idx];
+				r0[k] = src[idx + 1];
+				l1[k] = src[idx + 2];
+				r1[k] = src[idx + 3];
+				frac[k] = float(uint32_t(pos));
+				pos += step;
+			}
+			__m128 f = _mm_mul_ps(_mm_load_ps(frac), fracscale);
+			__m128 a = _mm_load_ps(l0);
+			__m128 l = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(l1), a), f));
+			a = _mm_load_ps(r0);
+			__m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(r1), a), f));
+			_mm_storeu_ps(outl + i, _mm_add_ps(_mm_loadu_ps(outl + i), _mm_mul_ps(l, vgl)));
+			_mm_storeu_ps(outr + i, _mm_add_ps(_mm_loadu_ps(outr + i), _mm_mul_ps(r, vgr)));
+			vgl = _mm_add_ps(vgl, vdgl);
+			vgr = _mm_add_ps(vgr, vdgr);
+		}
+		gl += dgl * i;
+		gr += dgr * i;
+	}
+#endif
+	for (; i < frames; i++)
+	{
+		const uint32_t idx = uint32_t(pos >> 32) * 2;
+		const float frac = float(uint32_t(pos) * (1. / FRACUNIT64));
+		outl[i] += (src[idx] + (src[idx + 2] - src[idx]) * frac) * gl;
+		outr[i] += (src[idx + 1] + (src[idx + 3] - src[idx + 1]) * frac) * gr;
+		gl += dgl;
+		gr += dgr;
+		pos += step;
+	}
+	return frames;
+}
+
+//==========================================================================
+//
+// FSoftMixer :: Init
+//
+//==========================================================================
+
+void FSoftMixer::Init(int rate, int blocksize)
+{
+	Rate = rate;
+	DryL.Resize(blocksize);
+	DryR.Resize(blocksize);
+	WetL.Resize(blocksize);
+	WetR.Resize(blocksize);
+
+	// Freeverb's comb lengths at 44.1 kHz, with the usual stereo spread.
+	static const int comblengths[4] = { 1116, 1188, 1277, 1356 };
+	for (int ch = 0; ch < 2; ch++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			FComb &comb = Combs[ch][i];
+			comb.Buffer.Resize(unsigned((comblengths[i] + ch * 23) * (double)rate / 44100));
+			memset(comb.Buffer.Data(), 0, comb.Buffer.Size() * sizeof(float));
+			comb.Index = 0;
+			comb.Feedback = 0;
+			comb.Store = 0;
+		}
+	}
+}
+
+//==========================================================================
+//
+// FSoftMixer :: SetReverb
+//
+// Derives the parameters of the comb filter reverb from an environment.
+// This is only a rough approximation of EAX, but it makes rooms sound
+// different from each other.
+//
+//==========================================================================
+
+void FSoftMixer::SetReverb(const REVERB_PROPERTIES *props)
+{
+	if (props == nullptr)
+	{
+		ReverbActive = false;
+		return;
+	}
+	ReverbGain = clamp(mB2Gain(float(props->Room + props->Reverb)), 0.f, 1.f) * 0.25f;
+	ReverbDamp = clamp(1.f - props->DecayHFRatio * 0.5f, 0.f, 0.9f);
+	const float decay = max(props->DecayTime, 0.1f);
+	for (auto &channel : Combs)
+	{
+		for (auto &comb : channel)
+		{
+			// Feedback that decays by 60 dB in DecayTime seconds.
+			comb.Feedback = powf(10.f, -3.f * comb.Buffer.Size() / (decay * Rate));
+		}
+	}
+	ReverbActive = ReverbGain > 0.0001f;
+}
+
+//==========================================================================
+//
+// FSoftMixer :: Begin
+//
+// Clears the mix buffers for a new block.
+//
+//==========================================================================
+
+void FSoftMixer::Begin(int frames)
+{
+	assert(frames <= (int)DryL.Size());
+	memset(DryL.Data(), 0, frames * sizeof(float));
+	memset(DryR.Data(), 0, frames * sizeof(float));
+	memset(WetL.Data(), 0, frames * sizeof(float));
+	memset(WetR.Data(), 0, frames * sizeof(float));
+}
+
+//==========================================================================
+//
+// FSoftMixer :: MixBuffer
+//
+// Resamples part of a plain buffer into the dry mix. Used for streams.
+// Mixes until either frames are done or pos reaches end and returns with
+// pos updated.
+//
+//==========================================================================
+
+void FSoftMixer::MixBuffer(const float *src, int channels, uint64_t &pos, uint64_t step, uint32_t end, int frames, float gain)
+{
+	if (pos >= (uint64_t(end) << 32))
+	{
+		return;
+	}
+	const uint64_t avail = ((uint64_t(end) << 32) - pos + step - 1) / step;
+	const int count = (int)min<uint64_t>(frames, avail);
+	if (channels == 1)
+	{
+		ResampleMono(src, pos, step, count, DryL.Data(), DryR.Data(), gain, gain, 0, 0, UseSIMD);
+	}
+	else
+	{
+		ResampleStereo(src, pos, step, count, DryL.Data(), DryR.Data(), gain, gain, 0, 0, UseSIMD);
+	}
+}
+
+//==========================================================================
+//
+// FSoftMixer :: MixVoice
+//
+// Mixes one block of a voice. Returns false if the voice reached its end.
+//
+//==========================================================================
+
+bool FSoftMixer::MixVoice(FSoftVoice &voice, int frames, float pitchmul, float gain)
+{
+	FSoftSample *sample = voice.Sample;
+	if (sample == nullptr || sample->Frames == 0)
+	{
+		return false;
+	}
+
+	float *outl = voice.Reverb ? WetL.Data() : DryL.Data();
+	float *outr = voice.Reverb ? WetR.Data() : DryR.Data();
+	const uint64_t step = max<uint64_t>(1, uint64_t(voice.Pitch * pitchmul * sample->Frequency / Rate * FRACUNIT64));
+	const float targetl = voice.GainL * gain;
+	const float targetr = voice.GainR * gain;
+	const float dgl = (targetl - voice.CurGainL) / frames;
+	const float dgr = (targetr - voice.CurGainR) / frames;
+	const bool loop = voice.Looping && sample->LoopEnd > sample->LoopStart;
+	const uint32_t end = loop ? sample->LoopEnd : sample->Frames;
+	bool playing = true;
+	int done = 0;
+
+	while (done < frames)
+	{
+		if (voice.Pos >= (uint64_t(end) << 32))
+		{
+			if (!loop)
+			{
+				playing = false;
+				break;
+			}
+			voice.Pos -= uint64_t(end - sample->LoopStart) << 32;
+			continue;
+		}
+		const uint64_t avail = ((uint64_t(end) << 32) - voice.Pos + step - 1) / step;
+		const int count = (int)min<uint64_t>(frames - done, avail);
+		const float gl = voice.CurGainL + dgl * done;
+		const float gr = voice.CurGainR + dgr * done;
+		if (sample->Channels == 1)
+		{
+			ResampleMono(sample->Data.Data(), voice.Pos, step, count, outl + done, outr + done, gl, gr, dgl, dgr, UseSIMD);
+		}
+		else
+		{
+			ResampleStereo(sample->Data.Data(), voice.Pos, step, count, outl + done, outr + done, gl, gr, dgl, dgr, UseSIMD);
+		}
+		done += count;
+	}
+	voice.CurGainL = targetl;
+	voice.CurGainR = targetr;
+	return playing;
+}
+
+//==========================================================================
+//
+// FSoftMixer :: ApplyReverb
+//
+// Runs the reverb send through parallel low-passed comb filters and adds
+// the result to the dry mix, together with the direct signal.
+//
+//==========================================================================
+
+void FSoftMixer::ApplyReverb(int frames)
+{
+	float *wet[2] = { WetL.Data(), WetR.Data() };
+	float *dry[2] = { DryL.Data(), DryR.Data() };
+
+	for (int ch = 0; ch < 2; ch++)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			const float in = (wet[0][i] + wet[1][i]) * 0.5f;
+			float out = 0;
+			for (auto &comb : Combs[ch])
+			{
+				float &delayed = comb.Buffer[comb.Index];
+				out += delayed;
+				comb.Store = delayed * (1.f - ReverbDamp) + comb.Store * ReverbDamp;
+				delayed = in + comb.Store * comb.Feedback;
+				if (++comb.Index == comb.Buffer.Size()) comb.Index = 0;
+			}
+			dry[ch][i] += out * ReverbGain;
+		}
+	}
+}
+
+//==========================================================================
+//
+// FSoftMixer :: Finish
+//
+// Combines the mix buffers into interleaved stereo output.
+//
+//==========================================================================
+
+void FSoftMixer::Finish(float *out, int frames, float gain)
+{
+	if (ReverbActive)
+	{
+		ApplyReverb(frames);
+	}
+	const float *dl = DryL.Data(), *dr = DryR.Data();
+	const float *wl = WetL.Data(), *wr = WetR.Data();
+	for (int i = 0; i < frames; i++)
+	{
+		out[i * 2] = clamp((dl[i] + wl[i]) * gain, -1.f, 1.f);
+		out[i * 2 + 1] = clamp((dr[i] + wr[i]) * gain, -1.f, 1.f);
+	}
+}
+
+//==========================================================================
+//
+// Sinks
+//
+//==========================================================================
+
+class FNullSoundSink : public FSoftSoundSink
+{
+public:
+	void Write(const float *stereo, int frames) override
+	{
+	}
+	const char *GetName() override
+	{
+		return "null";
+	}
+};
+
+class FWaveSoundSink : public FSoftSoundSink
+{
+public:
+	FWaveSoundSink(const char *filename, int rate)
+	{
+		Rate = rate;
+		File = FileWriter::Open(filename);
+		if (File == nullptr)
+		{
+			Printf(TEXTCOLOR_RED "Could not open %s for writing\n", filename);
+			return;
+		}
+		WriteHeader();
+	}
+
+	~FWaveSoundSink()
+	{
+		if (File != nullptr)
+		{
+			File->Seek(0, SEEK_SET);
+			WriteHeader();
+			delete File;
+		}
+	}
+
+	bool IsValid() override
+	{
+		return File != nullptr;
+	}
+
+	void Write(const float *stereo, int frames) override
+	{
+		Buffer.Resize(frames * 2);
+		for (int i = 0; i < frames * 2; i++)
+		{
+			Buffer[i] = LittleShort(int16_t(stereo[i] * 32767.f));
+		}
+		File->Write(Buffer.Data(), frames * 4);
+		DataBytes += frames * 4;
+	}
+
+	const char *GetName() override
+	{
+		return "wav";
+	}
+
+private:
+	void WriteHeader()
+	{
+		uint8_t header[44];
+		memcpy(header, "RIFF", 4);
+		WriteLE32(header + 4, 36 + DataBytes);
+		memcpy(header + 8, "WAVEfmt ", 8);
+		WriteLE32(header + 16, 16);
+		WriteLE16(header + 20, 1);			// PCM
+		WriteLE16(header + 22, 2);			// stereo
+		WriteLE32(header + 24, Rate);
+		WriteLE32(header + 28, Rate * 4);
+		WriteLE16(header + 32, 4);
+		WriteLE16(header + 34, 16);
+		memcpy(header + 36, "data", 4);
+		WriteLE32(header + 40, DataBytes);
+		File->Write(header, sizeof(header));
+	}
+
+	static void WriteLE32(uint8_t *p, uint32_t v)
+	{
+		p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); p[2] = uint8_t(v >> 16); p[3] = uint8_t(v >> 24);
+	}
+
+	static void WriteLE16(uint8_t *p, uint16_t v)
+	{
+		p[0] = uint8_t(v); p[1] = uint8_t(v >> 8);
+	}
+
+	FileWriter *File;
+	TArray<int16_t> Buffer;
+	uint32_t DataBytes = 0;
+	int Rate;
+};
+
+//==========================================================================
+//
+// SoftSoundStream
+//
+// The mixer thread pulls data from the stream callback, converts it to
+// float and resamples it into the output.
+//
+//==========================================================================
+
+class SoftSoundStream : public SoundStream
+{
+	SoftSoundRenderer *Renderer;
+
+	SoundStreamCallback Callback;
+	void *UserData;
+
+	TArray<uint8_t> Data;
+	TArray<float> Pending;		// converted frames that have not been played yet
+	int Flags;
+	int Channels;
+	int SampleRate;
+	int FrameSize;
+
+	std::atomic<bool> Playing;
+	std::atomic<bool> Paused;
+	float Volume;
+	uint64_t Pos = 0;			// 32.32 position in Pending
+	uint64_t Played = 0;		// frames consumed from the callback
+
+public:
+	SoftSoundStream(SoftSoundRenderer *renderer)
+		: Renderer(renderer), Playing(false), Paused(false), Volume(1.f)
+	{
+	}
+
+	~SoftSoundStream()
+	{
+		std::lock_guard<std::mutex> lock(Renderer->StreamLock);
+		Renderer->Streams.Delete(Renderer->Streams.Find(this));
+	}
+
+	bool Init(SoundStreamCallback callback, int buffbytes, int flags, int samplerate, void *userdata)
+	{
+		Callback = callback;
+		UserData = userdata;
+		SampleRate = samplerate;
+		Flags = flags;
+		Channels = (flags & Mono) ? 1 : 2;
+		FrameSize = Channels * ((flags & Bits8) ? 1 : (flags & (Bits32 | Float)) ? 4 : 2);
+		if (samplerate <= 0 || buffbytes < FrameSize)
+		{
+			return false;
+		}
+		Data.Resize(buffbytes - buffbytes % FrameSize);
+
+		std::lock_guard<std::mutex> lock(Renderer->StreamLock);
+		Renderer->Streams.Push(this);
+		return true;
+	}
+
+	bool Play(bool looping, float vol) override
+	{
+		SetVolume(vol);
+		if (Playing.load())
+			return true;
+
+		std::lock_guard<std::mutex> lock(Renderer->StreamLock);
+		Pending.Clear();
+		Pos = 0;
+		Played = 0;
+		Paused.store(false);
+		Playing.store(true);
+		return true;
+	}
+
+	void Stop() override
+	{
+		std::lock_guard<std::mutex> lock(Renderer->StreamLock);
+		Playing.store(false);
+		Pending.Clear();
+		Pos = 0;
+	}
+
+	void SetVolume(float vol) override
+	{
+		Volume = vol;
+	}
+
+	bool SetPaused(bool paused) override
+	{
+		Paused.store(paused);
+		return true;
+	}
+
+	bool IsEnded() override
+	{
+		return !Playing.load();
+	}
+
+	Position GetPlayPosition() override
+	{
+		std::lock_guard<std::mutex> lock(Renderer->StreamLock);
+		return { Played, std::chrono::nanoseconds(0) };
+	}
+
+	// Called by the mixer thread with the stream lock held.
+	void Mix(FSoftMixer &mixer, int frames)
+	{
+		if (!Playing.load() || Paused.load())
+		{
+			return;
+		}
+
+		const uint64_t step = uint64_t((double)SampleRate / mixer.GetRate() * FRACUNIT64);
+		const uint32_t needed = uint32_t(((Pos + step * frames) >> 32) + 2);
+		while (Pending.Size() / Channels < needed)
+		{
+			if (!Callback(this, Data.Data(), Data.Size(), UserData))
+			{
+				Playing.store(false);
+				break;
+			}
+			Convert();
+		}
+
+		const uint32_t avail = Pending.Size() / Channels;
+		if (avail < 2)
+		{
+			return;
+		}
+		mixer.MixBuffer(Pending.Data(), Channels, Pos, step, avail - 1, frames, Volume * Renderer->MusicVolume);
+
+		// Drop the frames that were fully consumed.
+		const uint32_t consumed = uint32_t(Pos >> 32);
+		if (consumed > 0)
+		{
+			Pending.Delete(0, consumed * Channels);
+			Pos -= uint64_t(consumed) << 32;
+			Played += consumed;
+		}
+	}
+
+private:
+	void Convert()
+	{
+		const unsigned samples = Data.Size() / (FrameSize / Channels);
+		const unsigned start = Pending.Reserve(samples);
+		float *out = &Pending[start];
+
+		if (Flags & Bits8)
+		{
+			for (unsigned i = 0; i < samples; i++) out[i] = (Data[i] - 128) / 128.f;
+		}
+		else if (Flags & Float)
+		{
+			memcpy(out, Data.Data(), samples * sizeof(float));
+		}
+		else if (Flags & Bits32)
+		{
+			const int32_t *in = (const int32_t *)Data.Data();
+			for (unsigned i = 0; i < samples; i++) out[i] = in[i] / 2147483648.f;
+		}
+		else
+		{
+			const int16_t *in = (const int16_t *)Data.Data();
+			for (unsigned i = 0; i < samples; i++) out[i] = in[i] / 32768.f;
+		}
+	}
+};
+
+//==========================================================================
+//
+// SoftSoundRenderer - Constructor
+//
+//==========================================================================
+
+SoftSoundRenderer::SoftSoundRenderer()
+	: QuitThread(false), Sink(nullptr), SfxVolume(1.f), MusicVolume(1.f), SFXPaused(0), SyncPaused(false),
+	  Inactive(INACTIVE_Active), WasInWater(false), ListenerPos(0, 0, 0), ListenerAngle(0),
+	  PrevEnvironment(nullptr), PendingReverb(nullptr), ReverbChanged(false), FramesMixed(0), MixTimeNS(0), ActiveVoices(0)
+{
+	Printf("I_InitSound: Initializing software mixer\n");
+
+	OutputRate = *snd_samplerate != 0 ? *snd_samplerate : 44100;
+	// Mix in blocks of roughly 10 ms unless a buffer size was requested.
+	BlockSize = *snd_buffersize > 0 ? clamp<int>(*snd_buffersize, 64, 8192) : (OutputRate / 100 + 3) & ~3;
+	Mixer.Init(OutputRate, BlockSize);
+
+	if (stricmp(snd_softsink, "wav") == 0)
+	{
+		Sink = new FWaveSoundSink(snd_softwavefile, OutputRate);
+	}
+	else if (stricmp(snd_softsink, "null") == 0)
+	{
+		Sink = new FNullSoundSink;
+	}
+	else
+	{
+		Sink = I_CreateSoundDeviceSink(OutputRate, BlockSize);
+		if (Sink == nullptr)
+		{
+			Printf(TEXTCOLOR_RED "The software mixer cannot play through a sound device on this platform. Set snd_softsink to \"null\" or \"wav\" to use it anyway.\n");
+			return;
+		}
+	}
+	if (!Sink->IsValid())
+	{
+		delete Sink;
+		Sink = nullptr;
+		return;
+	}
+
+	const int numChannels = max<int>(snd_channels, 2);
+	Voices.Resize(numChannels);
+	memset(Voices.Data(), 0, Voices.Size() * sizeof(FSoftVoice));
+	FreeVoices.Resize(numChannels);
+	for (int i = 0; i < numChannels; i++)
+	{
+		FreeVoices[i] = &Voices[numChannels - 1 - i];
+	}
+
+	Printf("  Output: %s, %d Hz, %d voices, %d frames per block\n", Sink->GetName(), OutputRate, numChannels, BlockSize);
+	MixThread = std::thread(&SoftSoundRenderer::MixerProc, this);
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer - Destructor
+//
+//==========================================================================
+
+SoftSoundRenderer::~SoftSoundRenderer()
+{
+	if (MixThread.joinable())
+	{
+		QuitThread.store(true);
+		MixThread.join();
+	}
+	delete Sink;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: MixerProc
+//
+// Mixes one block at a time and paces itself to real time, so that sound
+// positions and ends are reported the same way as with a real device.
+//
+//==========================================================================
+
+void SoftSoundRenderer::MixerProc()
+{
+	using namespace std::chrono;
+
+	TArray<float> out(BlockSize * 2, true);
+	const auto blocktime = duration_cast<steady_clock::duration>(duration<double>((double)BlockSize / OutputRate));
+	auto next = steady_clock::now();
+
+	while (!QuitThread.load())
+	{
+		uint64_t start = I_nsTime();
+		int active = 0;
+		Mixer.Begin(BlockSize);
+		{
+			std::lock_guard<std::mutex> lock(StreamLock);
+			for (auto stream : Streams)
+			{
+				stream->Mix(Mixer, BlockSize);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(MixLock);
+			if (ReverbChanged)
+			{
+				Mixer.SetReverb(PendingReverb);
+				ReverbChanged = false;
+			}
+			if (Inactive != INACTIVE_Complete)
+			{
+				for (auto &voice : Voices)
+				{
+					if (!voice.Playing || voice.Ended || SyncPaused || (voice.Pausable && SFXPaused))
+					{
+						continue;
+					}
+					const bool water = WasInWater && voice.Chan != nullptr && !(voice.Chan->ChanFlags & CHANF_UI);
+					if (!Mixer.MixVoice(voice, BlockSize, water ? PITCH_MULT : 1.f, SfxVolume))
+					{
+						voice.Ended = true;
+					}
+					active++;
+				}
+			}
+		}
+		Mixer.Finish(out.Data(), BlockSize, Inactive == INACTIVE_Active ? 1.f : 0.f);
+		Sink->Write(out.Data(), BlockSize);
+
+		FramesMixed += BlockSize;
+		MixTimeNS += I_nsTime() - start;
+		ActiveVoices.store(active);
+
+		// Stay no more than two blocks ahead of real time.
+		next += blocktime;
+		auto now = steady_clock::now();
+		if (next > now + blocktime)
+		{
+			std::this_thread::sleep_until(next - blocktime);
+		}
+		else if (next < now - blocktime * 8)
+		{
+			// We fell far behind; don't try to catch up in a burst.
+			next = now;
+		}
+	}
+}
+
+//==========================================================================
+//
+// Volume
+//
+//==========================================================================
+
+void SoftSoundRenderer::SetSfxVolume(float volume)
+{
+	std::lock_guard<std::mutex> lock(MixLock);
+	SfxVolume = volume;
+}
+
+void SoftSoundRenderer::SetMusicVolume(float volume)
+{
+	MusicVolume = volume;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: LoadSound
+//
+//==========================================================================
+
+SoundHandle SoftSoundRenderer::LoadSound(uint8_t *sfxdata, int length)
+{
+	SoundHandle retval = { NULL };
+	ChannelConfig chans;
+	SampleType type;
+	int srate;
+	uint32_t loop_start = 0, loop_end = ~0u;
+	zmusic_bool startass = false, endass = false;
+
+	FindLoopTags(sfxdata, length, &loop_start, &startass, &loop_end, &endass);
+	auto decoder = CreateDecoder(sfxdata, length, true);
+	if (!decoder)
+		return retval;
+
+	SoundDecoder_GetInfo(decoder, &srate, &chans, &type);
+	if ((chans != ChannelConfig_Mono && chans != ChannelConfig_Stereo) ||
+		(type != SampleType_UInt8 && type != SampleType_Int16))
+	{
+		SoundDecoder_Close(decoder);
+		Printf("Unsupported audio format: %s, %s\n", GetChannelConfigName(chans),
+			GetSampleTypeName(type));
+		return retval;
+	}
+
+	TArray<uint8_t> data;
+	unsigned total = 0;
+	unsigned got;
+
+	data.Resize(32768);
+	while ((got = (unsigned)SoundDecoder_Read(decoder, &data[total], data.Size() - total)) > 0)
+	{
+		total += got;
+		data.Resize(total * 2);
+	}
+	SoundDecoder_Close(decoder);
+	if (total == 0)
+	{
+		return retval;
+	}
+
+	const int channels = chans == ChannelConfig_Stereo ? 2 : 1;
+	const int bits = type == SampleType_Int16 ? 16 : 8;
+	if (!startass) loop_start = Scale(loop_start, srate, 1000);
+	if (!endass && loop_end != ~0u) loop_end = Scale(loop_end, srate, 1000);
+	const uint32_t frames = total / (channels * bits / 8);
+	if (loop_start > frames) loop_start = 0;
+	if (loop_end > frames) loop_end = frames;
+
+	return LoadSoundRaw(data.Data(), total, srate, channels, bits, loop_start, loop_end);
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: LoadSoundRaw
+//
+//==========================================================================
+
+SoundHandle SoftSoundRenderer::LoadSoundRaw(uint8_t *sfxdata, int length, int frequency, int channels, int bits, int loopstart, int loopend)
+{
+	SoundHandle retval = { NULL };
+
+	if (length == 0) return retval;
+
+	bool issigned = false;
+	if (bits == -8)
+	{
+		issigned = true;
+		bits = 8;
+	}
+	if ((bits != 8 && bits != 16) || (channels != 1 && channels != 2) || frequency <= 0)
+	{
+		Printf("Unhandled format: %d bit, %d channel, %d hz\n", bits, channels, frequency);
+		return retval;
+	}
+
+	const int framesize = channels * bits / 8;
+	const uint32_t frames = length / framesize;
+	auto sample = new FSoftSample;
+	sample->Channels = channels;
+	sample->Frequency = frequency;
+	sample->Frames = frames;
+	sample->Data.Resize((frames + 1) * channels);
+
+	float *out = sample->Data.Data();
+	const unsigned samples = frames * channels;
+	if (bits == 16)
+	{
+		for (unsigned i = 0; i < samples; i++)
+		{
+			out[i] = int16_t(sfxdata[i * 2] | (sfxdata[i * 2 + 1] << 8)) / 32768.f;
+		}
+	}
+	else if (issigned)
+	{
+		for (unsigned i = 0; i < samples; i++) out[i] = int8_t(sfxdata[i]) / 128.f;
+	}
+	else
+	{
+		for (unsigned i = 0; i < samples; i++) out[i] = (sfxdata[i] - 128) / 128.f;
+	}
+	for (int i = 0; i < channels; i++)
+	{
+		out[samples + i] = 0;
+	}
+
+	if (loopstart < 0) loopstart = 0;
+	if (loopend < 0 || (uint32_t)loopend > frames) loopend = frames;
+	sample->LoopStart = loopstart < loopend ? loopstart : 0;
+	sample->LoopEnd = loopend;
+
+	retval.data = sample;
+	return retval;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: UnloadSound
+//
+//==========================================================================
+
+void SoftSoundRenderer::UnloadSound(SoundHandle sfx)
+{
+	if (!sfx.data)
+		return;
+
+	auto sample = (FSoftSample *)sfx.data;
+	FSoundChan *schan = soundEngine->GetChannels();
+	while (schan)
+	{
+		FSoundChan *next = schan->NextChan;
+		if (schan->SysChannel != nullptr && ((FSoftVoice *)schan->SysChannel)->Sample == sample)
+		{
+			StopChannel(schan);
+		}
+		schan = next;
+	}
+	delete sample;
+}
+
+unsigned int SoftSoundRenderer::GetMSLength(SoundHandle sfx)
+{
+	auto sample = (FSoftSample *)sfx.data;
+	if (sample == nullptr)
+	{
+		return 0;
+	}
+	return unsigned(uint64_t(sample->Frames) * 1000 / sample->Frequency);
+}
+
+unsigned int SoftSoundRenderer::GetSampleLength(SoundHandle sfx)
+{
+	auto sample = (FSoftSample *)sfx.data;
+	return sample != nullptr ? sample->Frames : 0;
+}
+
+float SoftSoundRenderer::GetOutputRate()
+{
+	return (float)OutputRate;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: CreateStream
+//
+//==========================================================================
+
+SoundStream *SoftSoundRenderer::CreateStream(SoundStreamCallback callback, int buffbytes, int flags, int samplerate, void *userdata)
+{
+	auto stream = new SoftSoundStream(this);
+	if (!stream->Init(callback, buffbytes, flags, samplerate, userdata))
+	{
+		delete stream;
+		return nullptr;
+	}
+	return stream;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: FindLowestChannel
+//
+//==========================================================================
+
+FSoundChan *SoftSoundRenderer::FindLowestChannel()
+{
+	return soundEngine->FindLowestChannel();
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: AllocVoice
+//
+// Gets a free voice. If there is none, the lowest priority sound is
+// evicted, if forced or if it is less important than the new one.
+// The free list is only touched by the game thread, so this does not need
+// the mix lock.
+//
+//==========================================================================
+
+FSoftVoice *SoftSoundRenderer::AllocVoice(int priority, float dist_sqr, bool force)
+{
+	if (FreeVoices.Size() == 0)
+	{
+		FSoundChan *lowest = FindLowestChannel();
+		if (lowest != nullptr && (force || lowest->Priority < priority ||
+			(lowest->Priority == priority && lowest->DistanceSqr > dist_sqr)))
+		{
+			StopChannel(lowest);
+		}
+		if (FreeVoices.Size() == 0)
+			return nullptr;
+	}
+	FSoftVoice *voice;
+	FreeVoices.Pop(voice);
+	return voice;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: SetupVoice
+//
+// Common part of StartSound and StartSound3D. Must be called with the mix
+// lock held. The voice is not playing yet when this returns.
+//
+//==========================================================================
+
+void SoftSoundRenderer::SetupVoice(FSoftVoice *voice, FSoftSample *sample, float vol, float pitch, int chanflags, FISoundChannel *reuse_chan, float startTime)
+{
+	uint64_t pos = 0;
+	if (!reuse_chan || reuse_chan->StartTime == 0)
+	{
+		float sfxlength = (float)sample->Frames / sample->Frequency;
+		float st = (chanflags & SNDF_LOOP)
+			? (sfxlength > 0 ? fmod(startTime, sfxlength) : 0)
+			: clamp<float>(startTime, 0.f, sfxlength);
+		pos = uint64_t(st * sample->Frequency * FRACUNIT64);
+	}
+	else if (chanflags & SNDF_ABSTIME)
+	{
+		pos = reuse_chan->StartTime << 32;
+	}
+	else
+	{
+		float offset = std::chrono::duration_cast<std::chrono::duration<float>>(
+			std::chrono::steady_clock::now().time_since_epoch() -
+			std::chrono::steady_clock::time_point::duration(reuse_chan->StartTime)
+		).count();
+		if (offset > 0.f) pos = uint64_t(offset * sample->Frequency * FRACUNIT64);
+	}
+	if ((chanflags & SNDF_LOOP) && sample->LoopEnd > sample->LoopStart && pos >= (uint64_t(sample->LoopEnd) << 32))
+	{
+		pos = uint64_t(sample->LoopStart) << 32;
+	}
+
+	voice->Sample = sample;
+	voice->Pos = pos;
+	voice->Pitch = pitch;
+	voice->Volume = vol;
+	voice->SpatialL = voice->SpatialR = 1.f;
+	voice->Looping = !!(chanflags & SNDF_LOOP);
+	voice->Pausable = !(chanflags & SNDF_NOPAUSE);
+	voice->Reverb = !(chanflags & SNDF_NOREVERB);
+	voice->Ended = false;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: StartSound
+//
+//==========================================================================
+
+FISoundChannel *SoftSoundRenderer::StartSound(SoundHandle sfx, float vol, float pitch, int chanflags, FISoundChannel *reuse_chan, float startTime)
+{
+	auto sample = (FSoftSample *)sfx.data;
+	FSoftVoice *voice;
+	if (sample == nullptr || (voice = AllocVoice(0, 0, true)) == nullptr)
+	{
+		return nullptr;
+	}
+
+	FISoundChannel *chan = reuse_chan;
+	if (!chan) chan = soundEngine->GetChannel(voice);
+	else chan->SysChannel = voice;
+
+	chan->Rolloff.RolloffType = ROLLOFF_Log;
+	chan->Rolloff.RolloffFactor = 0.f;
+	chan->Rolloff.MinDistance = 1.f;
+	chan->DistanceSqr = 0.f;
+	chan->ManualRolloff = false;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	SetupVoice(voice, sample, vol, pitch, chanflags, reuse_chan, startTime);
+	voice->GainL = voice->GainR = vol;
+	voice->CurGainL = voice->CurGainR = vol * SfxVolume;
+	voice->Chan = chan;
+	voice->Playing = true;
+	return chan;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: StartSound3D
+//
+//==========================================================================
+
+FISoundChannel *SoftSoundRenderer::StartSound3D(SoundHandle sfx, SoundListener *listener, float vol,
+	FRolloffInfo *rolloff, float distscale, float pitch, int priority, const FVector3 &pos, const FVector3 &vel,
+	int channum, int chanflags, FISoundChannel *reuse_chan, float startTime)
+{
+	float dist_sqr = (float)(pos - listener->position).LengthSquared();
+
+	auto sample = (FSoftSample *)sfx.data;
+	FSoftVoice *voice;
+	if (sample == nullptr || (voice = AllocVoice(priority, dist_sqr, false)) == nullptr)
+	{
+		return nullptr;
+	}
+
+	FISoundChannel *chan = reuse_chan;
+	if (!chan) chan = soundEngine->GetChannel(voice);
+	else chan->SysChannel = voice;
+
+	chan->Rolloff = *rolloff;
+	chan->DistanceScale = distscale;
+	chan->DistanceSqr = dist_sqr;
+	chan->ManualRolloff = true;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	SetupVoice(voice, sample, vol, pitch, chanflags, reuse_chan, startTime);
+	voice->Chan = chan;
+	ListenerPos = listener->position;
+	ListenerAngle = listener->angle;
+	CalcPanning(voice, pos, !!(chanflags & SNDF_AREA));
+	voice->CurGainL = voice->GainL * SfxVolume;
+	voice->CurGainR = voice->GainR * SfxVolume;
+	voice->Playing = true;
+	return chan;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: CalcPanning
+//
+// Sets a voice's gains from its distance and direction to the listener.
+// Must be called with the mix lock held.
+//
+//==========================================================================
+
+void SoftSoundRenderer::CalcPanning(FSoftVoice *voice, const FVector3 &pos, bool areasound)
+{
+	FISoundChannel *chan = voice->Chan;
+	const FVector3 dir = pos - ListenerPos;
+	const float dist = dir.Length();
+	float gain = 1.f;
+	float pan = 0;
+
+	if (dist >= 0.0004f)
+	{
+		gain *= soundEngine->GetRolloff(&chan->Rolloff, dist * chan->DistanceScale);
+		// The listener's right in sound space, see OpenALSoundRenderer::UpdateListener.
+		pan = (dir.X * sinf(ListenerAngle) - dir.Z * cosf(ListenerAngle)) / dist;
+		if (areasound)
+		{
+			pan *= min(dist / AREA_SOUND_RADIUS, 1.f);
+		}
+	}
+	// Constant power panning, normalized so that a centered sound plays
+	// at full volume on both sides like a 2D sound.
+	voice->SpatialL = gain * min(sqrtf(1.f - pan), 1.f);
+	voice->SpatialR = gain * min(sqrtf(1.f + pan), 1.f);
+	voice->GainL = voice->Volume * voice->SpatialL;
+	voice->GainR = voice->Volume * voice->SpatialR;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: StopChannel
+//
+//==========================================================================
+
+void SoftSoundRenderer::StopChannel(FISoundChannel *chan)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return;
+
+	FSoftVoice *voice = (FSoftVoice *)chan->SysChannel;
+	// Release first, so it can be properly marked as evicted if it's being killed
+	soundEngine->ChannelEnded(chan);
+
+	{
+		std::lock_guard<std::mutex> lock(MixLock);
+		voice->Playing = false;
+		voice->Sample = nullptr;
+		voice->Chan = nullptr;
+	}
+	FreeVoices.Push(voice);
+
+	if (!(chan->ChanFlags & CHANF_EVICTED))
+		soundEngine->SoundDone(chan);
+}
+
+//==========================================================================
+//
+// Channel parameters
+//
+//==========================================================================
+
+void SoftSoundRenderer::ChannelVolume(FISoundChannel *chan, float volume)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	FSoftVoice *voice = (FSoftVoice *)chan->SysChannel;
+	voice->Volume = volume;
+	voice->GainL = volume * voice->SpatialL;
+	voice->GainR = volume * voice->SpatialR;
+}
+
+void SoftSoundRenderer::ChannelPitch(FISoundChannel *chan, float pitch)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	((FSoftVoice *)chan->SysChannel)->Pitch = max(pitch, 0.0001f);
+}
+
+void SoftSoundRenderer::MarkStartTime(FISoundChannel *chan, float startTime)
+{
+	using namespace std::chrono;
+	auto startTimeDuration = duration<double>(startTime);
+	auto diff = steady_clock::now().time_since_epoch() - startTimeDuration;
+	chan->StartTime = static_cast<uint64_t>(duration_cast<nanoseconds>(diff).count());
+}
+
+unsigned int SoftSoundRenderer::GetPosition(FISoundChannel *chan)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	return unsigned(((FSoftVoice *)chan->SysChannel)->Pos >> 32);
+}
+
+float SoftSoundRenderer::GetAudibility(FISoundChannel *chan)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return 0.f;
+
+	FSoftVoice *voice = (FSoftVoice *)chan->SysChannel;
+	float volume = voice->Volume * SfxVolume;
+	if (chan->ManualRolloff)
+	{
+		volume *= soundEngine->GetRolloff(&chan->Rolloff, sqrtf(chan->DistanceSqr) * chan->DistanceScale);
+	}
+	return volume;
+}
+
+//==========================================================================
+//
+// Pausing
+//
+//==========================================================================
+
+void SoftSoundRenderer::Sync(bool sync)
+{
+	std::lock_guard<std::mutex> lock(MixLock);
+	SyncPaused = sync;
+}
+
+void SoftSoundRenderer::SetSfxPaused(bool paused, int slot)
+{
+	std::lock_guard<std::mutex> lock(MixLock);
+	if (paused)
+		SFXPaused |= 1 << slot;
+	else
+		SFXPaused &= ~(1 << slot);
+}
+
+void SoftSoundRenderer::SetInactive(SoundRenderer::EInactiveState state)
+{
+	std::lock_guard<std::mutex> lock(MixLock);
+	Inactive = state;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: UpdateSoundParams3D
+//
+//==========================================================================
+
+void SoftSoundRenderer::UpdateSoundParams3D(SoundListener *listener, FISoundChannel *chan, bool areasound, const FVector3 &pos, const FVector3 &vel)
+{
+	if (chan == NULL || chan->SysChannel == NULL)
+		return;
+
+	chan->DistanceSqr = (float)(pos - listener->position).LengthSquared();
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	ListenerPos = listener->position;
+	ListenerAngle = listener->angle;
+	CalcPanning((FSoftVoice *)chan->SysChannel, pos, areasound);
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: UpdateListener
+//
+//==========================================================================
+
+void SoftSoundRenderer::UpdateListener(SoundListener *listener)
+{
+	if (!listener->valid)
+		return;
+
+	std::lock_guard<std::mutex> lock(MixLock);
+	ListenerPos = listener->position;
+	ListenerAngle = listener->angle;
+
+	const ReverbContainer *env = ForcedEnvironment;
+	if (!env)
+	{
+		env = listener->Environment;
+		if (!env)
+			env = DefaultEnvironments[0];
+	}
+	const bool inwater = listener->underwater || env->SoftwareWater;
+	if (inwater && *snd_waterreverb)
+	{
+		// Find the "Underwater" reverb environment
+		const ReverbContainer *water = S_FindEnvironment(0x1600);
+		if (water != nullptr) env = water;
+	}
+	if (env != PrevEnvironment || env->Modified)
+	{
+		PrevEnvironment = env;
+		DPrintf(DMSG_NOTIFY, "Reverb Environment %s\n", env->Name);
+		PendingReverb = &env->Properties;
+		ReverbChanged = true;
+		const_cast<ReverbContainer*>(env)->Modified = false;
+	}
+	WasInWater = inwater;
+}
+
+//==========================================================================
+//
+// SoftSoundRenderer :: UpdateSounds
+//
+// Releases the channels whose voices ran out.
+//
+//==========================================================================
+
+void SoftSoundRenderer::UpdateSounds()
+{
+	TArray<FISoundChannel *> ended;
+	{
+		std::lock_guard<std::mutex> lock(MixLock);
+		for (auto &voice : Voices)
+		{
+			if (voice.Playing && voice.Ended && voice.Chan != nullptr)
+			{
+				ended.Push(voice.Chan);
+			}
+		}
+	}
+	for (auto chan : ended)
+	{
+		StopChannel(chan);
+	}
+}
+
+bool SoftSoundRenderer::IsValid()
+{
+	return Sink != nullptr;
+}
+
+void SoftSoundRenderer::PrintStatus()
+{
+	Printf("Software mixer active.\n");
+	Printf("Output: " TEXTCOLOR_ORANGE "%s" TEXTCOLOR_NORMAL ", " TEXTCOLOR_BLUE "%d" TEXTCOLOR_NORMAL "hz\n", Sink->GetName(), OutputRate);
+	Printf("Voices: " TEXTCOLOR_BLUE "%u" TEXTCOLOR_NORMAL ", block size: " TEXTCOLOR_BLUE "%d\n", Voices.Size(), BlockSize);
+#ifndef NO_SSE
+	Printf("Resampler: linear, SSE\n");
+#else
+	Printf("Resampler: linear\n");
+#endif
+}
+
+void SoftSoundRenderer::PrintDriversList()
+{
+	Printf("Software mixer sinks: device, null, wav (set with snd_softsink)\n");
+}
+
+FString SoftSoundRenderer::GatherStats()
+{
+	FString out;
+	const uint64_t frames = FramesMixed.load();
+	const double seconds = (double)frames / OutputRate;
+	out.Format("%u voices (" TEXTCOLOR_YELLOW "%d" TEXTCOLOR_NORMAL " active, " TEXTCOLOR_YELLOW "%u" TEXTCOLOR_NORMAL " free), "
+		"Mix cost: " TEXTCOLOR_YELLOW "%.2f" TEXTCOLOR_NORMAL "ms per second of audio",
+		Voices.Size(), ActiveVoices.load(), FreeVoices.Size(),
+		seconds > 0 ? MixTimeNS.load() * 1e-6 / seconds : 0.);
+	return out;
+}
+
+//==========================================================================
+//
+// CCMD snd_mixbench
+//
+// Mixes a number of voices as fast as possible and reports the CPU time
+// needed per second of audio, with and without SIMD.
+//
+//==========================================================================
+
+CCMD(snd_mixbench)
+{
+	const int numvoices = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 4096) : 256;
+	const int seconds = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 600) : 10;
+	const int rate = 44100;
+	const int blocksize = 512;
+
+	// A second of noise at 11025 Hz, like most Doom sounds.
+	FSoftSample sample;
+	sample.Channels = 1;
+	sample.Frequency = 11025;
+	sample.Frames = 11025;
+	sample.LoopStart = 0;
+	sample.LoopEnd = sample.Frames;
+	sample.Data.Resize(sample.Frames + 1);
+	for (unsigned i = 0; i < sample.Frames; i++)
+	{
+		sample.Data[i] = (float)((i * 1103515245u + 12345u) >> 16 & 0x7fff) / 16384.f - 1.f;
+	}
+	sample.Data[sample.Frames] = 0;
+
+	TArray<FSoftVoice> voices(numvoices, true);
+	TArray<float> out(blocksize * 2, true);
+	FSoftMixer mixer;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+#ifdef NO_SSE
+		if (pass == 0) continue;
+#endif
+		mixer.Init(rate, blocksize);
+		mixer.SetReverb(&DefaultEnvironments[0]->Properties);
+		mixer.UseSIMD = pass == 0;
+		for (int i = 0; i < numvoices; i++)
+		{
+			FSoftVoice &voice = voices[i];
+			memset(&voice, 0, sizeof(voice));
+			voice.Sample = &sample;
+			voice.Pos = uint64_t(i * 97 % sample.Frames) << 32;
+			voice.Pitch = 0.9f + (i % 16) * 0.0125f;
+			voice.Volume = 1.f / numvoices;
+			voice.SpatialL = i & 1 ? 0.3f : 0.9f;
+			voice.SpatialR = i & 1 ? 0.9f : 0.3f;
+			voice.GainL = voice.CurGainL = voice.Volume * voice.SpatialL;
+			voice.GainR = voice.CurGainR = voice.Volume * voice.SpatialR;
+			voice.Playing = true;
+			voice.Looping = true;
+			voice.Reverb = !!(i & 2);
+		}
+
+		const int blocks = seconds * rate / blocksize;
+		const uint64_t start = I_nsTime();
+		for (int b = 0; b < blocks; b++)
+		{
+			mixer.Begin(blocksize);
+			for (auto &voice : voices)
+			{
+				mixer.MixVoice(voice, blocksize, 1.f, 1.f);
+			}
+			mixer.Finish(out.Data(), blocksize, 1.f);
+		}
+		const double ms = (I_nsTime() - start) * 1e-6;
+		const double audioseconds = (double)blocks * blocksize / rate;
+		Printf("%s: %d voices, %.1f s of audio in %.1f ms (%.2f ms CPU per audio second, %.0fx real time)\n",
+			pass == 0 ? "SIMD  " : "Scalar", numvoices, audioseconds, ms, ms / audioseconds, audioseconds * 1000 / ms);
+	}
+}
@@ -0,0 +1,169 @@
+#ifndef SOFTSOUND_H
+#define SOFTSOUND_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "i_sound.h"
+#include "s_soundinternal.h"
+
+class FileWriter;
+class SoftSoundStream;
+
+// A sound effect, converted to float. The data is padded with one silent
+// frame so that the resampler can always read one frame ahead.
+struct FSoftSample
+{
+	TArray<float> Data;		// interleaved if stereo
+	int Channels;
+	int Frequency;
+	uint32_t Frames;
+	uint32_t LoopStart;
+	uint32_t LoopEnd;
+};
+
+struct FSoftVoice
+{
+	FSoftSample *Sample;
+	FISoundChannel *Chan;
+	uint64_t Pos;			// 32.32 fixed point frame position
+	float Pitch;
+	float Volume;			// volume set by the sound engine
+	float SpatialL, SpatialR;	// rolloff and panning
+	float GainL, GainR;		// target gains, Volume * Spatial
+	float CurGainL, CurGainR;
+	bool Playing;
+	bool Looping;
+	bool Pausable;
+	bool Reverb;
+	bool Ended;				// set by the mixer, handled in UpdateSounds
+};
+
+// The actual mixer. It doesn't know anything about the sound engine, so the
+// benchmark can drive it directly.
+class FSoftMixer
+{
+public:
+	void Init(int rate, int blocksize);
+	void SetReverb(const REVERB_PROPERTIES *props);
+	void Begin(int frames);
+	bool MixVoice(FSoftVoice &voice, int frames, float pitchmul, float gain);
+	void MixBuffer(const float *src, int channels, uint64_t &pos, uint64_t step, uint32_t end, int frames, float gain);
+	void Finish(float *out, int frames, float gain);
+
+	int GetRate() const { return Rate; }
+	bool UseSIMD = true;
+
+private:
+	struct FComb
+	{
+		TArray<float> Buffer;
+		unsigned Index;
+		float Feedback;
+		float Store;
+	};
+
+	void ApplyReverb(int frames);
+
+	int Rate = 44100;
+	TArray<float> DryL, DryR;		// voices without reverb
+	TArray<float> WetL, WetR;		// voices that are sent to the reverb
+	FComb Combs[2][4];
+	float ReverbGain = 0;
+	float ReverbDamp = 0;
+	bool ReverbActive = false;
+};
+
+// Where the mixed output goes.
+class FSoftSoundSink
+{
+public:
+	virtual ~FSoftSoundSink() = default;
+	virtual bool IsValid() { return true; }
+	virtual void Write(const float *stereo, int frames) = 0;
+	virtual const char *GetName() = 0;
+};
+
+class SoftSoundRenderer : public SoundRenderer
+{
+public:
+	SoftSoundRenderer();
+	virtual ~SoftSoundRenderer();
+
+	void SetSfxVolume(float volume) override;
+	void SetMusicVolume(float volume) override;
+	SoundHandle LoadSound(uint8_t *sfxdata, int length) override;
+	SoundHandle LoadSoundRaw(uint8_t *sfxdata, int length, int frequency, int channels, int bits, int loopstart, int loopend = -1) override;
+	void UnloadSound(SoundHandle sfx) override;
+	unsigned int GetMSLength(SoundHandle sfx) override;
+	unsigned int GetSampleLength(SoundHandle sfx) override;
+	float GetOutputRate() override;
+
+	// Streaming sounds.
+	SoundStream *CreateStream(SoundStreamCallback callback, int buffbytes, int flags, int samplerate, void *userdata) override;
+
+	// Starts a sound.
+	FISoundChannel *StartSound(SoundHandle sfx, float vol, float pitch, int chanflags, FISoundChannel *reuse_chan, float startTime) override;
+	FISoundChannel *StartSound3D(SoundHandle sfx, SoundListener *listener, float vol, FRolloffInfo *rolloff, float distscale, float pitch, int priority, const FVector3 &pos, const FVector3 &vel, int channum, int chanflags, FISoundChannel *reuse_chan, float startTime) override;
+
+	void StopChannel(FISoundChannel *chan) override;
+	void ChannelVolume(FISoundChannel *chan, float volume) override;
+	void ChannelPitch(FISoundChannel *chan, float pitch) override;
+	void MarkStartTime(FISoundChannel *chan, float startTime) override;
+	unsigned int GetPosition(FISoundChannel *chan) override;
+	float GetAudibility(FISoundChannel *chan) override;
+	void Sync(bool sync) override;
+	void SetSfxPaused(bool paused, int slot) override;
+	void SetInactive(SoundRenderer::EInactiveState inactive) override;
+	void UpdateSoundParams3D(SoundListener *listener, FISoundChannel *chan, bool areasound, const FVector3 &pos, const FVector3 &vel) override;
+	void UpdateListener(SoundListener *) override;
+	void UpdateSounds() override;
+
+	bool IsValid() override;
+	void PrintStatus() override;
+	void PrintDriversList() override;
+	FString GatherStats() override;
+
+private:
+	FSoftVoice *AllocVoice(int priority, float dist_sqr, bool force);
+	void SetupVoice(FSoftVoice *voice, FSoftSample *sample, float vol, float pitch, int chanflags, FISoundChannel *reuse_chan, float startTime);
+	void CalcPanning(FSoftVoice *voice, const FVector3 &pos, bool areasound);
+	void MixerProc();
+	static FSoundChan *FindLowestChannel();
+
+	std::thread MixThread;
+	std::mutex MixLock;			// protects the voices
+	std::mutex StreamLock;		// protects the streams
+	std::atomic<bool> QuitThread;
+
+	FSoftSoundSink *Sink;
+	FSoftMixer Mixer;
+	int OutputRate;
+	int BlockSize;
+
+	TArray<FSoftVoice> Voices;
+	TArray<FSoftVoice *> FreeVoices;	// only used by the game thread
+	TArray<SoftSoundStream *> Streams;
+
+	float SfxVolume;
+	float MusicVolume;
+	int SFXPaused;
+	bool SyncPaused;
+	EInactiveState Inactive;
+	bool WasInWater;
+
+	FVector3 ListenerPos;
+	float ListenerAngle;
+	const ReverbContainer *PrevEnvironment;
+	const REVERB_PROPERTIES *PendingReverb;
+	bool ReverbChanged;
+
+	std::atomic<uint64_t> FramesMixed;
+	std::atomic<uint64_t> MixTimeNS;
+	std::atomic<int> ActiveVoices;
+
+	friend class SoftSoundStream;
+};
+
+#endif
@@ -62,6 +62,7 @@
 #	include <unistd.h>
 #	include <netdb.h>
 #	include <sys/ioctl.h>
+#	include <sys/wait.h>
 #	ifdef __sun
 #		include <fcntl.h>
 #	endif
@@ -900,6 +901,117 @@ bool JoinGame (int i)
 	return true;
 }
 
+//==========================================================================
+//
+// Loopback soak test
+//
+// -netsoak <nodes> hosts a game and starts the other nodes as copies of
+// this program that join it over loopback, without a window or sound.
+// They get the rest of the command line, too, so -iwad, -file,
+// -netsoaktime and settings like +net_fakeloss apply to all of them.
+// See Net_SoakTicker for what they do once the game runs.
+//
+//==========================================================================
+
+#ifdef __WIN32__
+static TArray<HANDLE> SoakNodes;
+#else
+static TArray<pid_t> SoakNodes;
+#endif
+
+static bool SpawnSoakNodes (int i)
+{
+	int numnodes = i < Args->NumArgs() - 1 ? atoi (Args->GetArg (i+1)) : 0;
+
+	if (numnodes < 2 || numnodes > MAXNETNODES)
+	{
+		I_FatalError ("-netsoak needs a node count from 2 to %d", MAXNETNODES);
+	}
+
+	FString address;
+	address.Format ("127.0.0.1:%d", DOOMPORT);
+
+	TArray<FString> args;
+	for (int j = 0; j < Args->NumArgs(); j++)
+	{
+		if (j != i && j != i+1)
+		{
+			args.Push (Args->GetArg (j));
+		}
+	}
+	args.Push ("-netsoaknode");
+	args.Push ("-join");
+	args.Push (address);
+	args.Push ("-nullvideo");
+	args.Push ("-nosound");
+
+	for (int node = 1; node < numnodes; node++)
+	{
+#ifdef __WIN32__
+		FString cmdline;
+		for (auto &arg : args)
+		{
+			cmdline.AppendFormat ("\"%s\" ", arg.GetChars());
+		}
+		std::wstring wcmdline = cmdline.WideString();
+		wchar_t exe[MAX_PATH];
+		STARTUPINFOW si = { sizeof(si) };
+		PROCESS_INFORMATION pi;
+
+		GetModuleFileNameW (NULL, exe, MAX_PATH);
+		if (!CreateProcessW (exe, &wcmdline[0], NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+		{
+			Printf ("Could not start soak test node %d\n", node);
+			return false;
+		}
+		CloseHandle (pi.hThread);
+		SoakNodes.Push (pi.hProcess);
+#else
+		TArray<char *> argv;
+		for (auto &arg : args)
+		{
+			argv.Push (arg.LockBuffer());
+		}
+		argv.Push (NULL);
+
+		pid_t pid = fork ();
+		if (pid == 0)
+		{
+#ifdef __linux__
+			execv ("/proc/self/exe", argv.Data());
+#endif
+			execvp (argv[0], argv.Data());
+			_exit (127);
+		}
+		if (pid < 0)
+		{
+			Printf ("Could not start soak test node %d: %s\n", node, strerror (errno));
+			return false;
+		}
+		SoakNodes.Push (pid);
+#endif
+	}
+	return true;
+}
+
+// Returns false once all nodes started by -netsoak have exited.
+bool I_NetSoakNodesRunning (void)
+{
+	for (unsigned i = SoakNodes.Size(); i-- > 0; )
+	{
+#ifdef __WIN32__
+		if (WaitForSingleObject (SoakNodes[i], 0) != WAIT_OBJECT_0)
+			continue;
+		CloseHandle (SoakNodes[i]);
+#else
+		if (waitpid (SoakNodes[i], NULL, WNOHANG) == 0)
+			continue;
+#endif
+		SoakNodes.Delete (i);
+	}
+	return SoakNodes.Size() > 0;
+}
+
 static int PrivateNetOf(in_addr in)
 {
 	int addr = ntohl(in.s_addr);
@@ -985,10 +1097,15 @@ int I_InitNetwork (void)
 	// parse network game options,
 	//		player 1: -host <numplayers>
 	//		player x: -join <player 1's address>
+	//		soak test: -netsoak <numnodes>, which starts the other nodes, too
 	if ( (i = Args->CheckParm ("-host")) )
 	{
 		if (!HostGame (i)) return -1;
 	}
+	else if ( (i = Args->CheckParm ("-netsoak")) )
+	{
+		if (!SpawnSoakNodes (i) || !HostGame (i)) return -1;
+	}
 	else if ( (i = Args->CheckParm ("-join")) )
 	{
 		if (!JoinGame (i)) return -1;
@@ -11,6 +11,7 @@ void I_NetProgress(int val);
 void I_NetInit(const char* msg, int num);
 bool I_NetLoop(bool (*timer_callback)(void*), void* userdata);
 void I_NetDone();
+bool I_NetSoakNodesRunning();
 
 enum ENetConstants
 {
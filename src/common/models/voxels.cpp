@@ -233,9 +233,11 @@ FVoxel *R_LoadKVX(int lumpnum)
 			}
 
 			// Ensure all offsets are within bounds.
+			mipl->OccupiedY.Resize(mipl->SizeX * 2);
 			for (i = 0; i < mipl->SizeX; ++i)
 			{
 				int xoff = mipl->OffsetX[i];
+				int first = mipl->SizeY, last = -1;
 				for (j = 0; j < mipl->SizeY; ++j)
 				{
 					int yoff = mipl->OffsetXY[(mipl->SizeY + 1) * i + j];
@@ -244,7 +246,14 @@ FVoxel *R_LoadKVX(int lumpnum)
 						delete voxel;
 						return NULL;
 					}
+					if (yoff < mipl->OffsetXY[(mipl->SizeY + 1) * i + j + 1])
+					{
+						first = min(first, j);
+						last = j;
+					}
 				}
+				mipl->OccupiedY[i * 2] = last < 0 ? 0 : first;
+				mipl->OccupiedY[i * 2 + 1] = last + 1;
 			}
 
 			// Record slab location for the end.
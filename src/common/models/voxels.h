@@ -38,6 +38,7 @@ struct FVoxelMipLevel
 	DVector3	Pivot;
 	int			*OffsetX;
 	short		*OffsetXY;
+	TArray<short> OccupiedY;	// per x, the first and one past the last y that have slabs
 private:
 	uint8_t	*SlabData;
 	TArray<uint8_t> SlabDataRemapped;
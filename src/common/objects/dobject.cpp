@@ -226,7 +226,7 @@ void DObject::InPlaceConstructor (void *mem)
 DObject::DObject ()
 : Class(0), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = (GC::CurrentWhite & OF_WhiteBits) | OF_Young;
 	ObjNext = GC::Root;
 	GCNext = nullptr;
 	GC::Root = this;
@@ -235,7 +235,7 @@ DObject::DObject ()
 DObject::DObject (PClass *inClass)
 : Class(inClass), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = (GC::CurrentWhite & OF_WhiteBits) | OF_Young;
 	ObjNext = GC::Root;
 	GCNext = nullptr;
 	GC::Root = this;
@@ -267,18 +267,18 @@ private:
 
 	void *operator new(size_t len, nonew&)
 	{
-		return M_Calloc(len, 1);
+		return GC::AllocObject(len, true);
 	}
 public:
 
 	void operator delete (void *mem, nonew&)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	// GC fiddling
@@ -345,7 +345,7 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		GC::FreeObject (mem);
 	}
 
 	template<typename T, typename... Args>
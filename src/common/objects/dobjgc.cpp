@@ -56,12 +56,19 @@
 
 // HEADER FILES ------------------------------------------------------------
 
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
 #include "dobject.h"
 
 #include "c_dispatch.h"
 #include "menu.h"
 #include "stats.h"
 #include "printf.h"
+#include "c_cvars.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -106,6 +113,21 @@
 // Cost of destroying an object
 #define GCDESTROYCOST		15
 
+// Objects are allocated from slabs in size classes of this granularity
+#define POOLGRANULARITY		16
+
+// Larger objects go directly to the heap
+#define POOLMAXSIZE			4096
+
+// Size of one slab
+#define POOLSLABSIZE		65536
+
+// Each pooled block starts with a header that identifies its size class
+#define POOLHEADERSIZE		16
+
+// Freed heap blocks are handed to the release thread in batches of this size
+#define RELEASEBATCH		64
+
 // TYPES -------------------------------------------------------------------
 
 class FAveragizer
@@ -124,6 +146,60 @@ public:
 	size_t GetAverage();
 };
 
+struct FPoolBlock
+{
+	FPoolBlock *Next;
+};
+
+struct alignas(POOLHEADERSIZE) FPoolHeader
+{
+	uint32_t SizeClass;
+};
+
+static_assert(sizeof(FPoolHeader) == POOLHEADERSIZE, "Pool header must keep objects aligned");
+
+struct FPoolStats
+{
+	size_t SlabBytes;		// memory reserved for slabs
+	size_t PooledBytes;		// memory of pooled blocks handed out
+	size_t LiveObjects;
+	size_t Allocs;
+	size_t Frees;
+	size_t LargeAllocs;		// allocations too large for the pool
+	size_t TrimmedSlabs;	// slabs returned to the system
+	size_t ClearedHits;		// cleared allocations served from a fresh slab
+	size_t ClearedMisses;	// cleared allocations that had to clear a reused block
+	cycle_t ClearTime;		// time spent clearing reused blocks
+};
+
+struct FPauseStats
+{
+	// Upper bounds of the histogram buckets in milliseconds. The last bucket
+	// takes everything above the final bound.
+	static inline constexpr double Bounds[] = { 0.05, 0.1, 0.25, 0.5, 1, 2, 4 };
+	static inline constexpr unsigned NumBuckets = countof(Bounds) + 1;
+
+	int Buckets[NumBuckets];
+	int Steps;
+	int Tics;
+	int BusyTics;			// tics that did any collection work
+	double TotalTime;
+	double MaxPause;
+	size_t Released;		// heap blocks freed on the game thread
+	double ReleaseTime;
+
+	void AddPause(double ms);
+	void Format(FString &out);
+	void Reset();
+};
+
+struct FYoungStats
+{
+	size_t Died;			// objects that did not survive their first sweep
+	size_t Survived;		// objects that did
+	size_t DiedBytes;
+};
+
 struct FStepStats
 {
 	cycle_t Clock[GC::GCS_COUNT];
@@ -134,6 +210,30 @@ struct FStepStats
 	void Reset();
 };
 
+// Frees the heap memory of objects too large for the pool on a background
+// thread. The objects have already been destroyed and their memory has
+// been reported as freed on the game thread, so the thread only calls
+// free(). With the pool's free lists being game thread only, pooled
+// blocks are not worth handing over.
+class FReleaseThread
+{
+public:
+	void Queue(void *block);
+	void Flush();
+
+	std::atomic<size_t> Released{ 0 };
+	std::atomic<uint64_t> ReleaseTimeNS{ 0 };
+
+private:
+	void Run();
+
+	TArray<void *> Pending;		// game thread only
+	TArray<void *> Incoming;	// protected by Lock
+	std::mutex Lock;
+	std::condition_variable Wake;
+	bool Started = false;
+};
+
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -144,6 +244,8 @@ static size_t CalcStepSize();
 
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
 
+EXTERN_CVAR(Bool, gc_concurrentfree)
+
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
 namespace GC
@@ -172,6 +274,21 @@ bool HadToDestroy;
 static FAveragizer AllocHistory;// Tracks allocation rate over time
 static cycle_t GCTime;			// Track time spent in GC
 
+enum
+{
+	NumPoolClasses = POOLMAXSIZE / POOLGRANULARITY,
+	LargeObject = 0xffffffffu
+};
+static FPoolBlock *PoolFreeLists[NumPoolClasses];
+static TArray<uint8_t *> PoolSlabs[NumPoolClasses];
+static FPoolBlock *PoolClearedLists[NumPoolClasses];
+static FPoolStats PoolStats;
+static bool PoolBypass;			// PoolBenchmark's heap run: everything goes to M_Malloc
+static FReleaseThread *Releaser;
+static FPauseStats PauseStats;
+static FYoungStats YoungStats;
+static FYoungStats PrevYoungStats;
+
 // CODE --------------------------------------------------------------------
 
 //==========================================================================
@@ -187,9 +304,11 @@ void CheckGC()
 {
 	AllocHistory.AddAlloc(RunningAllocBytes);
 	RunningAllocBytes = 0;
+	PauseStats.Tics++;
 	if (State > GCS_Pause || AllocBytes >= Threshold)
 	{
 		Step();
+		PauseStats.BusyTics++;
 	}
 }
 
@@ -230,7 +349,8 @@ size_t PropagateMark()
 // SweepObjects
 //
 // Runs a limited sweep on the object list, returning the number of bytes
-// swept.
+// swept. Objects seeing their first sweep are counted separately, so the
+// stats show how many objects die young.
 //
 //==========================================================================
 
@@ -242,16 +362,28 @@ static size_t SweepObjects(size_t count)
 
 	while ((curr = *SweepPos) != nullptr && count-- > 0)
 	{
-		swept += curr->GetClass()->Size;
+		const size_t size = curr->GetClass()->Size;
+		swept += size;
 		if ((curr->ObjectFlags ^ OF_WhiteBits) & deadmask)	// not dead?
 		{
 			assert(!curr->IsDead() || (curr->ObjectFlags & OF_Fixed));
+			if (curr->ObjectFlags & OF_Young)
+			{
+				curr->ObjectFlags &= ~OF_Young;
+				YoungStats.Survived++;
+			}
 			curr->MakeWhite();	// make it white (for next cycle)
 			SweepPos = &curr->ObjNext;
 		}
 		else
 		{
 			assert(curr->IsDead());
+			if (curr->ObjectFlags & OF_Young)
+			{
+				curr->ObjectFlags &= ~OF_Young;
+				YoungStats.Died++;
+				YoungStats.DiedBytes += size;
+			}
 			if (!(curr->ObjectFlags & OF_EuthanizeMe))
 			{	// The object must be destroyed before it can be deleted.
 				curr->GCNext = ToDestroy;
@@ -372,6 +504,8 @@ static void MarkRoot()
 {
 	PrevStepStats = StepStats;
 	StepStats.Reset();
+	PrevYoungStats = YoungStats;
+	YoungStats = {};
 
 	Gray = nullptr;
 
@@ -537,7 +671,12 @@ void Step()
 
 	StepStats.Clock[enter_state].Unclock();
 	StepStats.BytesCovered[enter_state] += did;
+	if (Releaser != nullptr)
+	{
+		Releaser->Flush();
+	}
 	GCTime.Unclock();
+	PauseStats.AddPause(GCTime.TimeMS());
 }
 
 //==========================================================================
@@ -578,6 +717,315 @@ void FullGC()
 			ContinueCheck |= HadToDestroy;
 		} while (HadToDestroy);
 	}
+	if (Releaser != nullptr)
+	{
+		Releaser->Flush();
+	}
+}
+
+//==========================================================================
+//
+// RefillPool
+//
+// Carves a new slab into free blocks of the given size class. The slab
+// comes from calloc, so its blocks go onto the cleared list.
+//
+//==========================================================================
+
+static void RefillPool(unsigned sizeclass)
+{
+	const size_t blocksize = (sizeclass + 1) * POOLGRANULARITY;
+	uint8_t *slab = (uint8_t *)calloc(1, POOLSLABSIZE);
+
+	if (slab == nullptr)
+	{
+		I_FatalError("Could not allocate object pool slab");
+	}
+	PoolStats.SlabBytes += POOLSLABSIZE;
+	PoolSlabs[sizeclass].Push(slab);
+
+	FPoolBlock *&list = PoolClearedLists[sizeclass];
+	for (size_t ofs = 0; ofs + blocksize <= POOLSLABSIZE; ofs += blocksize)
+	{
+		FPoolBlock *block = (FPoolBlock *)(slab + ofs);
+		block->Next = list;
+		list = block;
+	}
+}
+
+//==========================================================================
+//
+// TrimPool
+//
+// Returns slabs to the system whose blocks are all free. Finding them
+// means walking every free list, so this is meant for points where a lot
+// of objects have just died, like a level change, not for every step.
+//
+//==========================================================================
+
+static unsigned FindSlab(const TArray<uint8_t *> &slabs, FPoolBlock *block)
+{
+	// slabs is sorted, so this is the last slab starting at or below the block.
+	return unsigned(std::upper_bound(slabs.begin(), slabs.end(), (uint8_t *)block) - slabs.begin() - 1);
+}
+
+static FPoolBlock *RemoveSlabBlocks(FPoolBlock *head, const TArray<uint8_t *> &slabs, const TArray<bool> &release)
+{
+	FPoolBlock **link = &head;
+
+	while (*link != nullptr)
+	{
+		FPoolBlock *block = *link;
+		if (release[FindSlab(slabs, block)])
+		{
+			*link = block->Next;
+		}
+		else
+		{
+			link = &block->Next;
+		}
+	}
+	return head;
+}
+
+void TrimPool()
+{
+	TArray<unsigned> freeblocks;
+	TArray<bool> release;
+
+	for (unsigned sizeclass = 0; sizeclass < NumPoolClasses; sizeclass++)
+	{
+		auto &slabs = PoolSlabs[sizeclass];
+		if (slabs.Size() == 0)
+		{
+			continue;
+		}
+
+		const unsigned blocksperslab = POOLSLABSIZE / ((sizeclass + 1) * POOLGRANULARITY);
+		std::sort(slabs.begin(), slabs.end());
+
+		freeblocks.Resize(slabs.Size());
+		memset(freeblocks.Data(), 0, freeblocks.Size() * sizeof(unsigned));
+		for (FPoolBlock *block = PoolFreeLists[sizeclass]; block != nullptr; block = block->Next)
+		{
+			freeblocks[FindSlab(slabs, block)]++;
+		}
+		for (FPoolBlock *block = PoolClearedLists[sizeclass]; block != nullptr; block = block->Next)
+		{
+			freeblocks[FindSlab(slabs, block)]++;
+		}
+
+		bool any = false;
+		release.Resize(slabs.Size());
+		for (unsigned i = 0; i < slabs.Size(); i++)
+		{
+			release[i] = freeblocks[i] == blocksperslab;
+			any |= release[i];
+		}
+		if (!any)
+		{
+			continue;
+		}
+
+		PoolFreeLists[sizeclass] = RemoveSlabBlocks(PoolFreeLists[sizeclass], slabs, release);
+		PoolClearedLists[sizeclass] = RemoveSlabBlocks(PoolClearedLists[sizeclass], slabs, release);
+
+		unsigned kept = 0;
+		for (unsigned i = 0; i < slabs.Size(); i++)
+		{
+			if (release[i])
+			{
+				free(slabs[i]);
+				PoolStats.SlabBytes -= POOLSLABSIZE;
+				PoolStats.TrimmedSlabs++;
+			}
+			else
+			{
+				slabs[kept++] = slabs[i];
+			}
+		}
+		slabs.Resize(kept);
+	}
+}
+
+//==========================================================================
+//
+// AllocObject
+//
+// Allocates memory for a DObject. Objects are served from per-size-class
+// free lists so that short-lived objects can reuse each other's memory.
+// The size class is stored in front of the object because scripted
+// classes are larger than their native base, so the size passed to
+// operator delete cannot be used for this.
+//
+// Each size class has a list of reused blocks and a list of blocks from
+// fresh slabs, which are still clear. Callers that need cleared memory
+// take from the latter first, everything else prefers reused blocks.
+//
+//==========================================================================
+
+void *AllocObject(size_t size, bool zero)
+{
+	const size_t blocksize = size + POOLHEADERSIZE;
+	FPoolHeader *header;
+
+	PoolStats.Allocs++;
+	PoolStats.LiveObjects++;
+	if (blocksize > POOLMAXSIZE || PoolBypass)
+	{
+		header = (FPoolHeader *)(zero ? M_Calloc(blocksize, 1) : M_Malloc(blocksize));
+		header->SizeClass = LargeObject;
+		if (!PoolBypass) PoolStats.LargeAllocs++;
+		return header + 1;
+	}
+
+	const unsigned sizeclass = unsigned((blocksize - 1) / POOLGRANULARITY);
+	FPoolBlock *&cleared = PoolClearedLists[sizeclass];
+	FPoolBlock *block;
+
+	if (PoolFreeLists[sizeclass] == nullptr && cleared == nullptr)
+	{
+		RefillPool(sizeclass);
+	}
+	if (cleared != nullptr && (zero || PoolFreeLists[sizeclass] == nullptr))
+	{
+		block = cleared;
+		cleared = block->Next;
+		// The link was written into the header, so the object itself is
+		// still clear.
+		if (zero) PoolStats.ClearedHits++;
+	}
+	else
+	{
+		block = PoolFreeLists[sizeclass];
+		PoolFreeLists[sizeclass] = block->Next;
+		if (zero)
+		{
+			PoolStats.ClearedMisses++;
+			PoolStats.ClearTime.Clock();
+			memset((void *)block, 0, blocksize);
+			PoolStats.ClearTime.Unclock();
+		}
+	}
+
+	header = (FPoolHeader *)block;
+	header->SizeClass = sizeclass;
+
+	const size_t pooledsize = (sizeclass + 1) * POOLGRANULARITY;
+	PoolStats.PooledBytes += pooledsize;
+	ReportAlloc(pooledsize);
+	return header + 1;
+}
+
+//==========================================================================
+//
+// FreeObject
+//
+// Returns an object's memory to its size class. Objects too large for the
+// pool are freed by the release thread with gc_concurrentfree.
+//
+//==========================================================================
+
+void FreeObject(void *mem)
+{
+	if (mem == nullptr)
+	{
+		return;
+	}
+
+	FPoolHeader *header = (FPoolHeader *)mem - 1;
+
+	PoolStats.Frees++;
+	PoolStats.LiveObjects--;
+	if (header->SizeClass == LargeObject)
+	{
+		if (PoolBypass)
+		{
+			M_Free(header);
+		}
+		else if (gc_concurrentfree && !PClass::bShutdown)
+		{
+			if (Releaser == nullptr)
+			{
+				// Never deleted, so that objects freed during static
+				// destruction can still be queued safely.
+				Releaser = new FReleaseThread;
+			}
+			ReportDealloc(_msize(header));
+			Releaser->Queue(header);
+		}
+		else
+		{
+			cycle_t time;
+			time.ResetAndClock();
+			M_Free(header);
+			time.Unclock();
+			PauseStats.Released++;
+			PauseStats.ReleaseTime += time.TimeMS();
+		}
+	}
+	else
+	{
+		const unsigned sizeclass = header->SizeClass;
+		assert(sizeclass < NumPoolClasses);
+
+		const size_t pooledsize = (sizeclass + 1) * POOLGRANULARITY;
+		PoolStats.PooledBytes -= pooledsize;
+		ReportDealloc(pooledsize);
+
+		FPoolBlock *block = (FPoolBlock *)header;
+		block->Next = PoolFreeLists[sizeclass];
+		PoolFreeLists[sizeclass] = block;
+	}
+}
+
+//==========================================================================
+//
+// PoolBenchmark
+//
+// Measures the throughput of creating and deleting objects, once with the
+// pool and once with the pool bypassed. Both runs do the same object
+// setup, so the difference is down to the allocator.
+//
+//==========================================================================
+
+static double PoolBenchmarkRun(int count, PClass *cls, bool bypass)
+{
+	TArray<DObject *> objects(1024, true);
+	cycle_t time;
+
+	time.Reset();
+	PoolBypass = bypass;
+	// Create and delete objects in batches, the way a burst of projectiles would.
+	time.Clock();
+	for (int done = 0; done < count; done += objects.Size())
+	{
+		for (auto &obj : objects)
+		{
+			obj = cls->CreateNew();
+		}
+		for (unsigned i = objects.Size(); i-- > 0; )
+		{
+			objects[i]->ObjectFlags |= OF_YesReallyDelete;
+			delete objects[i];
+		}
+	}
+	time.Unclock();
+	PoolBypass = false;
+	return time.TimeMS();
+}
+
+static void PoolBenchmark(int count, PClass *cls)
+{
+	const double pooltime = PoolBenchmarkRun(count, cls, false);
+	const double heaptime = PoolBenchmarkRun(count, cls, true);
+
+	const int total = (count + 1023) / 1024 * 1024;
+	Printf("%d %s objects (%zu bytes): pool %.2f ms (%.0f/s), heap %.2f ms (%.0f/s), speedup %.2fx\n",
+		total, cls->TypeName.GetChars(), cls->Size,
+		pooltime, total / (pooltime * 0.001),
+		heaptime, total / (heaptime * 0.001),
+		pooltime > 0 ? heaptime / pooltime : 0.);
 }
 
 //==========================================================================
@@ -698,6 +1146,91 @@ void DelSoftRoot(DObject *obj)
 
 }
 
+CUSTOM_CVAR(Bool, gc_concurrentfree, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (!self && GC::Releaser != nullptr)
+	{
+		GC::Releaser->Flush();
+	}
+}
+
+//==========================================================================
+//
+// FReleaseThread :: Queue
+//
+// Adds a freed block to the current batch. Full batches are passed on to
+// the release thread.
+//
+//==========================================================================
+
+void FReleaseThread::Queue(void *block)
+{
+	Pending.Push(block);
+	if (Pending.Size() >= RELEASEBATCH)
+	{
+		Flush();
+	}
+}
+
+//==========================================================================
+//
+// FReleaseThread :: Flush
+//
+// Hands all pending blocks to the release thread, starting it if needed.
+//
+//==========================================================================
+
+void FReleaseThread::Flush()
+{
+	if (Pending.Size() == 0)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		if (!Started)
+		{
+			std::thread(&FReleaseThread::Run, this).detach();
+			Started = true;
+		}
+		Incoming.Append(Pending);
+	}
+	Pending.Clear();
+	Wake.notify_one();
+}
+
+//==========================================================================
+//
+// FReleaseThread :: Run
+//
+// The release thread. Its time is what the game thread would have spent
+// freeing these blocks itself, so 'stat gc' shows it as saved.
+//
+//==========================================================================
+
+void FReleaseThread::Run()
+{
+	TArray<void *> blocks;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(Lock);
+			Wake.wait(lock, [this] { return Incoming.Size() > 0; });
+			std::swap(blocks, Incoming);
+		}
+		cycle_t time;
+		time.ResetAndClock();
+		for (auto block : blocks)
+		{
+			M_FreeUnreported(block);
+		}
+		time.Unclock();
+		Released.fetch_add(blocks.Size(), std::memory_order_relaxed);
+		ReleaseTimeNS.fetch_add(uint64_t(time.TimeMS() * 1e6), std::memory_order_relaxed);
+		blocks.Clear();
+	}
+}
+
 //==========================================================================
 //
 // FAveragizer - Constructor
@@ -744,6 +1277,67 @@ size_t FAveragizer::GetAverage()
 	return TotalCount != 0 ? TotalAmount / TotalCount : 0;
 }
 
+//==========================================================================
+//
+// FPauseStats :: AddPause
+//
+//==========================================================================
+
+void FPauseStats::AddPause(double ms)
+{
+	unsigned bucket = 0;
+	while (bucket < countof(Bounds) && ms > Bounds[bucket])
+	{
+		bucket++;
+	}
+	Buckets[bucket]++;
+	Steps++;
+	TotalTime += ms;
+	if (ms > MaxPause)
+	{
+		MaxPause = ms;
+	}
+}
+
+//==========================================================================
+//
+// FPauseStats :: Reset
+//
+//==========================================================================
+
+void FPauseStats::Reset()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+//==========================================================================
+//
+// FPauseStats :: Format
+//
+// Appends the pause histogram to the given FString.
+//
+//==========================================================================
+
+void FPauseStats::Format(FString &out)
+{
+	out << "Pauses:";
+	for (unsigned i = 0; i < NumBuckets; ++i)
+	{
+		if (i < countof(Bounds))
+		{
+			out.AppendFormat(" <%g:%d", Bounds[i], Buckets[i]);
+		}
+		else
+		{
+			out.AppendFormat(" >%g:%d", Bounds[i - 1], Buckets[i]);
+		}
+	}
+	out.AppendFormat("  Max:%.2fms  Tic:%.3fms (%d%% busy)",
+		MaxPause,
+		Tics != 0 ? TotalTime / Tics : 0.,
+		Tics != 0 ? BusyTics * 100 / Tics : 0);
+}
+
 //==========================================================================
 //
 // STAT gc
@@ -775,6 +1369,33 @@ ADD_STAT(gc)
 		(GC::AllocBytes + 1023) >> 10,
 		(GC::Estimate + 1023) >> 10,
 		(GC::Threshold + 1023) >> 10);
+
+	auto &pool = GC::PoolStats;
+	out.AppendFormat("\nPool: Objects:%7zu  Slabs:%6zuK  Used:%6zuK (%3zu%%)  Allocs:%9zu  Frees:%9zu  Large:%6zu  Trimmed:%5zu",
+		pool.LiveObjects,
+		(pool.SlabBytes + 1023) >> 10,
+		(pool.PooledBytes + 1023) >> 10,
+		pool.SlabBytes ? pool.PooledBytes * 100 / pool.SlabBytes : 0,
+		pool.Allocs, pool.Frees, pool.LargeAllocs, pool.TrimmedSlabs);
+
+	out.AppendFormat("\nClear: Fresh:%9zu  Reused:%9zu (%.2fms)",
+		pool.ClearedHits, pool.ClearedMisses, pool.ClearTime.TimeMS());
+
+	// The time the release thread spent is the tic time it saved.
+	auto &pause = GC::PauseStats;
+	const int tics = max(pause.Tics, 1);
+	const size_t bgreleased = GC::Releaser != nullptr ? GC::Releaser->Released.load(std::memory_order_relaxed) : 0;
+	const double bgtime = GC::Releaser != nullptr ? GC::Releaser->ReleaseTimeNS.load(std::memory_order_relaxed) * 1e-6 : 0.;
+	out.AppendFormat("\nRelease: Game:%8zu (%.3fms/tic)  Background:%8zu (%.3fms/tic saved)%s",
+		pause.Released, pause.ReleaseTime / tics, bgreleased, bgtime / tics,
+		gc_concurrentfree ? "" : "  [off]");
+
+	auto &young = GC::PrevYoungStats;
+	const size_t swept = young.Died + young.Survived;
+	out.AppendFormat("\nYoung: Died:%7zu (%6zuK)  Survived:%7zu  Mortality:%3zu%%\n",
+		young.Died, (young.DiedBytes + 1023) >> 10, young.Survived,
+		swept != 0 ? young.Died * 100 / swept : 0);
+	GC::PauseStats.Format(out);
 	return out;
 }
 
@@ -830,7 +1451,7 @@ CCMD(gc)
 {
 	if (argv.argc() == 1)
 	{
-		Printf ("Usage: gc stop|now|full|count|pause [size]|stepmul [size]\n");
+		Printf ("Usage: gc stop|now|full|count|pause [size]|stepmul [size]|bench [count]|trim|resetstats\n");
 		return;
 	}
 	if (stricmp(argv[1], "stop") == 0)
@@ -873,5 +1494,26 @@ CCMD(gc)
 			GC::StepMul = max(100, atoi(argv[2]));
 		}
 	}
+	else if (stricmp(argv[1], "resetstats") == 0)
+	{
+		GC::PauseStats.Reset();
+		if (GC::Releaser != nullptr)
+		{
+			GC::Releaser->Released = 0;
+			GC::Releaser->ReleaseTimeNS = 0;
+		}
+	}
+	else if (stricmp(argv[1], "bench") == 0)
+	{
+		// Only plain DObjects are used here. Anything derived may register
+		// itself with game state in its constructor and must be destroyed
+		// properly instead of just being deleted.
+		int count = argv.argc() > 2 ? max(1, atoi(argv[2])) : 100000;
+		GC::PoolBenchmark(count, RUNTIME_CLASS(DObject));
+	}
+	else if (stricmp(argv[1], "trim") == 0)
+	{
+		GC::TrimPool();
+	}
 }
 
@@ -26,6 +26,7 @@ enum EObjectFlags
 	OF_Transient		= 1 << 11,		// Object should not be archived (references to it will be nulled on disk)
 	OF_Spawned			= 1 << 12,      // Thinker was spawned at all (some thinkers get deleted before spawning)
 	OF_Released			= 1 << 13,		// Object was released from the GC system and should not be processed by GC function
+	OF_Young			= 1 << 14,		// Object has not been through a sweep yet
 };
 
 template<class T> class TObjPtr;
@@ -174,6 +175,14 @@ namespace GC
 	using GCMarkerFunc = void(*)();
 	void AddMarkerFunc(GCMarkerFunc func);
 
+	// Allocates and frees the memory for DObjects from the object pool.
+	// If zero is set, the returned memory is cleared.
+	void *AllocObject(size_t size, bool zero = false);
+	void FreeObject(void *mem);
+
+	// Returns completely unused pool memory to the system.
+	void TrimPool();
+
 	// Report an allocation to the GC
 	static inline void ReportAlloc(size_t alloc)
 	{
@@ -422,18 +422,16 @@ PClass *PClass::FindClass (FName zaname)
 
 DObject *PClass::CreateNew()
 {
-	uint8_t *mem = (uint8_t *)M_Malloc (Size);
+	uint8_t *mem = (uint8_t *)GC::AllocObject (Size, Defaults == nullptr);
 	assert (mem != nullptr);
 
 	// Set this object's defaults before constructing it.
 	if (Defaults != nullptr)
 		memcpy (mem, Defaults, Size);
-	else
-		memset (mem, 0, Size);
 
 	if (ConstructNative == nullptr || bAbstract)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 		I_Error("Attempt to instantiate abstract class %s.", TypeName.GetChars());
 	}
 	ConstructNative (mem);
@@ -37,6 +37,7 @@
 #include <sys/sysctl.h>
 
 #include "i_system.h"
+#include "i_sound.h"
 #include "st_console.h"
 #include "v_text.h"
 
@@ -193,3 +194,16 @@ void I_OpenShellFolder(const char* folder)
 	[filemgr changeCurrentDirectoryPath:currentpath];
 }
 
+//==========================================================================
+//
+// I_CreateSoundDeviceSink
+//
+// The software mixer has no way to play through a sound device here yet.
+//
+//==========================================================================
+
+FSoftSoundSink *I_CreateSoundDeviceSink(int rate, int blocksize)
+{
+	return nullptr;
+}
+
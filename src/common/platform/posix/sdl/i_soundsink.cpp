@@ -0,0 +1,121 @@
+/*
+** i_soundsink.cpp
+** Plays the software mixer's output through SDL audio
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <SDL.h>
+
+#include "softsound.h"
+#include "printf.h"
+#include "v_text.h"
+
+//==========================================================================
+//
+// FSDLSoundSink
+//
+// The mixer thread pushes its blocks into SDL's queue. It paces itself
+// with the system clock rather than the device, so if the device is a bit
+// slower, the queue gets trimmed by dropping a block before it can add
+// noticeable latency.
+//
+//==========================================================================
+
+class FSDLSoundSink : public FSoftSoundSink
+{
+public:
+	FSDLSoundSink(int rate, int blocksize)
+	{
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+		{
+			Printf(TEXTCOLOR_RED "Could not initialize SDL audio: %s\n", SDL_GetError());
+			return;
+		}
+
+		// The device buffer should hold two mixer blocks, so that the mixer
+		// thread getting scheduled late doesn't immediately cause a dropout.
+		int samples = 64;
+		while (samples < blocksize * 2) samples <<= 1;
+
+		SDL_AudioSpec want = {}, have;
+		want.freq = rate;
+		want.format = AUDIO_F32SYS;
+		want.channels = 2;
+		want.samples = (Uint16)samples;
+
+		// SDL converts to whatever the device wants, so the mixer always gets the format it asked for.
+		Device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+		if (Device == 0)
+		{
+			Printf(TEXTCOLOR_RED "Could not open the SDL audio device: %s\n", SDL_GetError());
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+			return;
+		}
+		MaxQueued = Uint32(blocksize * 8 * 2 * sizeof(float));
+		SDL_PauseAudioDevice(Device, 0);
+	}
+
+	~FSDLSoundSink()
+	{
+		if (Device != 0)
+		{
+			SDL_CloseAudioDevice(Device);
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		}
+	}
+
+	bool IsValid() override
+	{
+		return Device != 0;
+	}
+
+	void Write(const float *stereo, int frames) override
+	{
+		if (SDL_GetQueuedAudioSize(Device) < MaxQueued)
+		{
+			SDL_QueueAudio(Device, stereo, frames * 2 * sizeof(float));
+		}
+	}
+
+	const char *GetName() override
+	{
+		return "sdl";
+	}
+
+private:
+	SDL_AudioDeviceID Device = 0;
+	Uint32 MaxQueued = 0;
+};
+
+FSoftSoundSink *I_CreateSoundDeviceSink(int rate, int blocksize)
+{
+	return new FSDLSoundSink(rate, blocksize);
+}
@@ -997,3 +997,16 @@ void I_OpenShellFolder(const char* infolder)
 	}
 }
 
+//==========================================================================
+//
+// I_CreateSoundDeviceSink
+//
+// The software mixer has no way to play through a sound device here yet.
+//
+//==========================================================================
+
+FSoftSoundSink *I_CreateSoundDeviceSink(int rate, int blocksize)
+{
+	return nullptr;
+}
+
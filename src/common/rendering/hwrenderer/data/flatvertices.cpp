@@ -146,16 +146,63 @@ void FFlatVertexBuffer::OutputResized(int width, int height)
 //
 //==========================================================================
 
+struct FThreadVertexRegion
+{
+	bool active;
+	unsigned int current, end;
+};
+
+static thread_local FThreadVertexRegion threadRegion;
+
 std::pair<FFlatVertex *, unsigned int> FFlatVertexBuffer::AllocVertices(unsigned int count)
 {
-	FFlatVertex *p = GetBuffer();
-	auto index = mCurIndex.fetch_add(count);
+	unsigned int index;
+	if (threadRegion.active && count <= THREAD_REGION_MAXALLOC)
+	{
+		if (threadRegion.current + count > threadRegion.end)
+		{
+			// The rest of the old region is lost, but that's never more than THREAD_REGION_MAXALLOC vertices.
+			threadRegion.current = mCurIndex.fetch_add(THREAD_REGION_SIZE);
+			threadRegion.end = threadRegion.current + THREAD_REGION_SIZE;
+		}
+		index = threadRegion.current;
+		threadRegion.current += count;
+	}
+	else
+	{
+		index = mCurIndex.fetch_add(count);
+	}
 	if (index + count >= BUFFER_SIZE_TO_USE)
 	{
 		// If a single scene needs 2'000'000 vertices there must be something very wrong. 
 		I_FatalError("Out of vertex memory. Tried to allocate more than %u vertices for a single frame", index + count);
 	}
-	return std::make_pair(p, index);
+	// The pointer must be taken from the index, not from mCurIndex, because other threads may have allocated in between.
+	return std::make_pair(GetBuffer(index), index);
+}
+
+//==========================================================================
+//
+// Lets the calling thread allocate small vertex blocks from a region
+// of its own until EndThreadRegion gets called.
+//
+//==========================================================================
+
+void FFlatVertexBuffer::BeginThreadRegion()
+{
+	threadRegion.active = true;
+	threadRegion.current = threadRegion.end = 0;
+}
+
+void FFlatVertexBuffer::EndThreadRegion()
+{
+	// If nobody allocated anything after this thread's region, the unused part can be given back.
+	unsigned int end = threadRegion.end;
+	if (threadRegion.current < end)
+	{
+		mCurIndex.compare_exchange_strong(end, threadRegion.current);
+	}
+	threadRegion.active = false;
 }
 
 //==========================================================================
@@ -78,6 +78,11 @@ public:
 	static const unsigned int BUFFER_SIZE = 2000000;
 	static const unsigned int BUFFER_SIZE_TO_USE = BUFFER_SIZE-500;
 
+	// Threads that allocate a lot of small vertex blocks concurrently get their own
+	// region of the buffer so that they do not all contend on mCurIndex.
+	static const unsigned int THREAD_REGION_SIZE = 256;
+	static const unsigned int THREAD_REGION_MAXALLOC = THREAD_REGION_SIZE / 4;
+
 public:
 	enum
 	{
@@ -113,6 +118,8 @@ public:
 	}
 
 	std::pair<FFlatVertex *, unsigned int> AllocVertices(unsigned int count);
+	void BeginThreadRegion();
+	void EndThreadRegion();
 
 	void Reset()
 	{
@@ -0,0 +1,157 @@
+/*
+** hw_nullbackend.cpp
+** Hardware backend that only records what would have been drawn
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include "hw_nullbackend.h"
+#include "flatvertices.h"
+#include "hw_skydome.h"
+#include "hw_viewpointbuffer.h"
+#include "hw_lightbuffer.h"
+#include "hw_bonebuffer.h"
+
+//===========================================================================
+//
+// FNullBuffer
+//
+//===========================================================================
+
+void FNullBuffer::SetData(size_t size, const void *data, BufferUsageType type)
+{
+	mData.Resize((unsigned)size);
+	if (data != nullptr) memcpy(mData.Data(), data, size);
+	buffersize = size;
+	map = mData.Data();
+}
+
+void FNullBuffer::SetSubData(size_t offset, size_t size, const void *data)
+{
+	assert(offset + size <= buffersize);
+	memcpy(mData.Data() + offset, data, size);
+}
+
+void *FNullBuffer::Lock(unsigned int size)
+{
+	SetData(size, nullptr, BufferUsageType::Stream);
+	return map;
+}
+
+void FNullBuffer::Resize(size_t newsize)
+{
+	mData.Resize((unsigned)newsize);
+	buffersize = newsize;
+	map = mData.Data();
+}
+
+//===========================================================================
+//
+// FNullRenderState
+//
+//===========================================================================
+
+void FNullRenderState::Draw(int dt, int index, int count, bool apply)
+{
+	DrawCalls++;
+	Vertices += count;
+}
+
+void FNullRenderState::DrawIndexed(int dt, int index, int count, bool apply)
+{
+	DrawCalls++;
+	Vertices += count;
+}
+
+bool FNullRenderState::SetDepthClamp(bool on)
+{
+	bool res = mDepthClamp;
+	mDepthClamp = on;
+	return res;
+}
+
+//===========================================================================
+//
+// FNullFrameBuffer
+//
+//===========================================================================
+
+FNullFrameBuffer::FNullFrameBuffer(DFrameBuffer *real)
+	: mReal(real)
+{
+	SetVirtualSize(real->GetWidth(), real->GetHeight());
+	hwcaps = real->hwcaps;
+	glslversion = real->glslversion;
+	uniformblockalignment = real->uniformblockalignment;
+	maxuniformblock = real->maxuniformblock;
+	vendorstring = real->vendorstring != nullptr ? real->vendorstring : "";
+	mGameScreenWidth = real->mGameScreenWidth;
+	mGameScreenHeight = real->mGameScreenHeight;
+	mScreenViewport = real->mScreenViewport;
+	mSceneViewport = real->mSceneViewport;
+	mOutputLetterbox = real->mOutputLetterbox;
+	mPipelineType = real->mPipelineType;
+	mPipelineNbr = 1;
+	FrameTime = real->FrameTime;
+}
+
+FNullFrameBuffer::FNullFrameBuffer(int width, int height)
+	: mReal(nullptr)
+{
+	SetVirtualSize(width, height);
+	vendorstring = "null";
+	mPipelineNbr = 1;
+}
+
+FNullFrameBuffer::~FNullFrameBuffer()
+{
+	delete mBones;
+	delete mLights;
+	delete mViewpoints;
+	delete mSkyData;
+	delete mVertexData;
+}
+
+//===========================================================================
+//
+// The buffer wrappers get their buffers from 'screen', so this must be
+// called while the null frame buffer is the current screen.
+//
+//===========================================================================
+
+void FNullFrameBuffer::InitializeState()
+{
+	assert(screen == this);
+	mVertexData = new FFlatVertexBuffer(GetWidth(), GetHeight(), mPipelineNbr);
+	mSkyData = new FSkyVertexBuffer;
+	mViewpoints = new HWViewpointBuffer(mPipelineNbr);
+	mLights = new FLightBuffer(mPipelineNbr);
+	mBones = new BoneBuffer(mPipelineNbr);
+}
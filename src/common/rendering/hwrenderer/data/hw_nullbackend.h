@@ -0,0 +1,107 @@
+#pragma once
+
+#include "tarray.h"
+#include "buffers.h"
+#include "hw_renderstate.h"
+#include "v_video.h"
+
+//===========================================================================
+//
+// A hardware backend that draws nothing
+//
+// The scene code runs unchanged on top of it: buffers are plain memory and
+// the render state only counts the draw calls it gets. This allows timing
+// the CPU side of the hardware renderer without the driver and the GPU
+// in the numbers.
+//
+//===========================================================================
+
+class FNullBuffer : public IVertexBuffer, public IIndexBuffer, public IDataBuffer
+{
+	TArray<uint8_t> mData;
+
+public:
+	void SetData(size_t size, const void *data, BufferUsageType type) override;
+	void SetSubData(size_t offset, size_t size, const void *data) override;
+	void *Lock(unsigned int size) override;
+	void Unlock() override {}
+	void Resize(size_t newsize) override;
+
+	void SetFormat(int numBindingPoints, int numAttributes, size_t stride, const FVertexBufferAttribute *attrs) override {}
+	void BindRange(FRenderState *state, size_t start, size_t length) override {}
+};
+
+class FNullRenderState : public FRenderState
+{
+	bool mDepthClamp = true;
+
+public:
+	int DrawCalls = 0;
+	int Vertices = 0;
+
+	FNullRenderState()
+	{
+		Reset();
+	}
+
+	void ResetCounters()
+	{
+		DrawCalls = Vertices = 0;
+	}
+
+	void ClearScreen() override {}
+	void Draw(int dt, int index, int count, bool apply = true) override;
+	void DrawIndexed(int dt, int index, int count, bool apply = true) override;
+
+	bool SetDepthClamp(bool on) override;
+	void SetDepthMask(bool on) override {}
+	void SetDepthFunc(int func) override {}
+	void SetDepthRange(float min, float max) override {}
+	void SetColorMask(bool r, bool g, bool b, bool a) override {}
+	void SetStencil(int offs, int op, int flags = -1) override {}
+	void SetCulling(int mode) override {}
+	void EnableClipDistance(int num, bool state) override {}
+	void Clear(int targets) override {}
+	void EnableStencil(bool on) override {}
+	void SetScissor(int x, int y, int w, int h) override {}
+	void SetViewport(int x, int y, int w, int h) override {}
+	void EnableDepthTest(bool on) override {}
+	void EnableMultisampling(bool on) override {}
+	void EnableLineSmooth(bool on) override {}
+	void EnableDrawBuffers(int count, bool apply = false) override {}
+};
+
+// Stands in for the real frame buffer while it is the current screen.
+// Textures and materials still come from the real one, so everything that
+// gets created while it is active remains valid afterwards.
+// Without a real one (-nullvideo) it is the game's only screen and nothing
+// ever gets a hardware texture, which allows running without a GPU.
+class FNullFrameBuffer : public DFrameBuffer
+{
+	DFrameBuffer *mReal;
+	FNullRenderState mRenderState;
+
+public:
+	FNullFrameBuffer(DFrameBuffer *real);
+	FNullFrameBuffer(int width, int height);
+	~FNullFrameBuffer();
+
+	bool IsStandalone() const { return mReal == nullptr; }
+
+	void InitializeState() override;
+	bool IsVulkan() override { return mReal != nullptr && mReal->IsVulkan(); }
+	bool IsPoly() override { return mReal != nullptr && mReal->IsPoly(); }
+	bool IsFullscreen() override { return mReal != nullptr && mReal->IsFullscreen(); }
+	int GetClientWidth() override { return mReal != nullptr ? mReal->GetClientWidth() : GetWidth(); }
+	int GetClientHeight() override { return mReal != nullptr ? mReal->GetClientHeight() : GetHeight(); }
+	int Backend() override { return mReal != nullptr ? mReal->Backend() : 0; }
+
+	IHardwareTexture *CreateHardwareTexture(int numchannels) override { return mReal != nullptr ? mReal->CreateHardwareTexture(numchannels) : nullptr; }
+	void PrecacheMaterial(FMaterial *mat, int translation) override { if (mReal != nullptr) mReal->PrecacheMaterial(mat, translation); }
+	FMaterial *CreateMaterial(FGameTexture *tex, int scaleflags) override { return mReal != nullptr ? mReal->CreateMaterial(tex, scaleflags) : DFrameBuffer::CreateMaterial(tex, scaleflags); }
+	FNullRenderState *RenderState() override { return &mRenderState; }
+
+	IVertexBuffer *CreateVertexBuffer() override { return new FNullBuffer; }
+	IIndexBuffer *CreateIndexBuffer() override { return new FNullBuffer; }
+	IDataBuffer *CreateDataBuffer(int bindingpoint, bool ssbo, bool needsresize) override { return new FNullBuffer; }
+};
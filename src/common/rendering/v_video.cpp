@@ -61,6 +61,7 @@
 #include "texturemanager.h"
 #include "i_interface.h"
 #include "v_draw.h"
+#include "hw_nullbackend.h"
 
 
 EXTERN_CVAR(Int, menu_resolution_custom_width)
@@ -378,6 +379,27 @@ void V_InitScreenSize ()
 	vid_defheight = height;
 }
 
+//==========================================================================
+//
+// -nullvideo: the null backend is the screen and no window gets opened.
+// Nothing gets displayed, but the hardware renderer's scene code runs
+// without a GPU, e.g. for hwbench on a headless machine. This always uses
+// the hardware renderer, because the software renderer needs a canvas
+// texture the null frame buffer cannot provide.
+//
+//==========================================================================
+
+bool nullvideo;
+
+class FNullVideo : public IVideo
+{
+public:
+	DFrameBuffer *CreateFrameBuffer() override
+	{
+		return new FNullFrameBuffer(vid_defwidth, vid_defheight);
+	}
+};
+
 void V_InitScreen()
 {
 	screen = new DDummyFrameBuffer (vid_defwidth, vid_defheight);
@@ -397,7 +419,16 @@ void V_Init2()
 	ticker->SetGenericRepDefault(val, CVAR_Bool);
 
 
-	I_InitGraphics();
+	if (Args->CheckParm("-nullvideo"))
+	{
+		Printf("Using the null video backend\n");
+		nullvideo = true;
+		Video = new FNullVideo;
+	}
+	else
+	{
+		I_InitGraphics();
+	}
 
 	Video->SetResolution();	// this only fails via exceptions.
 	Printf ("Resolution: %d x %d\n", SCREENWIDTH, SCREENHEIGHT);
@@ -314,6 +314,7 @@ int V_GetBackend();
 
 inline bool IsRatioWidescreen(int ratio) { return (ratio & 3) != 0; }
 extern bool setsizeneeded, setmodeneeded;
+extern bool nullvideo;	// -nullvideo, see V_Init2
 
 
 #endif // __V_VIDEO_H__
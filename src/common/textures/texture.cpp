@@ -50,6 +50,7 @@
 #include "c_cvars.h"
 #include "imagehelpers.h"
 #include "v_video.h"
+#include <mutex>
 
 // Wrappers to keep the definitions of these classes out of here.
 IHardwareTexture* CreateHardwareTexture(int numchannels);
@@ -417,8 +418,14 @@ FTextureBuffer FTexture::CreateTexBuffer(int translation, int flags)
 
 bool FTexture::DetermineTranslucency()
 {
+	// The hardware renderer's BSP workers may get here for the same texture at once.
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (bTranslucent == -1)
+	{
 		// This will calculate all we need, so just discard the result.
 		CreateTexBuffer(0);
+	}
 	return !!bTranslucent;
 }
 
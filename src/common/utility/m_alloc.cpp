@@ -185,6 +185,14 @@ void M_Free (void *block)
 	if (block != nullptr)
 	{
 		GC::ReportDealloc(_msize(block));
+		M_FreeUnreported(block);
+	}
+}
+
+void M_FreeUnreported (void *block)
+{
+	if (block != nullptr)
+	{
 #if !defined(__solaris__) && !defined(__OpenBSD__) && !defined(__DragonFly__)
 		free(block);
 #else
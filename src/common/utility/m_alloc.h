@@ -83,5 +83,7 @@ inline void* M_Calloc(size_t v1, size_t v2)
 
 
 void M_Free (void *memblock);
+// Only releases the block. The caller must have reported it with GC::ReportDealloc, so this can be called from any thread.
+void M_FreeUnreported (void *memblock);
 
 #endif //__M_ALLOC_H__
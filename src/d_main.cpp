@@ -411,7 +411,7 @@ void D_Render(std::function<void()> action, bool interpolate)
 	for (auto Level : AllLevels())
 	{
 		// Check for the presence of dynamic lights at the start of the frame once.
-		if ((gl_lights && vid_rendermode == 4) || (r_dynlights && vid_rendermode != 4) || Level->LightProbes.Size() > 0)
+		if ((gl_lights && V_IsHardwareRenderer()) || (r_dynlights && !V_IsHardwareRenderer()) || Level->LightProbes.Size() > 0)
 		{
 			Level->HasDynamicLights = Level->lights || Level->LightProbes.Size() > 0;
 		}
@@ -959,7 +959,7 @@ void D_Display ()
 	// No wipes when in a stereo3D VR mode
 	else if (gamestate != wipegamestate && gamestate != GS_FULLCONSOLE && gamestate != GS_TITLELEVEL)
 	{
-		if (vr_mode == 0 || vid_rendermode != 4)
+		if (vr_mode == 0 || !V_IsHardwareRenderer())
 		{
 			// save the current screen if about to wipe
 			wipestart = screen->WipeStartScreen();
@@ -155,14 +155,17 @@ EXTERN_CVAR(Int, vid_rendermode)
 constexpr int vid_rendermode = 4;
 #endif
 
+extern bool nullvideo;
+
+// The null video backend can only run the hardware renderer, no matter what vid_rendermode says.
 inline bool V_IsHardwareRenderer()
 {
-	return vid_rendermode == 4;
+	return vid_rendermode == 4 || nullvideo;
 }
 
 inline bool V_IsTrueColor()
 {
-	return vid_rendermode == 1 || vid_rendermode == 4;
+	return vid_rendermode == 1 || V_IsHardwareRenderer();
 }
 
 bool CheckCheatmode(bool printmsg = true, bool sponly = false);
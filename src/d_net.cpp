@@ -136,6 +136,9 @@ void D_DoAdvanceDemo (void);
 
 static void SendSetup (uint32_t playersdetected[MAXNETNODES], uint8_t gotsetup[MAXNETNODES], int len);
 static void RunScript(uint8_t **stream, AActor *pawn, int snum, int argn, int always);
+static void Net_SoakTiccmd (ticcmd_t *cmd);
+static void Net_SoakTicker ();
+static FString Net_SoakReportName (int player);
 
 int		reboundpacket;
 uint8_t	reboundstore[MAX_MSGLEN];
@@ -163,8 +166,10 @@ CUSTOM_CVAR(Int, net_extratic, 0, CVAR_SERVERINFO | CVAR_NOSAVE)
 	}
 }
 
-#ifdef _DEBUG
-CVAR(Int, net_fakelatency, 0, 0);
+// Simulated network conditions for testing netgames over loopback.
+CVAR(Int, net_fakelatency, 0, 0);		// round trip time in ms
+CVAR(Int, net_fakejitter, 0, 0);		// random extra delay per packet in ms
+CVAR(Int, net_fakeloss, 0, 0);			// percentage of outgoing packets to drop
 
 struct PacketStore
 {
@@ -174,7 +179,51 @@ struct PacketStore
 
 static TArray<PacketStore> InBuffer;
 static TArray<PacketStore> OutBuffer;
-#endif
+
+static bool FakeNetDelay()
+{
+	return net_fakelatency / 2 > 0 || net_fakejitter > 0;
+}
+
+static int FakeNetTimer()
+{
+	int delay = net_fakelatency / 2;
+	if (net_fakejitter > 0)
+	{
+		delay += rand() % (net_fakejitter + 1);
+	}
+	return I_GetTime() + (delay / (1000 / TICRATE));
+}
+
+// Per-node traffic statistics, shown by 'stat net'.
+struct NetNodeStats
+{
+	uint64_t BytesSent;
+	uint64_t BytesReceived;
+	int PacketsSent;
+	int PacketsReceived;
+	int PacketsDropped;		// by net_fakeloss
+	int ResendsRequested;	// we asked the node to retransmit
+	int ResendsServed;		// the node asked us to retransmit
+	int MaxTicLag;
+	int64_t TicLagSum;		// for the average, over all packets with new tics
+	int TicLagCount;
+};
+
+static NetNodeStats NetStats[MAXNETNODES];
+static uint64_t NetStatsStart;
+
+static void Net_ResetStats()
+{
+	memset (NetStats, 0, sizeof(NetStats));
+	NetStatsStart = I_msTime();
+}
+
+// Loopback soak test (-netsoak), see Net_SoakTicker.
+static int NetSoakTics;					// the game tic at which the test ends, 0 if none runs
+static bool NetSoakHost;
+static uint64_t NetSoakEndTime;			// when the host started waiting for the other nodes
+static int NetSoakDesync[MAXPLAYERS];	// the first tic each player's consistency check failed at
 
 // [RH] Special "ticcmds" get stored in here
 static struct TicSpecial
@@ -327,6 +376,7 @@ void Net_ClearBuffers ()
 	memset (lastrecvtime, 0, sizeof(lastrecvtime));
 	memset (currrecvtime, 0, sizeof(currrecvtime));
 	memset (consistancy, 0, sizeof(consistancy));
+	Net_ResetStats ();
 	nodeingame[0] = true;
 
 	for (i = 0; i < MAXPLAYERS; i++)
@@ -513,16 +563,26 @@ void HSendPacket (int node, int len)
 	}
 #endif
 
+	NetStats[node].PacketsSent++;
+	NetStats[node].BytesSent += len;
+
+	if (net_fakeloss > 0 && rand() % 100 < net_fakeloss)
+	{
+		NetStats[node].PacketsDropped++;
+		if (debugfile)
+			fprintf (debugfile, "Drop!\n");
+		return;
+	}
+
 	doomcom.command = CMD_SEND;
 	doomcom.remotenode = node;
 	doomcom.datalength = len;
 
-#ifdef _DEBUG
-	if (net_fakelatency / 2 > 0)
+	if (FakeNetDelay())
 	{
 		PacketStore store;
 		store.message = doomcom;
-		store.timer = I_GetTime() + ((net_fakelatency / 2) / (1000 / TICRATE));
+		store.timer = FakeNetTimer();
 		OutBuffer.Push(store);
 	}
 	else
@@ -538,9 +598,6 @@ void HSendPacket (int node, int len)
 			i = -1;
 		}
 	}
-#else
-	I_NetCmd();
-#endif
 }
 
 //
@@ -566,12 +623,11 @@ bool HGetPacket (void)
 	doomcom.command = CMD_GET;
 	I_NetCmd ();
 
-#ifdef _DEBUG
-	if (net_fakelatency / 2 > 0 && doomcom.remotenode != -1)
+	if (FakeNetDelay() && doomcom.remotenode != -1)
 	{
 		PacketStore store;
 		store.message = doomcom;
-		store.timer = I_GetTime() + ((net_fakelatency / 2) / (1000 / TICRATE));
+		store.timer = FakeNetTimer();
 		InBuffer.Push(store);
 		doomcom.remotenode = -1;
 	}
@@ -592,12 +648,9 @@ bool HGetPacket (void)
 		if (!gotmessage)
 			return false;
 	}
-#else
-	if (doomcom.remotenode == -1)
-	{
-		return false;
-	}
-#endif
+
+	NetStats[doomcom.remotenode].PacketsReceived++;
+	NetStats[doomcom.remotenode].BytesReceived += doomcom.datalength;
 		
 	if (debugfile)
 	{
@@ -871,6 +924,7 @@ void GetPackets (void)
 			if (debugfile)
 				fprintf (debugfile,"retransmit from %i\n", resendto[netnode]);
 			resendcount[netnode] = RESENDCOUNT;
+			NetStats[netnode].ResendsServed++;
 		}
 		else
 		{
@@ -896,6 +950,8 @@ void GetPackets (void)
 			if (debugfile)
 				fprintf (debugfile, "missed tics from %i (%i to %i)\n",
 						 netnode, nettics[netnode], realstart);
+			if (!remoteresend[netnode])
+				NetStats[netnode].ResendsRequested++;
 			remoteresend[netnode] = true;
 			continue;
 		}
@@ -918,6 +974,10 @@ void GetPackets (void)
 
 				nettics[nodeforplayer[playerbytes[i]]] = realend;
 			}
+			int lag = maketic / ticdup - realend;
+			NetStats[netnode].MaxTicLag = max(NetStats[netnode].MaxTicLag, lag);
+			NetStats[netnode].TicLagSum += lag;
+			NetStats[netnode].TicLagCount++;
 		}
 	}
 }
@@ -978,6 +1038,8 @@ void NetUpdate (void)
 		
 		//Printf ("mk:%i ",maketic);
 		G_BuildTiccmd (&localcmds[maketic % LOCALCMDTICS]);
+		if (NetSoakTics > 0)
+			Net_SoakTiccmd (&localcmds[maketic % LOCALCMDTICS]);
 		maketic++;
 
 		if (ticdup == 1 || maketic == 0)
@@ -1718,6 +1780,21 @@ bool D_CheckNetGame (void)
 	// [RH] Setup user info
 	D_SetupUserInfo ();
 
+	if (netgame && (Args->CheckParm ("-netsoak") || Args->CheckParm ("-netsoaknode")))
+	{
+		v = Args->CheckValue ("-netsoaktime");
+		NetSoakTics = (v != NULL ? max (atoi (v), 1) : 60) * TICRATE;
+		NetSoakHost = Args->CheckParm ("-netsoak") != 0;
+		Printf ("Soak test running for %d seconds\n", NetSoakTics / TICRATE);
+
+		// Don't let the report pick up anything left over from an earlier run.
+		if (NetSoakHost)
+		{
+			for (i = 0; i < doomcom.numnodes; i++)
+				remove (Net_SoakReportName (i));
+		}
+	}
+
 	if (Args->CheckParm ("-debugfile"))
 	{
 		char filename[20];
@@ -2108,6 +2185,8 @@ void TryRunTics (void)
 			M_Ticker ();
 			G_Ticker();
 			gametic++;
+			if (NetSoakTics > 0)
+				Net_SoakTicker ();
 
 			NetUpdate ();	// check for new console commands
 			TicStabilityEnd();
@@ -3049,6 +3128,204 @@ CCMD (pings)
 					players[i].userinfo.GetName());
 }
 
+//==========================================================================
+//
+// STAT net
+//
+// Per-node traffic, retransmissions and tic latency. The loopback soak
+// test below writes the same table into its reports.
+//
+//==========================================================================
+
+static FString Net_StatsText ()
+{
+	FString out;
+
+	double seconds = max<uint64_t>(I_msTime() - NetStatsStart, 1) / 1000.;
+	out.AppendFormat("Node  Sent(pkt/KB/Bps)       Recv(pkt/KB/Bps)       Drop  ReqRes  SrvRes  Lag(avg/max)  Ping\n");
+	for (int i = 1; i < doomcom.numnodes; ++i)
+	{
+		if (!nodeingame[i])
+			continue;
+
+		auto &stats = NetStats[i];
+		int player = playerfornode[i] & ~PL_DRONE;
+		out.AppendFormat("%4d  %6d %6.1f %7.0f  %6d %6.1f %7.0f  %4d  %6d  %6d  %3d(%4.1f/%3d)  %4" PRId64 "%s\n",
+			i,
+			stats.PacketsSent, stats.BytesSent / 1024., stats.BytesSent / seconds,
+			stats.PacketsReceived, stats.BytesReceived / 1024., stats.BytesReceived / seconds,
+			stats.PacketsDropped, stats.ResendsRequested, stats.ResendsServed,
+			maketic / ticdup - nettics[i], stats.TicLagCount > 0 ? double(stats.TicLagSum) / stats.TicLagCount : 0., stats.MaxTicLag,
+			currrecvtime[player] - lastrecvtime[player],
+			players[player].inconsistant ? "  DESYNC" : "");
+	}
+	out.AppendFormat("Simulated latency: %d ms  jitter: %d ms  loss: %d%%",
+		*net_fakelatency, *net_fakejitter, *net_fakeloss);
+	return out;
+}
+
+ADD_STAT (net)
+{
+	if (!netgame)
+	{
+		return "Not in a netgame";
+	}
+	return Net_StatsText ();
+}
+
+CCMD (net_resetstats)
+{
+	Net_ResetStats ();
+}
+
+//==========================================================================
+//
+// Loopback soak test
+//
+// With -netsoak <nodes> this is the host and I_InitNetwork has started
+// the other nodes, which run with -netsoaknode. All of them play the
+// game with random input for -netsoaktime seconds (60 by default), then
+// write netsoak-<player>.txt with their traffic statistics, the tic at
+// which any player went out of sync, and a sum of the game state.
+//
+// The host keeps the game running until the other nodes have exited,
+// then collects their reports in netsoak.txt. Nodes whose state sum
+// differs from the host's have desynced, even if no consistency check
+// caught it while they were running.
+//
+//==========================================================================
+
+static void Net_SoakTiccmd (ticcmd_t *cmd)
+{
+	static short forward, side, yaw;
+
+	// Change direction once a second, and fire now and then.
+	if (maketic % TICRATE == 0)
+	{
+		forward = (rand() % 0x65 - 0x32) << 8;
+		side = (rand() % 0x51 - 0x28) << 8;
+		yaw = rand() % 1281 - 640;
+	}
+	cmd->ucmd.forwardmove = forward;
+	cmd->ucmd.sidemove = side;
+	cmd->ucmd.yaw = yaw;
+	cmd->ucmd.buttons = rand() % 8 == 0 ? BT_ATTACK : 0;
+}
+
+static uint32_t Net_SoakStateSum ()
+{
+	// The consistency checks of the last tic all nodes ran.
+	int buf = ((NetSoakTics - 1) / ticdup) % BACKUPTICS;
+	uint32_t sum = 0;
+
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (playeringame[i])
+			sum = sum * 31 + (uint16_t)consistancy[i][buf];
+	}
+	return sum;
+}
+
+static FString Net_SoakReportName (int player)
+{
+	FString name;
+	name.Format ("netsoak-%d.txt", player);
+	return name;
+}
+
+static void Net_WriteSoakReport ()
+{
+	FString report;
+
+	report.Format ("Player %d, %d nodes, %d tics, state sum %08x\n",
+		consoleplayer, doomcom.numnodes, NetSoakTics, Net_SoakStateSum ());
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (NetSoakDesync[i] != 0)
+			report.AppendFormat ("Player %d went out of sync at tic %d\n", i, NetSoakDesync[i]);
+	}
+	report << Net_StatsText () << "\n";
+
+	FILE *f = fopen (Net_SoakReportName (consoleplayer), "w");
+	if (f != NULL)
+	{
+		fputs (report, f);
+		fclose (f);
+	}
+}
+
+static void Net_CollectSoakReports ()
+{
+	FString report, summary;
+	uint32_t hostsum = Net_SoakStateSum ();
+	int desyncs = 0;
+
+	for (int i = 0; i < doomcom.numnodes; i++)
+	{
+		FString name = Net_SoakReportName (i);
+		FILE *f = fopen (name, "r");
+		if (f == NULL)
+		{
+			summary.AppendFormat ("Player %d: no report\n", i);
+			continue;
+		}
+
+		char line[256];
+		unsigned sum = 0;
+		bool failedcheck = false;
+		report.AppendFormat ("--- %s\n", name.GetChars());
+		while (fgets (line, countof(line), f) != NULL)
+		{
+			const char *p = strstr (line, "state sum ");
+			if (p != NULL) sscanf (p + 10, "%x", &sum);
+			if (strstr (line, "out of sync") != NULL) failedcheck = true;
+			report << line;
+		}
+		fclose (f);
+
+		summary.AppendFormat ("Player %d: state sum %08x%s%s\n", i, sum, sum != hostsum ? " DESYNC" : "",
+			failedcheck ? " (consistency check failed)" : "");
+		if (sum != hostsum || failedcheck) desyncs++;
+	}
+	summary.AppendFormat ("Soak test done: %d nodes, %d seconds, %s\n", doomcom.numnodes, NetSoakTics / TICRATE,
+		desyncs > 0 ? "out of sync" : "in sync");
+	Printf ("%s", summary.GetChars());
+
+	FILE *f = fopen ("netsoak.txt", "w");
+	if (f != NULL)
+	{
+		fputs (summary, f);
+		fputs (report, f);
+		fclose (f);
+	}
+}
+
+static void Net_SoakTicker ()
+{
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (playeringame[i] && players[i].inconsistant != 0 && NetSoakDesync[i] == 0)
+			NetSoakDesync[i] = players[i].inconsistant;
+	}
+	if (gametic < NetSoakTics)
+		return;
+
+	if (gametic == NetSoakTics)
+	{
+		Net_WriteSoakReport ();
+		if (!NetSoakHost)
+			throw CExitEvent (0);
+
+		// The other nodes may still need tics from us to get this far.
+		NetSoakEndTime = I_msTime ();
+	}
+	if (I_NetSoakNodesRunning () && I_msTime () - NetSoakEndTime < 30000)
+		return;
+
+	Net_CollectSoakReports ();
+	throw CExitEvent (0);
+}
+
 //==========================================================================
 //
 // Network_Controller
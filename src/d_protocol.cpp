@@ -133,6 +133,45 @@ void WriteFloat (float v, uint8_t **stream)
 	WriteLong (fakeint.i, stream);
 }
 
+// Small changes to the angles and movement are common, so these can
+// be sent as zigzag encoded deltas to the basis, using 1-3 bytes each.
+static void WriteDelta (short val, short basis, uint8_t **stream)
+{
+	int16_t delta = int16_t(val - basis);
+	uint32_t zigzag = uint16_t((delta << 1) ^ (delta >> 15));
+
+	while (zigzag >= 0x80)
+	{
+		WriteByte (uint8_t(zigzag | 0x80), stream);
+		zigzag >>= 7;
+	}
+	WriteByte (uint8_t(zigzag), stream);
+}
+
+static short ReadDelta (short basis, uint8_t **stream)
+{
+	uint32_t zigzag = 0;
+	int shift = 0;
+	uint8_t in;
+
+	do
+	{
+		in = ReadByte (stream);
+		zigzag |= (in & 0x7F) << shift;
+		shift += 7;
+	} while ((in & 0x80) && shift < 21);
+
+	int16_t delta = int16_t((zigzag >> 1) ^ (0u - (zigzag & 1)));
+	return short(basis + delta);
+}
+
+static int DeltaSize (short val, short basis)
+{
+	int16_t delta = int16_t(val - basis);
+	uint32_t zigzag = uint16_t((delta << 1) ^ (delta >> 15));
+	return zigzag < 0x80 ? 1 : zigzag < 0x4000 ? 2 : 3;
+}
+
 // Returns the number of bytes read
 int UnpackUserCmd (usercmd_t *ucmd, const usercmd_t *basis, uint8_t **stream)
 {
@@ -179,18 +218,36 @@ int UnpackUserCmd (usercmd_t *ucmd, const usercmd_t *basis, uint8_t **stream)
 			}
 			ucmd->buttons = buttons;
 		}
-		if (flags & UCMDF_PITCH)
-			ucmd->pitch = ReadWord (stream);
-		if (flags & UCMDF_YAW)
-			ucmd->yaw = ReadWord (stream);
-		if (flags & UCMDF_FORWARDMOVE)
-			ucmd->forwardmove = ReadWord (stream);
-		if (flags & UCMDF_SIDEMOVE)
-			ucmd->sidemove = ReadWord (stream);
-		if (flags & UCMDF_UPMOVE)
-			ucmd->upmove = ReadWord (stream);
-		if (flags & UCMDF_ROLL)
-			ucmd->roll = ReadWord (stream);
+		if (flags & UCMDF_DELTA)
+		{
+			if (flags & UCMDF_PITCH)
+				ucmd->pitch = ReadDelta (ucmd->pitch, stream);
+			if (flags & UCMDF_YAW)
+				ucmd->yaw = ReadDelta (ucmd->yaw, stream);
+			if (flags & UCMDF_FORWARDMOVE)
+				ucmd->forwardmove = ReadDelta (ucmd->forwardmove, stream);
+			if (flags & UCMDF_SIDEMOVE)
+				ucmd->sidemove = ReadDelta (ucmd->sidemove, stream);
+			if (flags & UCMDF_UPMOVE)
+				ucmd->upmove = ReadDelta (ucmd->upmove, stream);
+			if (flags & UCMDF_ROLL)
+				ucmd->roll = ReadDelta (ucmd->roll, stream);
+		}
+		else
+		{
+			if (flags & UCMDF_PITCH)
+				ucmd->pitch = ReadWord (stream);
+			if (flags & UCMDF_YAW)
+				ucmd->yaw = ReadWord (stream);
+			if (flags & UCMDF_FORWARDMOVE)
+				ucmd->forwardmove = ReadWord (stream);
+			if (flags & UCMDF_SIDEMOVE)
+				ucmd->sidemove = ReadWord (stream);
+			if (flags & UCMDF_UPMOVE)
+				ucmd->upmove = ReadWord (stream);
+			if (flags & UCMDF_ROLL)
+				ucmd->roll = ReadWord (stream);
+		}
 	}
 
 	return int(*stream - start);
@@ -249,35 +306,36 @@ int PackUserCmd (const usercmd_t *ucmd, const usercmd_t *basis, uint8_t **stream
 			}
 		}
 	}
-	if (ucmd->pitch != basis->pitch)
-	{
-		flags |= UCMDF_PITCH;
-		WriteWord (ucmd->pitch, stream);
-	}
-	if (ucmd->yaw != basis->yaw)
-	{
-		flags |= UCMDF_YAW;
-		WriteWord (ucmd->yaw, stream);
-	}
-	if (ucmd->forwardmove != basis->forwardmove)
-	{
-		flags |= UCMDF_FORWARDMOVE;
-		WriteWord (ucmd->forwardmove, stream);
-	}
-	if (ucmd->sidemove != basis->sidemove)
+
+	// Only use delta encoding if it actually saves space.
+	const short usercmd_t::*fields[] = { &usercmd_t::pitch, &usercmd_t::yaw, &usercmd_t::forwardmove,
+		&usercmd_t::sidemove, &usercmd_t::upmove, &usercmd_t::roll };
+	const uint8_t fieldflags[] = { UCMDF_PITCH, UCMDF_YAW, UCMDF_FORWARDMOVE, UCMDF_SIDEMOVE, UCMDF_UPMOVE, UCMDF_ROLL };
+	int wordsize = 0, deltasize = 0;
+
+	for (int i = 0; i < 6; i++)
 	{
-		flags |= UCMDF_SIDEMOVE;
-		WriteWord (ucmd->sidemove, stream);
+		if (ucmd->*fields[i] != basis->*fields[i])
+		{
+			wordsize += 2;
+			deltasize += DeltaSize (ucmd->*fields[i], basis->*fields[i]);
+		}
 	}
-	if (ucmd->upmove != basis->upmove)
+	if (deltasize < wordsize)
 	{
-		flags |= UCMDF_UPMOVE;
-		WriteWord (ucmd->upmove, stream);
+		flags |= UCMDF_DELTA;
 	}
-	if (ucmd->roll != basis->roll)
+
+	for (int i = 0; i < 6; i++)
 	{
-		flags |= UCMDF_ROLL;
-		WriteWord (ucmd->roll, stream);
+		if (ucmd->*fields[i] != basis->*fields[i])
+		{
+			flags |= fieldflags[i];
+			if (flags & UCMDF_DELTA)
+				WriteDelta (ucmd->*fields[i], basis->*fields[i], stream);
+			else
+				WriteWord (ucmd->*fields[i], stream);
+		}
 	}
 
 	// Write the packing bits
@@ -368,27 +426,34 @@ int SkipTicCmd (uint8_t **stream, int count)
 			if (type == DEM_USERCMD)
 			{
 				moreticdata = false;
-				skip = 1;
-				if (*flow & UCMDF_PITCH)		skip += 2;
-				if (*flow & UCMDF_YAW)			skip += 2;
-				if (*flow & UCMDF_FORWARDMOVE)	skip += 2;
-				if (*flow & UCMDF_SIDEMOVE)		skip += 2;
-				if (*flow & UCMDF_UPMOVE)		skip += 2;
-				if (*flow & UCMDF_ROLL)			skip += 2;
-				if (*flow & UCMDF_BUTTONS)
+				uint8_t flags = *flow++;
+				if (flags & UCMDF_BUTTONS)
 				{
-					if (*++flow & 0x80)
+					if (*flow++ & 0x80)
 					{
-						if (*++flow & 0x80)
+						if (*flow++ & 0x80)
 						{
-							if (*++flow & 0x80)
+							if (*flow++ & 0x80)
 							{
 								++flow;
 							}
 						}
 					}
 				}
-				flow += skip;
+				for (int field = UCMDF_PITCH; field <= UCMDF_ROLL; field <<= 1)
+				{
+					if (!(flags & field))
+						continue;
+
+					if (flags & UCMDF_DELTA)
+					{
+						while (*flow++ & 0x80) {}
+					}
+					else
+					{
+						flow += 2;
+					}
+				}
 			}
 			else if (type == DEM_EMPTYUSERCMD)
 			{
@@ -83,6 +83,7 @@ enum
 	UCMDF_SIDEMOVE		= 0x10,
 	UCMDF_UPMOVE		= 0x20,
 	UCMDF_ROLL			= 0x40,
+	UCMDF_DELTA			= 0x80,	// word fields are stored as varint deltas to the basis
 };
 
 // When changing the following enum, be sure to update Net_SkipCommand()
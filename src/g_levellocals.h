@@ -41,6 +41,7 @@
 #include "r_sky.h"
 #include "portal.h"
 #include "p_blockmap.h"
+#include "p_linetree.h"
 #include "p_local.h"
 #include "po_man.h"
 #include "p_acs.h"
@@ -277,7 +278,21 @@ private:
 	TArray<FLinePortal*> foundPortals;
 	TArray<int> groupsToCheck;
 
+	// The linked portals a query from inside a blockmap cell can touch,
+	// for the portal group that first asked. Built on demand.
+	struct FPortalQueryCell
+	{
+		int group = -1;
+		TArray<FLinePortal*> portals;
+	};
+	TArray<FPortalQueryCell> PortalQueryCache;
+	TArray<FLinePortal*> *GetPortalQueryList(int startgroup, const DVector3 &position, double checkradius);
+
 public:
+	void InvalidatePortalQueryCache()
+	{
+		PortalQueryCache.Clear();
+	}
 
 	FSectorTagIterator GetSectorTagIterator(int tag)
 	{
@@ -483,6 +498,7 @@ public:
 	TMap<int, FHealthGroup> healthGroups;
 
 	FBlockmap blockmap;
+	FLineTree LineTree;
 	TArray<polyblock_t *> PolyBlockMap;
 	FUDMFKeyMap UDMFKeys[4];
 
@@ -658,7 +674,7 @@ public:
 	uint32_t			ActiveParticles;
 	uint32_t			InactiveParticles;
 	TArray<particle_t>	Particles;
-	TArray<uint16_t>	ParticlesInSubsec;
+	TArray<uint32_t>	ParticlesInSubsec;
 	FThinkerCollection Thinkers;
 
 	TArray<DVector2>	Scrolls;		// NULL if no DScrollers in this level
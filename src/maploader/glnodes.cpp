@@ -60,6 +60,7 @@
 #include "g_levellocals.h"
 #include "i_time.h"
 #include "maploader.h"
+#include "doom_aabbtree.h"
 
 EXTERN_CVAR(Bool, gl_cachenodes)
 EXTERN_CVAR(Float, gl_cachetime)
@@ -997,7 +998,7 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 typedef TArray<uint8_t> MemFile;
 
 
-static FString CreateCacheName(MapData *map, bool create)
+static FString CreateCacheName(MapData *map, bool create, const char *ext = ".gzc")
 {
 	FString path = M_GetCachePath(create);
 	FString lumpname = fileSystem.GetFileFullPath(map->lumpnum);
@@ -1007,7 +1008,7 @@ static FString CreateCacheName(MapData *map, bool create)
 
 	lumpname.ReplaceChars('/', '%');
 	lumpname.ReplaceChars(':', '$');
-	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ".gzc";
+	path << '/' << lumpname.Right((ptrdiff_t)lumpname.Len() - separator - 1) << ext;
 	return path;
 }
 
@@ -1196,6 +1197,365 @@ bool MapLoader::CheckCachedNodes(MapData *map)
 	return true;
 }
 
+//==========================================================================
+//
+// Blockmap caching
+//
+// Generated blockmaps are stored next to the cached nodes so that maps
+// with a missing or broken BLOCKMAP lump do not have to rebuild it on
+// every load. The file is keyed by the map's checksum and by the level
+// data hash, which covers the final vertex positions. Compatibility
+// handling and node rebuilds may move or add vertices, and VerifyBlockMap
+// only checks the structure, so a blockmap built for other geometry would
+// otherwise be accepted.
+//
+//==========================================================================
+
+enum
+{
+	BLOCKMAP_CACHE_VERSION = 2
+};
+
+void MapLoader::CreateCachedBlockMap(MapData *map, unsigned count)
+{
+	MemFile BMap;
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		WriteLong(BMap, Level->blockmap.blockmaplump[i]);
+	}
+
+	uLongf outlen = BMap.Size();
+	TArray<Bytef> compressed;
+	const int offset = 4 + 4 + 16 + 4 * 4;
+	int r;
+	do
+	{
+		compressed.Resize(outlen + offset);
+		r = compress(compressed.Data() + offset, &outlen, BMap.Data(), BMap.Size());
+		if (r == Z_BUF_ERROR)
+		{
+			outlen += 1024;
+		}
+	}
+	while (r == Z_BUF_ERROR);
+
+	if (r != Z_OK) return;
+
+	uint32_t header[4] = { LittleLong(LevelCache.Hash), LittleLong(uint32_t(Level->vertexes.Size())), LittleLong(Level->lines.Size()), LittleLong(count) };
+	uint32_t version = LittleLong(uint32_t(BLOCKMAP_CACHE_VERSION));
+	memcpy(compressed.Data(), "BMAP", 4);
+	memcpy(&compressed[4], &version, 4);
+	map->GetChecksum(&compressed[8]);
+	memcpy(&compressed[24], header, 16);
+
+	FString path = CreateCacheName(map, true, ".gzb");
+	FileWriter *fw = FileWriter::Open(path);
+
+	if (fw != nullptr)
+	{
+		const size_t length = outlen + offset;
+		if (fw->Write(compressed.Data(), length) != length)
+		{
+			Printf("Error saving blockmap to file %s\n", path.GetChars());
+		}
+		delete fw;
+	}
+	else
+	{
+		Printf("Cannot open blockmap file %s for writing\n", path.GetChars());
+	}
+}
+
+bool MapLoader::CheckCachedBlockMap(MapData *map)
+{
+	char magic[4] = { 0,0,0,0 };
+	uint8_t md5[16];
+	uint8_t md5map[16];
+	uint32_t version;
+	uint32_t header[4];
+
+	FString path = CreateCacheName(map, false, ".gzb");
+	FileReader fr;
+
+	if (!fr.OpenFile(path)) return false;
+
+	if (fr.Read(magic, 4) != 4) return false;
+	if (memcmp(magic, "BMAP", 4)) return false;
+
+	if (fr.Read(&version, 4) != 4) return false;
+	if (LittleLong(version) != BLOCKMAP_CACHE_VERSION) return false;
+
+	if (fr.Read(md5, 16) != 16) return false;
+	map->GetChecksum(md5map);
+	if (memcmp(md5, md5map, 16)) return false;
+
+	if (fr.Read(header, 16) != 16) return false;
+	if (LittleLong(header[0]) != LevelCache.Hash || LittleLong(header[1]) != Level->vertexes.Size() || LittleLong(header[2]) != Level->lines.Size()) return false;
+
+	const uint32_t count = LittleLong(header[3]);
+	if (count < 4) return false;
+
+	auto compressed = fr.Read(fr.GetLength() - fr.Tell());
+	TArray<uint32_t> data(count, true);
+	uLongf outlen = count * sizeof(uint32_t);
+	if (uncompress((Bytef*)data.Data(), &outlen, compressed.Data(), (uLong)compressed.Size()) != Z_OK || outlen != count * sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	Level->blockmap.blockmaplump = new int[count];
+	for (unsigned i = 0; i < count; i++)
+	{
+		Level->blockmap.blockmaplump[i] = (int)LittleLong(data[i]);
+	}
+
+	// Never trust the cache blindly.
+	if (!Level->blockmap.VerifyBlockMap(count, Level->lines.Size()))
+	{
+		delete[] Level->blockmap.blockmaplump;
+		Level->blockmap.blockmaplump = nullptr;
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Level data caching
+//
+// The sound zones and the AABB tree only consist of indices and
+// coordinates, so they can be stored as they are. Apart from the map's
+// checksum the file is keyed by a hash of the vertex, line and sector data
+// the passes depend on, which also catches changes made by compatibility
+// handling or different line translators. The hash gets taken before the
+// polyobjects are moved to their start spots, so the AABB tree checks and
+// refits its polyobject part once it gets created.
+//
+//==========================================================================
+
+enum
+{
+	LEVELDATA_CACHE_VERSION = 2
+};
+
+static uint16_t ReadWord(const uint8_t *&p, const uint8_t *end, bool &ok)
+{
+	if (end - p < 2)
+	{
+		ok = false;
+		return 0;
+	}
+	uint16_t v = uint16_t(p[0] | (p[1] << 8));
+	p += 2;
+	return v;
+}
+
+static uint32_t ReadLong(const uint8_t *&p, const uint8_t *end, bool &ok)
+{
+	if (end - p < 4)
+	{
+		ok = false;
+		return 0;
+	}
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+	p += 4;
+	return v;
+}
+
+static void WriteFloat(MemFile &f, float v)
+{
+	uint32_t b;
+	memcpy(&b, &v, 4);
+	WriteLong(f, b);
+}
+
+static float ReadFloat(const uint8_t *&p, const uint8_t *end, bool &ok)
+{
+	uint32_t b = ReadLong(p, end, ok);
+	float v;
+	memcpy(&v, &b, 4);
+	return v;
+}
+
+uint32_t MapLoader::GetLevelDataHash()
+{
+	uLong hash = crc32(0, nullptr, 0);
+	for (auto &vert : Level->vertexes)
+	{
+		int32_t data[2] = { vert.fixX(), vert.fixY() };
+		hash = crc32(hash, (const Bytef*)data, sizeof(data));
+	}
+	for (auto &line : Level->lines)
+	{
+		int32_t data[7] = 
+		{ 
+			line.v1->fixX(), line.v1->fixY(), line.v2->fixX(), line.v2->fixY(),
+			line.frontsector ? Index(line.frontsector) : -1,
+			line.backsector ? Index(line.backsector) : -1,
+			(int32_t)line.flags
+		};
+		hash = crc32(hash, (const Bytef*)data, sizeof(data));
+	}
+	return uint32_t(hash);
+}
+
+void MapLoader::CreateCachedLevelData(MapData *map)
+{
+	MemFile LData;
+
+	WriteLong(LData, LevelCache.NumZones);
+	for (auto &sec : Level->sectors)
+	{
+		WriteWord(LData, sec.ZoneNumber);
+	}
+
+	TArray<hwrenderer::AABBTreeNode> treenodes;
+	TArray<int> treelines;
+	int dynamicnode = 0, dynamicline = 0;
+	if (Level->aabbTree) Level->aabbTree->GetCacheData(treenodes, treelines, dynamicnode, dynamicline);
+
+	WriteLong(LData, treenodes.Size());
+	for (auto &node : treenodes)
+	{
+		WriteFloat(LData, node.aabb_left);
+		WriteFloat(LData, node.aabb_top);
+		WriteFloat(LData, node.aabb_right);
+		WriteFloat(LData, node.aabb_bottom);
+		WriteLong(LData, node.left_node);
+		WriteLong(LData, node.right_node);
+		WriteLong(LData, node.line_index);
+	}
+	WriteLong(LData, treelines.Size());
+	for (auto line : treelines)
+	{
+		WriteLong(LData, line);
+	}
+	WriteLong(LData, dynamicnode);
+	WriteLong(LData, dynamicline);
+
+	uLongf outlen = LData.Size();
+	TArray<Bytef> compressed;
+	const int offset = 4 + 4 + 16 + 4 * 5;
+	int r;
+	do
+	{
+		compressed.Resize(outlen + offset);
+		r = compress(compressed.Data() + offset, &outlen, LData.Data(), LData.Size());
+		if (r == Z_BUF_ERROR)
+		{
+			outlen += 1024;
+		}
+	}
+	while (r == Z_BUF_ERROR);
+
+	if (r != Z_OK) return;
+
+	uint32_t header[5] = { LittleLong(LevelCache.Hash), LittleLong(Level->vertexes.Size()), LittleLong(Level->lines.Size()), LittleLong(Level->sectors.Size()), LittleLong(LData.Size()) };
+	uint32_t version = LittleLong(uint32_t(LEVELDATA_CACHE_VERSION));
+	memcpy(compressed.Data(), "LDAT", 4);
+	memcpy(&compressed[4], &version, 4);
+	map->GetChecksum(&compressed[8]);
+	memcpy(&compressed[24], header, 20);
+
+	FString path = CreateCacheName(map, true, ".gzl");
+	FileWriter *fw = FileWriter::Open(path);
+
+	if (fw != nullptr)
+	{
+		const size_t length = outlen + offset;
+		if (fw->Write(compressed.Data(), length) != length)
+		{
+			Printf("Error saving level data to file %s\n", path.GetChars());
+		}
+		delete fw;
+	}
+	else
+	{
+		Printf("Cannot open level data file %s for writing\n", path.GetChars());
+	}
+}
+
+bool MapLoader::CheckCachedLevelData(MapData *map)
+{
+	char magic[4] = { 0,0,0,0 };
+	uint8_t md5[16];
+	uint8_t md5map[16];
+	uint32_t version;
+	uint32_t header[5];
+
+	FString path = CreateCacheName(map, false, ".gzl");
+	FileReader fr;
+
+	if (!fr.OpenFile(path)) return false;
+
+	if (fr.Read(magic, 4) != 4) return false;
+	if (memcmp(magic, "LDAT", 4)) return false;
+
+	if (fr.Read(&version, 4) != 4) return false;
+	if (LittleLong(version) != LEVELDATA_CACHE_VERSION) return false;
+
+	if (fr.Read(md5, 16) != 16) return false;
+	map->GetChecksum(md5map);
+	if (memcmp(md5, md5map, 16)) return false;
+
+	if (fr.Read(header, 20) != 20) return false;
+	if (LittleLong(header[0]) != LevelCache.Hash || LittleLong(header[1]) != Level->vertexes.Size() ||
+		LittleLong(header[2]) != Level->lines.Size() || LittleLong(header[3]) != Level->sectors.Size()) return false;
+
+	const uint32_t size = LittleLong(header[4]);
+	auto compressed = fr.Read(fr.GetLength() - fr.Tell());
+	TArray<uint8_t> data(size, true);
+	uLongf outlen = size;
+	if (uncompress(data.Data(), &outlen, compressed.Data(), (uLong)compressed.Size()) != Z_OK || outlen != size)
+	{
+		return false;
+	}
+
+	const uint8_t *p = data.Data();
+	const uint8_t *end = p + size;
+	bool ok = true;
+
+	LevelCache.NumZones = ReadLong(p, end, ok);
+	LevelCache.ZoneNumbers.Resize(Level->sectors.Size());
+	for (auto &zone : LevelCache.ZoneNumbers)
+	{
+		zone = ReadWord(p, end, ok);
+		if (zone >= LevelCache.NumZones) ok = false;
+	}
+
+	uint32_t numnodes = ReadLong(p, end, ok);
+	if (!ok || numnodes > uint32_t(end - p) / 28) return false;
+	LevelCache.TreeNodes.Clear();
+	for (uint32_t i = 0; i < numnodes; i++)
+	{
+		FVector2 aabb_min, aabb_max;
+		aabb_min.X = ReadFloat(p, end, ok);
+		aabb_min.Y = ReadFloat(p, end, ok);
+		aabb_max.X = ReadFloat(p, end, ok);
+		aabb_max.Y = ReadFloat(p, end, ok);
+		int left = (int)ReadLong(p, end, ok);
+		int right = (int)ReadLong(p, end, ok);
+		hwrenderer::AABBTreeNode node(aabb_min, aabb_max, left, right);
+		node.line_index = (int)ReadLong(p, end, ok);
+		node.padding = 0;
+		LevelCache.TreeNodes.Push(node);
+	}
+
+	uint32_t numlines = ReadLong(p, end, ok);
+	if (!ok || numlines > uint32_t(end - p) / 4) return false;
+	LevelCache.TreeLines.Resize(numlines);
+	for (auto &line : LevelCache.TreeLines)
+	{
+		line = (int)ReadLong(p, end, ok);
+	}
+	LevelCache.TreeDynamicNode = (int)ReadLong(p, end, ok);
+	LevelCache.TreeDynamicLine = (int)ReadLong(p, end, ok);
+
+	if (!ok || p != end) return false;
+	return DoomLevelAABBTree::CheckCacheData(Level, LevelCache.TreeNodes, LevelCache.TreeLines, LevelCache.TreeDynamicNode, LevelCache.TreeDynamicLine);
+}
+
 UNSAFE_CCMD(clearnodecache)
 {
 	TArray<FFileList> list;
@@ -60,6 +60,7 @@
 
 #include <math.h>
 #include <cmath>	// needed for std::floor on mac
+#include <future>
 #include "maploader.h"
 #include "c_cvars.h"
 #include "actor.h"
@@ -92,6 +93,7 @@ enum
 
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
+EXTERN_CVAR(Bool, gl_cachenodes)
 
 inline bool P_LoadBuildMap(uint8_t *mapdata, size_t len, FMapThing **things, int *numthings)
 {
@@ -392,12 +394,24 @@ void MapLoader::FloodZones ()
 	int z = 0, i;
 	ReverbContainer *reverb;
 
-	for (auto &sec : Level->sectors)
+	if (LevelCache.Valid)
 	{
-		if (sec.ZoneNumber == 0xFFFF)
+		for (unsigned i = 0; i < Level->sectors.Size(); i++)
 		{
-			FloodZone (&sec, z++);
+			Level->sectors[i].ZoneNumber = LevelCache.ZoneNumbers[i];
 		}
+		z = LevelCache.NumZones;
+	}
+	else
+	{
+		for (auto &sec : Level->sectors)
+		{
+			if (sec.ZoneNumber == 0xFFFF)
+			{
+				FloodZone (&sec, z++);
+			}
+		}
+		LevelCache.NumZones = z;
 	}
 	Level->Zones.Resize(z);
 	reverb = S_FindEnvironment(Level->DefaultEnvironment);
@@ -2322,7 +2336,7 @@ static void CreatePackedBlockmap (TArray<int> &BlockMap, TArray<int> *blocks, in
 }
 
 
-void MapLoader::CreateBlockMap ()
+unsigned MapLoader::CreateBlockMap ()
 {
 	enum
 	{
@@ -2339,7 +2353,7 @@ void MapLoader::CreateBlockMap ()
 	int line;
 
 	if (Level->vertexes.Size() == 0)
-		return;
+		return 0;
 
 	// Find map extents for the blockmap
 	dminx = dmaxx = Level->vertexes[0].fX();
@@ -2494,6 +2508,26 @@ void MapLoader::CreateBlockMap ()
 	{
 		Level->blockmap.blockmaplump[ii] = BlockMap[ii];
 	}
+	return BlockMap.Size();
+}
+
+//===========================================================================
+//
+// UseCachedBlockMap
+//
+// Checks if a previously generated blockmap for this map can be reused.
+//
+//===========================================================================
+
+bool MapLoader::UseCachedBlockMap(MapData *map)
+{
+	if (gl_cachenodes && Level->maptype != MAPTYPE_BUILD && CheckCachedBlockMap(map))
+	{
+		DPrintf (DMSG_SPAMMY, "Using cached BLOCKMAP\n");
+		return true;
+	}
+	DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
+	return false;
 }
 
 
@@ -2590,9 +2624,12 @@ bool FBlockmap::VerifyBlockMap(int count, unsigned numlines)
 //
 // killough 3/30/98: Rewritten to remove blockmap limit
 //
+// Returns true if a new blockmap needs to be generated. This is left to
+// the caller so that it can run concurrently with the sector setup.
+//
 //===========================================================================
 
-void MapLoader::LoadBlockMap (MapData * map)
+bool MapLoader::LoadBlockMap (MapData * map)
 {
 	int count = map->Size(ML_BLOCKMAP);
 
@@ -2601,8 +2638,7 @@ void MapLoader::LoadBlockMap (MapData * map)
 		Args->CheckParm("-blockmap")
 		)
 	{
-		DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-		CreateBlockMap ();
+		return !UseCachedBlockMap(map);
 	}
 	else
 	{
@@ -2631,11 +2667,31 @@ void MapLoader::LoadBlockMap (MapData * map)
 
 		if (!Level->blockmap.VerifyBlockMap(count, Level->lines.Size()))
 		{
-			DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-			CreateBlockMap();
+			delete[] Level->blockmap.blockmaplump;
+			Level->blockmap.blockmaplump = nullptr;
+			return !UseCachedBlockMap(map);
 		}
 
 	}
+	return false;
+}
+
+//===========================================================================
+//
+// FinishBlockMap
+//
+// Sets up the blockmap's derived data once the lump has been loaded or
+// generated. 'generated' is the size of a newly built blockmap, which
+// gets written to the cache.
+//
+//===========================================================================
+
+void MapLoader::FinishBlockMap (MapData * map, unsigned generated)
+{
+	if (generated > 0 && gl_cachenodes && Level->maptype != MAPTYPE_BUILD)
+	{
+		CreateCachedBlockMap(map, generated);
+	}
 
 	Level->blockmap.bmaporgx = Level->blockmap.blockmaplump[0];
 	Level->blockmap.bmaporgy = Level->blockmap.blockmaplump[1];
@@ -2643,7 +2699,7 @@ void MapLoader::LoadBlockMap (MapData * map)
 	Level->blockmap.bmapheight = Level->blockmap.blockmaplump[3];
 
 	// clear out mobj chains
-	count = Level->blockmap.bmapwidth*Level->blockmap.bmapheight;
+	int count = Level->blockmap.bmapwidth*Level->blockmap.bmapheight;
 	Level->blockmap.blocklinks = new FBlockNode *[count];
 	memset (Level->blockmap.blocklinks, 0, count*sizeof(*Level->blockmap.blocklinks));
 	Level->blockmap.blockmap = Level->blockmap.blockmaplump+4;
@@ -2945,9 +3001,11 @@ void MapLoader::CalcIndices()
 void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 {
 	const int *oldvertextable  = nullptr;
+	const uint64_t loadstart = I_nsTime();
 
 	// note: most of this ordering is important 
 	ForceNodeBuild = gennodes;
+	PassTimes.Clear();
 
 	// [RH] Load in the BEHAVIOR lump
 	if (map->HasBehavior)
@@ -3045,6 +3103,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 
 	SummarizeMissingTextures(missingtex);
 	bool reloop = false;
+	const uint64_t nodestart = I_nsTime();
 
 	if (!ForceNodeBuild)
 	{
@@ -3174,18 +3233,60 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	// use in P_PointInSubsector to avoid problems with maps that depend on the specific
 	// nodes they were built with (P:AR E1M3 is a good example for a map where this is the case.)
 	reloop |= CheckNodes(map, BuildGLNodes, (uint32_t)(endTime - startTime));
+	PassTimes.Push({ "Nodes", nodestart, I_nsTime(), false });
 	
 	// set the head node for gameplay purposes. If the separate gamenodes array is not empty, use that, otherwise use the render nodes.
 	Level->headgamenode = Level->gamenodes.Size() > 0 ? &Level->gamenodes[Level->gamenodes.Size() - 1] : Level->nodes.Size() ? &Level->nodes[Level->nodes.Size() - 1] : nullptr;
 
-	LoadBlockMap(map);
+	// A generated blockmap only depends on the vertex and line positions, which
+	// no longer change at this point, so it can be built on a worker thread
+	// while the sectors get set up.
+	std::future<unsigned> blockmapjob;
+	uint64_t blockmapstart = 0, blockmapend = 0;
+	bool buildblockmap = false;
+
+	// The cached blockmap, sound zones and AABB tree are all keyed by a hash of this geometry.
+	const bool cachelevel = gl_cachenodes && Level->maptype != MAPTYPE_BUILD;
+	LevelCache = FLevelDataCache();
+	if (cachelevel)
+	{
+		TimePass("LevelDataHash", [&]() { LevelCache.Hash = GetLevelDataHash(); });
+	}
+	TimePass("LoadBlockMap", [&]() { buildblockmap = LoadBlockMap(map); });
+	if (buildblockmap)
+	{
+		blockmapjob = std::async(std::launch::async, [&]()
+		{
+			blockmapstart = I_nsTime();
+			unsigned count = CreateBlockMap();
+			blockmapend = I_nsTime();
+			return count;
+		});
+	}
+
+	TimePass("LoadReject", [&]() { LoadReject(map, false); });
+	TimePass("GroupLines", [&]() { GroupLines(false); });
+
+	// The sound zones and the AABB tree can be taken from the cache if nothing they depend on has changed.
+	if (cachelevel)
+	{
+		TimePass("CheckLevelCache", [&]() { LevelCache.Valid = CheckCachedLevelData(map); });
+	}
+	TimePass("FloodZones", [&]() { FloodZones(); });
+	TimePass("FixRenderSectors", [&]()
+	{
+		SetRenderSector();
+		FixMinisegReferences();
+		FixHoles();
+	});
 
-	LoadReject(map, false);
-	GroupLines(false);
-	FloodZones();
-	SetRenderSector();
-	FixMinisegReferences();
-	FixHoles();
+	unsigned blockmapsize = 0;
+	if (blockmapjob.valid())
+	{
+		blockmapsize = blockmapjob.get();
+		PassTimes.Push({ "CreateBlockMap", blockmapstart, blockmapend, true });
+	}
+	FinishBlockMap(map, blockmapsize);
 
 	// Create the item indices, after the last function which may change the data has run.
 	CalcIndices();
@@ -3197,16 +3298,19 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	for (auto & p : Level->bodyque)
 		p = nullptr;
 
-	CreateSections(Level);
+	TimePass("CreateSections", [&]() { CreateSections(Level); });
 
 	// [RH] Spawn slope creating things first.
-	SpawnSlopeMakers(&MapThingsConverted[0], &MapThingsConverted[MapThingsConverted.Size()], oldvertextable);
-	CopySlopes();
+	TimePass("Slopes", [&]()
+	{
+		SpawnSlopeMakers(&MapThingsConverted[0], &MapThingsConverted[MapThingsConverted.Size()], oldvertextable);
+		CopySlopes();
+	});
 
 	// Spawn 3d floors - must be done before spawning things so it can't be done in P_SpawnSpecials
-	Spawn3DFloors();
+	TimePass("Spawn3DFloors", [&]() { Spawn3DFloors(); });
 
-	SpawnThings(position);
+	TimePass("SpawnThings", [&]() { SpawnThings(position); });
 
 	// Load and link lightmaps - must be done after P_Spawn3DFloors (and SpawnThings? Potentially for baking static model actors?)
 	if (!ForceNodeBuild)
@@ -3228,7 +3332,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	}
 
 	// set up world state
-	SpawnSpecials();
+	TimePass("SpawnSpecials", [&]() { SpawnSpecials(); });
 
 	// disable reflective planes on sloped sectors.
 	for (auto &sec : Level->sectors)
@@ -3245,9 +3349,9 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 		node.len = (float)g_sqrt(fdx * fdx + fdy * fdy);
 	}
 
-	InitRenderInfo();				// create hardware independent renderer resources for the level. This must be done BEFORE the PolyObj Spawn!!!
+	TimePass("InitRenderInfo", [&]() { InitRenderInfo(); });	// create hardware independent renderer resources for the level. This must be done BEFORE the PolyObj Spawn!!!
 	Level->ClearDynamic3DFloorData();	// CreateVBO must be run on the plain 3D floor data.
-	CreateVBO(screen->mVertexData, Level->sectors);
+	TimePass("CreateVBO", [&]() { CreateVBO(screen->mVertexData, Level->sectors); });
 
 	screen->InitLightmap(Level->LMTextureSize, Level->LMTextureCount, Level->LMTextureData);
 
@@ -3261,12 +3365,59 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	P_InitHealthGroups(Level);
 
 	if (reloop) LoopSidedefs(false);
-	PO_Init();				// Initialize the polyobjs
+	TimePass("PO_Init", [&]() { PO_Init(); });				// Initialize the polyobjs
 	if (!Level->IsReentering())
 		Level->FinalizePortals();	// finalize line portals after polyobjects have been initialized. This info is needed for properly flagging them.
 
-	Level->aabbTree = new DoomLevelAABBTree(Level);
-	Level->levelMesh = new DoomLevelMesh(*Level);
+	TimePass("LineTree", [&]() { Level->LineTree.Build(Level); });
+	TimePass("AABBTree", [&]()
+	{
+		if (LevelCache.Valid && !DoomLevelAABBTree::CheckCacheLines(Level, LevelCache.TreeLines, LevelCache.TreeDynamicLine))
+		{
+			// The polyobjects are different, so the cached sound zones can stay but the tree must be rebuilt and written again.
+			LevelCache.Valid = false;
+		}
+		if (LevelCache.Valid)
+		{
+			Level->aabbTree = new DoomLevelAABBTree(Level, LevelCache.TreeNodes, LevelCache.TreeLines, LevelCache.TreeDynamicNode, LevelCache.TreeDynamicLine);
+		}
+		else
+		{
+			Level->aabbTree = new DoomLevelAABBTree(Level);
+		}
+	});
+	if (cachelevel && !LevelCache.Valid)
+	{
+		CreateCachedLevelData(map);
+	}
+	LevelCache = FLevelDataCache();
+	TimePass("LevelMesh", [&]() { Level->levelMesh = new DoomLevelMesh(*Level); });
+	PrintPassTimes(loadstart);
+}
+
+//==========================================================================
+//
+// Map load timing
+//
+//==========================================================================
+
+template<class Func> void MapLoader::TimePass(const char *name, Func &&func)
+{
+	uint64_t start = I_nsTime();
+	func();
+	PassTimes.Push({ name, start, I_nsTime(), false });
+}
+
+void MapLoader::PrintPassTimes(uint64_t loadstart)
+{
+	uint64_t loadend = I_nsTime();
+	uint64_t mainthread = 0;
+	for (auto &pass : PassTimes)
+	{
+		if (!pass.Worker) mainthread += pass.End - pass.Start;
+		DPrintf(DMSG_NOTIFY, "%-20s %8.3f ms%s (at %.3f ms)\n", pass.Name, (pass.End - pass.Start) * 1e-6, pass.Worker ? " [worker]" : "", (pass.Start - loadstart) * 1e-6);
+	}
+	DPrintf(DMSG_NOTIFY, "Level setup took %.3f ms, %.3f ms of it in the timed passes on the main thread\n", (loadend - loadstart) * 1e-6, mainthread * 1e-6);
 }
 
 //==========================================================================
@@ -2,6 +2,7 @@
 
 #include "nodebuild.h"
 #include "g_levellocals.h"
+#include "hw_aabbtree.h"
 
 class FileReader;
 struct FStrifeDialogueNode;
@@ -130,6 +131,31 @@ private:
 	// Polyobject init
 	TArray<int32_t> KnownPolySides;
 
+	// Timing of the post-processing passes in LoadLevel
+	struct FLoadPassTime
+	{
+		const char *Name;
+		uint64_t Start, End;	// nanoseconds
+		bool Worker;			// run concurrently with the main thread
+	};
+	TArray<FLoadPassTime> PassTimes;
+
+	// Index-only results of the level setup passes, cached next to the nodes
+	struct FLevelDataCache
+	{
+		bool Valid = false;
+		uint32_t Hash = 0;
+		uint32_t NumZones = 0;
+		TArray<uint16_t> ZoneNumbers;
+		TArray<hwrenderer::AABBTreeNode> TreeNodes;
+		TArray<int> TreeLines;
+		int TreeDynamicNode = 0;
+		int TreeDynamicLine = 0;
+	};
+	FLevelDataCache LevelCache;
+	template<class Func> void TimePass(const char *name, Func &&func);
+	void PrintPassTimes(uint64_t loadstart);
+
 	FName CheckCompatibility(MapData *map);
 	void PostProcessLevel(FName checksum);
 
@@ -166,6 +192,11 @@ private:
 	bool LoadNodes(FileReader &lump);
 	bool DoLoadGLNodes(FileReader * lumps);
 	void CreateCachedNodes(MapData *map);
+	void CreateCachedBlockMap(MapData *map, unsigned count);
+	bool CheckCachedBlockMap(MapData *map);
+	uint32_t GetLevelDataHash();
+	void CreateCachedLevelData(MapData *map);
+	bool CheckCachedLevelData(MapData *map);
 
 	// Render info
 	void PrepareSectorData();
@@ -228,7 +259,8 @@ private:
 	void AllocateSideDefs(MapData *map, int count);
 	void ProcessSideTextures(bool checktranmap, side_t *sd, sector_t *sec, intmapsidedef_t *msd, int special, int tag, short *alpha, FMissingTextureTracker &missingtex);
 	void SetMapThingUserData(AActor *actor, unsigned udi);
-	void CreateBlockMap();
+	unsigned CreateBlockMap();
+	bool UseCachedBlockMap(MapData *map);
 	void PO_Init(void);
 
 	// During map init the items' own Index functions should not be used.
@@ -292,7 +324,8 @@ public:
 	void LoadLineDefs2(MapData * map);
 	void LoopSidedefs(bool firstloop);
 	void LoadSideDefs2(MapData *map, FMissingTextureTracker &missingtex);
-	void LoadBlockMap(MapData * map);
+	bool LoadBlockMap(MapData * map);
+	void FinishBlockMap(MapData * map, unsigned generated);
 	void LoadReject(MapData * map, bool junk);
 	void LoadBehavior(MapData * map);
 	void GetPolySpots(MapData * map, TArray<FNodeBuilder::FPolyStart> &spots, TArray<FNodeBuilder::FPolyStart> &anchors);
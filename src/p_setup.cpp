@@ -243,6 +243,7 @@ void FLevelLocals::ClearPortals()
 	linkedPortals.Clear();
 	sectorPortals.Resize(2);
 	PortalBlockmap.Clear();
+	InvalidatePortalQueryCache();
 
 	// The first entry must always be the default skybox. This is what every sector gets by default.
 	memset(&sectorPortals[0], 0, sizeof(sectorPortals[0]));
@@ -363,6 +364,7 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 		}
 	}
 	PolyBlockMap.Reset();
+	LineTree.Clear();
 
 	deathmatchstarts.Clear();
 	AllPlayerStarts.Clear();
@@ -39,6 +39,7 @@
 #include "actorinlines.h"
 #include "g_game.h"
 #include "i_interface.h"
+#include "a_dynlight.h"
 
 extern gamestate_t wipegamestate;
 extern uint8_t globalfreeze, globalchangefreeze;
@@ -143,6 +144,7 @@ void P_Ticker (void)
 		S_ResumeSound (false);
 
 	P_ResetSightCounters (false);
+	P_ResetLightLinkCounters();
 	R_ClearInterpolationPath();
 
 	// Since things will be moving, it's okay to interpolate them in the renderer.
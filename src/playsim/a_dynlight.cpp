@@ -64,11 +64,26 @@
 #include "a_dynlight.h"
 #include "actorinlines.h"
 #include "memarena.h"
+#include "stats.h"
 
 static FMemArena DynLightArena(sizeof(FDynamicLight) * 200);
 static TArray<FDynamicLight*> FreeList;
 static FRandom randLight;
 
+// Light nodes are pooled like the sector nodes, with nextTarget linking the free ones.
+static FMemArena LightNodeArena(sizeof(FLightNode) * 1024);
+static FLightNode *FreeLightNodes;
+
+// Link statistics, for the current and the last tic.
+struct FLightLinkCounters
+{
+	int Links;			// nodes added
+	int Unlinks;		// nodes removed
+	int Relinks;		// lights whose touched sections were collected again
+	int Skipped;		// light moves that stayed within the slack
+};
+static FLightLinkCounters LinkCounters, LastLinkCounters;
+
 extern TArray<FLightDefaults *> StateLights;
 
 
@@ -95,6 +110,7 @@ static FDynamicLight *GetLight(FLevelLocals *Level)
 	ret->mShadowmapIndex = 1024;
 	ret->Level = Level;
 	ret->Pos.X = -10000000;	// not a valid coordinate.
+	ret->m_linkRadius = -1;
 	return ret;
 }
 
@@ -407,11 +423,27 @@ void FDynamicLight::UpdateLocation()
 		if (X() != oldx || Y() != oldy || radius != oldradius)
 		{
 			//Update the light lists
-			LinkLight();
+			if (NeedsRelink()) LinkLight();
+			else LinkCounters.Skipped++;
 		}
 	}
 }
 
+//==========================================================================
+//
+// The light lists are collected for a slightly larger radius than the
+// light has, so a light that moves around a bit (bobbing, slow monsters,
+// lights attached to moving sectors) can keep its lists until it has moved
+// further than that, or its radius changes.
+//
+//==========================================================================
+
+bool FDynamicLight::NeedsRelink() const
+{
+	if (radius != m_linkRadius) return true;
+	return (Pos.XY() - m_linkPos).LengthSquared() > double(m_linkSlack) * m_linkSlack;
+}
+
 //=============================================================================
 //
 // These have been copied from the secnode code and modified for the light links
@@ -441,7 +473,16 @@ FLightNode * AddLightNode(FLightNode ** thread, void * linkto, FDynamicLight * l
 	// Couldn't find an existing node for this sector. Add one at the head
 	// of the list.
 	
-	node = new FLightNode;
+	if (FreeLightNodes != nullptr)
+	{
+		node = FreeLightNodes;
+		FreeLightNodes = node->nextTarget;
+	}
+	else
+	{
+		node = (FLightNode *)LightNodeArena.Alloc(sizeof(FLightNode));
+	}
+	LinkCounters.Links++;
 	
 	node->targ = linkto;
 	node->lightsource = light; 
@@ -484,7 +525,9 @@ static FLightNode * DeleteLightNode(FLightNode * node)
 		
 		// Return this node to the freelist
 		tn=node->nextTarget;
-		delete node;
+		node->nextTarget = FreeLightNodes;
+		FreeLightNodes = node;
+		LinkCounters.Unlinks++;
 		return(tn);
 	}
 	return(nullptr);
@@ -554,13 +597,15 @@ void FDynamicLight::CollectWithinRadius(const DVector3 &opos, FSection *section,
 			auto linedef = sidedef->linedef;
 			if (linedef && linedef->validcount != ::validcount)
 			{
-				// light is in front of the seg
-				if ((pos.Y - v1->fY()) * (v2->fX() - v1->fX()) + (v1->fX() - pos.X) * (v2->fY() - v1->fY()) <= 0)
+				double side = (pos.Y - v1->fY()) * (v2->fX() - v1->fX()) + (v1->fX() - pos.X) * (v2->fY() - v1->fY());
+
+				// light is in front of the seg, or can get there without being relinked
+				if (side <= 0 || (m_linkSlack > 0 && side <= m_linkSlack * (v2->fPos() - v1->fPos()).Length()))
 				{
 					linedef->validcount = ::validcount;
 					touching_sides = AddLightNode(&sidedef->lighthead, sidedef, this, touching_sides);
 				}
-				else if (linedef->sidedef[0] == sidedef && linedef->sidedef[1] == nullptr)
+				if (side > 0 && linedef->sidedef[0] == sidedef && linedef->sidedef[1] == nullptr)
 				{
 					hitonesidedback = true;
 				}
@@ -676,14 +721,20 @@ void FDynamicLight::LinkLight()
 		node = node->nextTarget;
 	}
 
+	m_linkPos = Pos.XY();
+	m_linkRadius = radius;
+	m_linkSlack = radius > 0 ? clamp(radius * 0.125f, 8.f, 64.f) : 0.f;
+	LinkCounters.Relinks++;
+
 	if (radius>0)
 	{
 		// passing in radius*radius allows us to do a distance check without any calls to sqrt
 		FSection *sect = Level->PointInRenderSubsector(Pos)->section;
+		float linkradius = radius + m_linkSlack;
 
 		dl_validcount++;
 		::validcount++;
-		CollectWithinRadius(Pos, sect, float(radius*radius));
+		CollectWithinRadius(Pos, sect, linkradius * linkradius);
 
 	}
 		
@@ -724,6 +775,27 @@ void FDynamicLight::UnlinkLight ()
 	while (touching_sides) touching_sides = DeleteLightNode(touching_sides);
 	while (touching_sector) touching_sector = DeleteLightNode(touching_sector);
 	shadowmapped = false;
+	m_linkRadius = -1;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void P_ResetLightLinkCounters()
+{
+	LastLinkCounters = LinkCounters;
+	memset(&LinkCounters, 0, sizeof(LinkCounters));
+}
+
+ADD_STAT(lightlinks)
+{
+	FString out;
+	out.Format("Light links per tic: %d added, %d removed, %d relinks, %d moves without relink",
+		LastLinkCounters.Links, LastLinkCounters.Unlinks, LastLinkCounters.Relinks, LastLinkCounters.Skipped);
+	return out;
 }
 
 //==========================================================================
@@ -252,6 +252,7 @@ struct FDynamicLight
 private:
 	double DistToSeg(const DVector3 &pos, vertex_t *start, vertex_t *end);
 	void CollectWithinRadius(const DVector3 &pos, FSection *section, float radius);
+	bool NeedsRelink() const;
 
 public:
 	FCycler m_cycler;
@@ -275,6 +276,9 @@ public:
 	FLightNode * touching_sector;
 	float radius;			// The maximum size the light can be with its current settings.
 	float m_currentRadius;	// The current light size.
+	DVector2 m_linkPos;		// where the light was when it was last linked
+	float m_linkRadius;		// radius it was linked with, -1 if not linked
+	float m_linkSlack;		// how far it may move before it needs to be relinked
 	int m_tickCount;
 	int m_lastUpdate;
 	int mShadowmapIndex;
@@ -288,4 +292,4 @@ public:
 
 };
 
-
+void P_ResetLightLinkCounters();
@@ -109,7 +109,7 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 	ThinkCycles.Clock();
 
 	bool dolights;
-	if ((gl_lights && vid_rendermode == 4) || (r_dynlights && vid_rendermode != 4))
+	if ((gl_lights && V_IsHardwareRenderer()) || (r_dynlights && !V_IsHardwareRenderer()))
 	{
 		dolights = true;// Level->lights || (Level->flags3 & LEVEL3_LIGHTCREATED);
 	}
@@ -285,7 +285,12 @@ void FThinkerCollection::DestroyAllThinkers(bool fullgc)
 		}
 	}
 	error |= Thinkers[MAX_STATNUM + 1].DoDestroyThinkers();
-	if (fullgc) GC::FullGC();
+	if (fullgc)
+	{
+		GC::FullGC();
+		// Most of the level's objects are gone now, so give their memory back.
+		GC::TrimPool();
+	}
 	if (error)
 	{
 		ClearGlobalVMStack();
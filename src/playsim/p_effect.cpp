@@ -49,12 +49,16 @@
 #include "vm.h"
 #include "actorinlines.h"
 #include "g_game.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "ctpl.h"
 
 CVAR (Int, cl_rockettrails, 1, CVAR_ARCHIVE);
 CVAR (Bool, r_rail_smartspiral, false, CVAR_ARCHIVE);
 CVAR (Int, r_rail_spiralsparsity, 1, CVAR_ARCHIVE);
 CVAR (Int, r_rail_trailsparsity, 1, CVAR_ARCHIVE);
 CVAR (Bool, r_particles, true, 0);
+CVAR (Int, r_particlethreads, 0, CVAR_ARCHIVE);	// 0 = one per core
 EXTERN_CVAR(Int, r_maxparticles);
 
 FRandom pr_railtrail("RailTrail");
@@ -177,7 +181,7 @@ void P_InitParticles (FLevelLocals *Level)
 		num = r_maxparticles;
 
 	// This should be good, but eh...
-	int NumParticles = clamp<int>(num, 100, 65535);
+	int NumParticles = clamp<int>(num, 100, MAX_PARTICLES);
 
 	Level->Particles.Resize(NumParticles);
 	P_ClearParticles (Level);
@@ -210,13 +214,13 @@ void P_FindParticleSubsectors (FLevelLocals *Level)
 		Level->ParticlesInSubsec.Reserve (Level->subsectors.Size() - Level->ParticlesInSubsec.Size());
 	}
 
-	fillshort (&Level->ParticlesInSubsec[0], Level->subsectors.Size(), NO_PARTICLE);
+	std::fill_n(Level->ParticlesInSubsec.Data(), Level->subsectors.Size(), NO_PARTICLE);
 
 	if (!r_particles)
 	{
 		return;
 	}
-	for (uint16_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->Particles[i].tnext)
+	for (uint32_t i = Level->ActiveParticles; i != NO_PARTICLE; i = Level->Particles[i].tnext)
 	{
 		 // Try to reuse the subsector from the last portal check, if still valid.
 		if (Level->Particles[i].subsector == nullptr) Level->Particles[i].subsector = Level->PointInRenderSubsector(Level->Particles[i].Pos);
@@ -263,10 +267,85 @@ void P_InitEffects ()
 	blood2 = ParticleColor(RPART(kind)/3, GPART(kind)/3, BPART(kind)/3);
 }
 
+//==========================================================================
+//
+// P_ThinkParticles
+//
+// Expiring particles must be unlinked, so that part walks the list. All
+// survivors then go into a flat list and move in batches, spread over
+// worker threads when there are enough of them. Moving a particle only
+// reads the level geometry, except for crossing line portals, which uses
+// the portal traverser and stays on the game thread.
+//
+//==========================================================================
+
+static ctpl::thread_pool ParticlePool;
+static TArray<uint32_t> ParticleThinkList;
+
+enum
+{
+	PARTICLE_BATCH = 2048,		// particles per job
+	PARTICLE_MT_MIN = 8192,		// don't bother with threads for fewer than this
+};
+
+static void P_MoveParticles (FLevelLocals *Level, const uint32_t *list, unsigned count, bool movexy)
+{
+	particle_t *particles = Level->Particles.Data();
+	for (unsigned n = 0; n < count; n++)
+	{
+		particle_t *particle = &particles[list[n]];
+
+		if (movexy)
+		{
+			particle->Pos.X += particle->Vel.X;
+			particle->Pos.Y += particle->Vel.Y;
+		}
+		particle->Pos.Z += particle->Vel.Z;
+		particle->Vel += particle->Acc;
+
+		if(particle->flags & PT_DOROLL)
+		{
+			particle->Roll += particle->RollVel;
+			particle->RollVel += particle->RollAcc;
+		}
+
+		particle->subsector = Level->PointInRenderSubsector(particle->Pos);
+		sector_t *s = particle->subsector->sector;
+		// Handle crossing a sector portal.
+		if (!s->PortalBlocksMovement(sector_t::ceiling))
+		{
+			if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
+			{
+				particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
+				particle->subsector = NULL;
+			}
+		}
+		else if (!s->PortalBlocksMovement(sector_t::floor))
+		{
+			if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
+			{
+				particle->Pos += s->GetPortalDisplacement(sector_t::floor);
+				particle->subsector = NULL;
+			}
+		}
+	}
+}
+
+static int P_ParticleThreads()
+{
+	int threads = r_particlethreads > 0 ? *r_particlethreads : (int)std::thread::hardware_concurrency();
+	return clamp(threads, 1, 16);
+}
+
 void P_ThinkParticles (FLevelLocals *Level)
 {
-	int i = Level->ActiveParticles;
+	uint32_t i = Level->ActiveParticles;
 	particle_t *particle = nullptr, *prev = nullptr;
+	// Line portals need the portal traverser, which is not thread safe.
+	const bool lineportals = Level->PortalBlockmap.containsLines;
+	auto &list = ParticleThinkList;
+
+	list.Clear();
 	while (i != NO_PARTICLE)
 	{
 		particle = &Level->Particles[i];
@@ -298,40 +377,108 @@ void P_ThinkParticles (FLevelLocals *Level)
 			continue;
 		}
 
-		// Handle crossing a line portal
-		DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
-		particle->Pos.X = newxy.X;
-		particle->Pos.Y = newxy.Y;
-		particle->Pos.Z += particle->Vel.Z;
-		particle->Vel += particle->Acc;
-
-		if(particle->flags & PT_DOROLL)
+		if (lineportals)
 		{
-			particle->Roll += particle->RollVel;
-			particle->RollVel += particle->RollAcc;
+			// Handle crossing a line portal
+			DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
+			particle->Pos.X = newxy.X;
+			particle->Pos.Y = newxy.Y;
 		}
-		
-		particle->subsector = Level->PointInRenderSubsector(particle->Pos);
-		sector_t *s = particle->subsector->sector;
-		// Handle crossing a sector portal.
-		if (!s->PortalBlocksMovement(sector_t::ceiling))
+		list.Push(uint32_t(particle - Level->Particles.Data()));
+		prev = particle;
+	}
+
+	const unsigned count = list.Size();
+	const int threads = P_ParticleThreads();
+	if (count < PARTICLE_MT_MIN || threads == 1)
+	{
+		P_MoveParticles(Level, list.Data(), count, !lineportals);
+		return;
+	}
+
+	// The game thread takes the first batch itself.
+	if (ParticlePool.size() != threads - 1)
+	{
+		ParticlePool.resize(threads - 1);
+	}
+	const uint32_t *indices = list.Data();
+	std::vector<std::future<void>> jobs;
+	for (unsigned start = PARTICLE_BATCH; start < count; start += PARTICLE_BATCH)
+	{
+		unsigned num = min<unsigned>(PARTICLE_BATCH, count - start);
+		jobs.push_back(ParticlePool.push([=](int) { P_MoveParticles(Level, indices + start, num, !lineportals); }));
+	}
+	P_MoveParticles(Level, indices, min<unsigned>(PARTICLE_BATCH, count), !lineportals);
+	for (auto &job : jobs)
+	{
+		job.wait();
+	}
+}
+
+//==========================================================================
+//
+// CCMD particlebench
+//
+// Fills the current level with particles flying around the player and
+// times P_ThinkParticles with one thread and with r_particlethreads.
+// The level's own particles are put back afterwards.
+//
+// particlebench [count] [tics]
+//
+//==========================================================================
+
+CCMD (particlebench)
+{
+	if (gamestate != GS_LEVEL || primaryLevel->subsectors.Size() == 0 || players[consoleplayer].mo == nullptr)
+	{
+		Printf("particlebench can only be used in a level\n");
+		return;
+	}
+	const int count = argv.argc() > 1 ? clamp(atoi(argv[1]), 100, (int)MAX_PARTICLES) : 100000;
+	const int tics = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 10000) : 100;
+
+	auto Level = primaryLevel;
+	TArray<particle_t> saved = std::move(Level->Particles);
+	const uint32_t oldest = Level->OldestParticle, active = Level->ActiveParticles, inactive = Level->InactiveParticles;
+	const int savedthreads = r_particlethreads;
+	const DVector3 center = players[consoleplayer].mo->Pos();
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		// Same particles for both passes.
+		uint32_t seed = 1;
+		auto rand = [&](double range) { seed = seed * 1664525u + 1013904223u; return (seed >> 16) * (range / 65536.); };
+		Level->Particles.Resize(count);
+		P_ClearParticles(Level);
+		for (int n = 0; n < count; n++)
 		{
-			if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
-				particle->subsector = NULL;
-			}
+			particle_t *p = NewParticle(Level);
+			p->Pos = center + DVector3(rand(2048.) - 1024., rand(2048.) - 1024., rand(64.));
+			p->Vel = DVector3(rand(8.) - 4., rand(8.) - 4., rand(4.));
+			p->Acc.Z = -1 / 16.;
+			p->ttl = tics + 1;
+			p->alpha = 1.f;
+			p->fadestep = 1.f / (tics + 2);
+			p->size = 4;
+			p->color = white;
 		}
-		else if (!s->PortalBlocksMovement(sector_t::floor))
+
+		r_particlethreads = pass == 0 ? 1 : savedthreads;
+		const uint64_t start = I_nsTime();
+		for (int t = 0; t < tics; t++)
 		{
-			if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::floor);
-				particle->subsector = NULL;
-			}
+			P_ThinkParticles(Level);
 		}
-		prev = particle;
+		const double ms = (I_nsTime() - start) * 1e-6;
+		Printf("%d threads: %d particles, %d tics in %.1f ms (%.3f ms per tic)\n",
+			P_ParticleThreads(), count, tics, ms, ms / tics);
 	}
+
+	r_particlethreads = savedthreads;
+	Level->Particles = std::move(saved);
+	Level->OldestParticle = oldest;
+	Level->ActiveParticles = active;
+	Level->InactiveParticles = inactive;
 }
 
 enum PSFlag
@@ -70,12 +70,13 @@ struct particle_t
     FTextureID texture;
     ERenderStyle style;
     double Roll, RollVel, RollAcc;
-    uint16_t    tnext, snext, tprev;
+    uint32_t    tnext, snext, tprev;
     uint8_t    bright;
 	uint8_t flags;
 };
 
-const uint16_t NO_PARTICLE = 0xffff;
+const uint32_t NO_PARTICLE = 0xffffffff;
+const uint32_t MAX_PARTICLES = 1000000;
 
 void P_InitParticles(FLevelLocals *);
 void P_ClearParticles (FLevelLocals *Level);
@@ -0,0 +1,295 @@
+/*
+** p_linetree.cpp
+** Bounding volume hierarchy over the static lines of a level
+**
+**---------------------------------------------------------------------------
+** Copyright 2024 the GZDoom team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <algorithm>
+#include <float.h>
+
+#include "p_linetree.h"
+#include "p_maputl.h"
+#include "p_blockmap.h"
+#include "g_levellocals.h"
+
+// Lines per leaf.
+static constexpr int LEAF_LINES = 4;
+
+// The node boxes are grown by this much so that rounding in the intercept
+// math can't make a crossed line miss its box.
+static constexpr double BOX_MARGIN = 1.;
+
+// A line that runs almost exactly along the trace can get an intercept
+// anywhere on it. The blockmap walk only finds such a line in a block the
+// trace touches, so it's enough to extend the trace by a block diagonal.
+static constexpr double TRACE_EXTENSION = FBlockmap::MAPBLOCKUNITS * 1.5;
+
+//===========================================================================
+//
+// FLineTree :: Clear
+//
+//===========================================================================
+
+void FLineTree::Clear()
+{
+	Nodes.Reset();
+	Lines.Reset();
+	LineBlockStart.Reset();
+	LineBlocks.Reset();
+	PolyBlocks.Reset();
+	BlockStamp.Reset();
+	BlockStep.Reset();
+	Stamp = 0;
+}
+
+//===========================================================================
+//
+// FLineTree :: Build
+//
+// Must be called after the polyobjects have been spawned.
+//
+//===========================================================================
+
+void FLineTree::Build(FLevelLocals *Level)
+{
+	Clear();
+
+	auto &bmap = Level->blockmap;
+	const unsigned numlines = Level->lines.Size();
+	const int numblocks = bmap.bmapwidth * bmap.bmapheight;
+	if (numlines == 0 || numblocks <= 0 || bmap.blockmaplump == nullptr)
+	{
+		return;
+	}
+
+	TArray<uint8_t> polylines(numlines, true);
+	memset(polylines.Data(), 0, numlines);
+	for (auto &poly : Level->Polyobjects)
+	{
+		for (auto ld : poly.Linedefs)
+		{
+			polylines[ld->Index()] = 1;
+		}
+	}
+
+	// Invert the blockmap.
+	LineBlockStart.Resize(numlines + 1);
+	memset(LineBlockStart.Data(), 0, LineBlockStart.Size() * sizeof(int));
+	PolyBlocks.Resize(numblocks);
+	memset(PolyBlocks.Data(), 0, numblocks);
+	for (int block = 0; block < numblocks; block++)
+	{
+		for (int *list = bmap.GetLines(block % bmap.bmapwidth, block / bmap.bmapwidth); *list != -1; list++)
+		{
+			LineBlockStart[*list + 1]++;
+			if (polylines[*list]) PolyBlocks[block] = 1;
+		}
+	}
+	for (unsigned i = 0; i < numlines; i++)
+	{
+		LineBlockStart[i + 1] += LineBlockStart[i];
+	}
+	LineBlocks.Resize(LineBlockStart[numlines]);
+	TArray<int> fill(numlines, true);
+	memcpy(fill.Data(), LineBlockStart.Data(), numlines * sizeof(int));
+	for (int block = 0; block < numblocks; block++)
+	{
+		int index = 0;
+		for (int *list = bmap.GetLines(block % bmap.bmapwidth, block / bmap.bmapwidth); *list != -1; list++, index++)
+		{
+			LineBlocks[fill[*list]++] = { block, index };
+		}
+	}
+
+	BlockStamp.Resize(numblocks);
+	BlockStep.Resize(numblocks);
+	memset(BlockStamp.Data(), 0, numblocks * sizeof(int));
+
+	TArray<int> treelines;
+	TArray<double> centers(numlines * 2, true);
+	for (unsigned i = 0; i < numlines; i++)
+	{
+		if (polylines[i]) continue;
+		auto &ld = Level->lines[i];
+		centers[i * 2] = (ld.v1->fX() + ld.v2->fX()) * 0.5;
+		centers[i * 2 + 1] = (ld.v1->fY() + ld.v2->fY()) * 0.5;
+		treelines.Push(i);
+	}
+	if (treelines.Size() == 0)
+	{
+		Clear();
+		return;
+	}
+	Lines.Grow(treelines.Size());
+	BuildNode(Level, treelines.Data(), treelines.Size(), centers);
+}
+
+//===========================================================================
+//
+// FLineTree :: BuildNode
+//
+// Splits at the median of the line centers along the longer axis, so the
+// tree is balanced and its depth stays small.
+//
+//===========================================================================
+
+int FLineTree::BuildNode(FLevelLocals *Level, int *lines, int count, TArray<double> &centers)
+{
+	FNode node;
+	node.minx = node.miny = DBL_MAX;
+	node.maxx = node.maxy = -DBL_MAX;
+	double cminx = DBL_MAX, cminy = DBL_MAX, cmaxx = -DBL_MAX, cmaxy = -DBL_MAX;
+	for (int i = 0; i < count; i++)
+	{
+		auto &ld = Level->lines[lines[i]];
+		node.minx = min(node.minx, min(ld.v1->fX(), ld.v2->fX()));
+		node.miny = min(node.miny, min(ld.v1->fY(), ld.v2->fY()));
+		node.maxx = max(node.maxx, max(ld.v1->fX(), ld.v2->fX()));
+		node.maxy = max(node.maxy, max(ld.v1->fY(), ld.v2->fY()));
+		cminx = min(cminx, centers[lines[i] * 2]);
+		cminy = min(cminy, centers[lines[i] * 2 + 1]);
+		cmaxx = max(cmaxx, centers[lines[i] * 2]);
+		cmaxy = max(cmaxy, centers[lines[i] * 2 + 1]);
+	}
+	node.minx -= BOX_MARGIN;
+	node.miny -= BOX_MARGIN;
+	node.maxx += BOX_MARGIN;
+	node.maxy += BOX_MARGIN;
+
+	if (count <= LEAF_LINES)
+	{
+		node.left = node.right = -1;
+		node.first = Lines.Size();
+		node.count = count;
+		for (int i = 0; i < count; i++)
+		{
+			Lines.Push(lines[i]);
+		}
+	}
+	else
+	{
+		const int axis = (cmaxx - cminx) >= (cmaxy - cminy) ? 0 : 1;
+		const int half = count / 2;
+		std::nth_element(lines, lines + half, lines + count, [&](int a, int b)
+		{
+			return centers[a * 2 + axis] < centers[b * 2 + axis];
+		});
+		node.left = BuildNode(Level, lines, half, centers);
+		node.right = BuildNode(Level, lines + half, count - half, centers);
+		node.first = node.count = 0;
+	}
+	Nodes.Push(node);
+	return Nodes.Size() - 1;
+}
+
+//===========================================================================
+//
+// FLineTree :: Collect
+//
+// Returns every line whose box the trace passes between startfrac and its
+// end. This is a superset of the lines the trace crosses; the caller does
+// the exact test.
+//
+//===========================================================================
+
+void FLineTree::Collect(const divline_t &trace, double startfrac, TArray<int> &out) const
+{
+	out.Clear();
+	if (Nodes.Size() == 0) return;
+
+	double x = trace.x + trace.dx * startfrac;
+	double y = trace.y + trace.dy * startfrac;
+	double dx = trace.dx - trace.dx * startfrac;
+	double dy = trace.dy - trace.dy * startfrac;
+	const double len = sqrt(dx * dx + dy * dy);
+	if (len > 0)
+	{
+		const double ex = dx / len * TRACE_EXTENSION;
+		const double ey = dy / len * TRACE_EXTENSION;
+		x -= ex;
+		y -= ey;
+		dx += ex * 2;
+		dy += ey * 2;
+	}
+
+	// Slab test against the node's box.
+	auto hits = [=](const FNode &node)
+	{
+		double tmin = 0, tmax = 1;
+		if (dx == 0)
+		{
+			if (x < node.minx || x > node.maxx) return false;
+		}
+		else
+		{
+			double t1 = (node.minx - x) / dx;
+			double t2 = (node.maxx - x) / dx;
+			if (t1 > t2) std::swap(t1, t2);
+			tmin = max(tmin, t1);
+			tmax = min(tmax, t2);
+		}
+		if (dy == 0)
+		{
+			if (y < node.miny || y > node.maxy) return false;
+		}
+		else
+		{
+			double t1 = (node.miny - y) / dy;
+			double t2 = (node.maxy - y) / dy;
+			if (t1 > t2) std::swap(t1, t2);
+			tmin = max(tmin, t1);
+			tmax = min(tmax, t2);
+		}
+		return tmin <= tmax;
+	};
+
+	// The tree is balanced, so this is far deeper than any level needs.
+	int stack[64];
+	int sp = 0;
+	stack[sp++] = Nodes.Size() - 1;
+	while (sp > 0)
+	{
+		const FNode &node = Nodes[stack[--sp]];
+		if (!hits(node)) continue;
+		if (node.left == -1)
+		{
+			for (int i = 0; i < node.count; i++)
+			{
+				out.Push(Lines[node.first + i]);
+			}
+		}
+		else
+		{
+			stack[sp++] = node.right;
+			stack[sp++] = node.left;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "tarray.h"
+
+struct FLevelLocals;
+struct divline_t;
+
+//===========================================================================
+//
+// Bounding volume hierarchy over the level's static lines
+//
+// FPathTraverse uses it to find the lines a trace crosses without testing
+// every line in every blockmap block along the way. Polyobject lines are
+// not in the tree because they move; traces that touch polyobjects use
+// the blockmap only.
+//
+// The tree also keeps the inverse of the blockmap, i.e. the blocks that list
+// each line and where, so that the traverser can put the intercepts in the
+// exact order the blockmap walk would have produced them.
+//
+//===========================================================================
+
+struct FLineTree
+{
+	struct FNode
+	{
+		double minx, miny, maxx, maxy;
+		int left, right;		// -1 for leaves
+		int first, count;		// range in Lines for leaves
+	};
+
+	struct FBlockEntry
+	{
+		int block;				// blockmap block index
+		int index;				// position in that block's line list
+	};
+
+	TArray<FNode> Nodes;			// root is the last node
+	TArray<int> Lines;				// line indices, grouped by leaf
+	TArray<int> LineBlockStart;		// per line, first entry in LineBlocks (one extra at the end)
+	TArray<FBlockEntry> LineBlocks;
+	TArray<uint8_t> PolyBlocks;		// blocks whose line list contains a polyobject line
+
+	// Scratch data for the traverser.
+	TArray<int> BlockStamp;
+	TArray<int> BlockStep;
+	int Stamp = 0;
+
+	bool IsValid() const { return Nodes.Size() > 0; }
+	void Build(FLevelLocals *Level);
+	void Clear();
+	void Collect(const divline_t &trace, double startfrac, TArray<int> &out) const;
+
+private:
+	int BuildNode(FLevelLocals *Level, int *lines, int count, TArray<double> &centers);
+};
@@ -61,6 +61,8 @@
 
 
 #include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
 
 
 #include "m_bbox.h"
@@ -79,6 +81,9 @@
 // State.
 #include "po_man.h"
 #include "vm.h"
+#include "d_player.h"
+#include "c_dispatch.h"
+#include "i_time.h"
 
 int P_VanillaPointOnDivlineSide(double x, double y, const divline_t* line);
 
@@ -1164,6 +1169,57 @@ void FMultiBlockThingsIterator::Reset()
 
 TArray<intercept_t> FPathTraverse::intercepts(128);
 
+// Traces that cross fewer blocks than this don't use the line tree.
+static constexpr int LINETREE_MINBLOCKS = 4;
+static bool UseLineTree = true;
+
+// Scratch data for AddTreeIntercepts. init doesn't call out anywhere, so
+// nested traversals can't clobber it.
+struct FBlockStep
+{
+	int x, y;
+	bool lines;
+	bool compatible;
+};
+
+struct FTreeIntercept
+{
+	uint64_t key;
+	double frac;
+	line_t *line;
+};
+
+static TArray<FBlockStep> BlockSteps;
+static TArray<int> TreeLines;
+static TArray<FTreeIntercept> TreeIntercepts;
+
+//===========================================================================
+//
+// FPathTraverse :: InterceptLine
+//
+// A line is crossed if its endpoints
+// are on opposite sides of the trace.
+//
+//===========================================================================
+
+bool FPathTraverse::InterceptLine(const line_t *ld, double &frac) const
+{
+	int 				s1;
+	int 				s2;
+	divline_t			dl;
+
+	s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
+	s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
+	
+	if (s1 == s2) return false;	// line isn't crossed
+	
+	// hit the line
+	P_MakeDivline (ld, &dl);
+	frac = P_InterceptVector (&trace, &dl);
+
+	return frac >= Startfrac && frac <= 1.;	// not behind source or beyond end point
+}
+
 
 //===========================================================================
 //
@@ -1172,9 +1228,6 @@ TArray<intercept_t> FPathTraverse::intercepts(128);
 // that intercept the given trace
 // to add to the intercepts list.
 //
-// A line is crossed if its endpoints
-// are on opposite sides of the trace.
-//
 //===========================================================================
 
 void FPathTraverse::AddLineIntercepts(int bx, int by)
@@ -1184,21 +1237,9 @@ void FPathTraverse::AddLineIntercepts(int bx, int by)
 
 	while ((ld = it.Next()))
 	{
-		int 				s1;
-		int 				s2;
 		double 				frac;
-		divline_t			dl;
 
-		s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
-		s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
-		
-		if (s1 == s2) continue;	// line isn't crossed
-		
-		// hit the line
-		P_MakeDivline (ld, &dl);
-		frac = P_InterceptVector (&trace, &dl);
-
-		if (frac < Startfrac || frac > 1.) continue;	// behind source or beyond end point
+		if (!InterceptLine(ld, frac)) continue;
 			
 		intercept_t newintercept;
 
@@ -1387,6 +1428,105 @@ void FPathTraverse::AddThingIntercepts (int bx, int by, FBlockThingsIterator &it
 }
 
 
+//===========================================================================
+//
+// FPathTraverse :: AddTreeIntercepts
+//
+// Adds the intercepts for the blocks init walked, using the line tree
+// instead of testing every line in every block. The result is exactly what
+// calling AddLineIntercepts and AddThingIntercepts for each step would
+// give, in the same order: a line belongs to the first step whose block
+// lists it and comes at its position in that block's list.
+//
+//===========================================================================
+
+void FPathTraverse::AddTreeIntercepts(FBlockThingsIterator &it)
+{
+	auto &tree = Level->LineTree;
+	auto &bmap = Level->blockmap;
+
+	if (++tree.Stamp == INT_MAX)
+	{
+		memset(tree.BlockStamp.Data(), 0, tree.BlockStamp.Size() * sizeof(int));
+		tree.Stamp = 1;
+	}
+
+	bool polyobjs = false;
+	for (unsigned i = 0; i < BlockSteps.Size(); i++)
+	{
+		auto &step = BlockSteps[i];
+		if (!step.lines || !bmap.isValidBlock(step.x, step.y)) continue;
+
+		int block = step.y * bmap.bmapwidth + step.x;
+		if (tree.BlockStamp[block] == tree.Stamp) continue;
+		tree.BlockStamp[block] = tree.Stamp;
+		tree.BlockStep[block] = i;
+		if (tree.PolyBlocks[block] || (Level->PolyBlockMap.Size() > (unsigned)block && Level->PolyBlockMap[block] != nullptr))
+		{
+			polyobjs = true;
+		}
+	}
+
+	if (polyobjs)
+	{
+		// Polyobject lines move, so they are not in the tree.
+		for (auto &step : BlockSteps)
+		{
+			if (step.lines) AddLineIntercepts(step.x, step.y);
+			else AddThingIntercepts(step.x, step.y, it, step.compatible);
+		}
+		return;
+	}
+
+	tree.Collect(trace, Startfrac, TreeLines);
+	TreeIntercepts.Clear();
+	for (int linenum : TreeLines)
+	{
+		line_t *ld = &Level->lines[linenum];
+		double frac;
+
+		if (!InterceptLine(ld, frac)) continue;
+
+		uint64_t key = UINT64_MAX;
+		for (int j = tree.LineBlockStart[linenum]; j < tree.LineBlockStart[linenum + 1]; j++)
+		{
+			auto &entry = tree.LineBlocks[j];
+			if (tree.BlockStamp[entry.block] == tree.Stamp)
+			{
+				key = min(key, (uint64_t(tree.BlockStep[entry.block]) << 32) | unsigned(entry.index));
+			}
+		}
+		if (key != UINT64_MAX)	// the walk doesn't pass any block that lists the line
+		{
+			TreeIntercepts.Push({ key, frac, ld });
+		}
+	}
+	std::sort(TreeIntercepts.begin(), TreeIntercepts.end(), [](const FTreeIntercept &a, const FTreeIntercept &b) { return a.key < b.key; });
+
+	unsigned next = 0;
+	for (unsigned i = 0; i < BlockSteps.Size(); i++)
+	{
+		auto &step = BlockSteps[i];
+		if (step.lines)
+		{
+			for (; next < TreeIntercepts.Size() && (TreeIntercepts[next].key >> 32) == i; next++)
+			{
+				intercept_t newintercept;
+
+				newintercept.frac = TreeIntercepts[next].frac;
+				newintercept.isaline = true;
+				newintercept.done = false;
+				newintercept.d.line = TreeIntercepts[next].line;
+				intercepts.Push (newintercept);
+			}
+		}
+		else
+		{
+			AddThingIntercepts(step.x, step.y, it, step.compatible);
+		}
+	}
+}
+
 //===========================================================================
 //
 // FPathTraverse :: Next
@@ -1554,16 +1694,33 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		
 	// we want to use one list of checked actors for the entire operation
 	FBlockThingsIterator btit(Level);
+
+	// With the line tree the blocks are only recorded here and
+	// AddTreeIntercepts fills in the intercepts afterward.
+	const bool usetree = UseLineTree && (flags & PT_ADDLINES) && Level->LineTree.IsValid() && CanUseLineTree() &&
+		abs(mapex - mapx) + abs(mapey - mapy) >= LINETREE_MINBLOCKS;
+	auto addLines = [&](int x, int y)
+	{
+		if (usetree) BlockSteps.Push({ x, y, true, false });
+		else AddLineIntercepts(x, y);
+	};
+	auto addThings = [&](int x, int y, bool compat)
+	{
+		if (usetree) BlockSteps.Push({ x, y, false, compat });
+		else AddThingIntercepts(x, y, btit, compat);
+	};
+	if (usetree) BlockSteps.Clear();
+
 	for (count = 0 ; count < 1000 ; count++)
 	{
 		if (flags & PT_ADDLINES)
 		{
-			AddLineIntercepts(mapx, mapy);
+			addLines(mapx, mapy);
 		}
 		
 		if (flags & PT_ADDTHINGS)
 		{
-			AddThingIntercepts(mapx, mapy, btit, compatible);
+			addThings(mapx, mapy, compatible);
 		}
 				
 		// both coordinates reached the end, so end the traversing.
@@ -1602,14 +1759,14 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 			{
 				if (flags & PT_ADDLINES)
 				{
-					AddLineIntercepts(mapx + mapxstep, mapy);
-					AddLineIntercepts(mapx, mapy + mapystep);
+					addLines(mapx + mapxstep, mapy);
+					addLines(mapx, mapy + mapystep);
 				}
 				
 				if (flags & PT_ADDTHINGS)
 				{
-					AddThingIntercepts(mapx + mapxstep, mapy, btit, false);
-					AddThingIntercepts(mapx, mapy + mapystep, btit, false);
+					addThings(mapx + mapxstep, mapy, false);
+					addThings(mapx, mapy + mapystep, false);
 				}
 				xintercept += xstep;
 				yintercept += ystep;
@@ -1627,6 +1784,11 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 			break;
 		}
 	}
+
+	if (usetree)
+	{
+		AddTreeIntercepts(btit);
+	}
 }
 
 //===========================================================================
@@ -2131,3 +2293,63 @@ DEFINE_ACTION_FUNCTION(FLevelLocals, BoxOnLineSide)
 	ACTION_RETURN_INT(BoxOnLineSide(box, l));
 }
 
+//===========================================================================
+//
+// CCMD linetreebench
+//
+// Fires random traces from the player's position, once through the plain
+// blockmap walk and once through the line tree, and checks that both give
+// the same intercepts in the same order.
+//
+// linetreebench [traces] [length]
+//
+//===========================================================================
+
+CCMD(linetreebench)
+{
+	if (gamestate != GS_LEVEL || players[consoleplayer].mo == nullptr)
+	{
+		Printf("linetreebench can only be used in a level\n");
+		return;
+	}
+	const int traces = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 1000000) : 10000;
+	const double length = argv.argc() > 2 ? clamp(atof(argv[2]), 64., 65536.) : 8192.;
+	auto Level = primaryLevel;
+	const DVector2 start = players[consoleplayer].mo->Pos().XY();
+
+	uint32_t seed;
+	auto randf = [&]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1. / 16777216.); };
+
+	const bool wasused = UseLineTree;
+	double ms[2];
+	uint64_t hash[2];
+	unsigned found[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		UseLineTree = pass == 1;
+		seed = 1;
+		hash[pass] = 14695981039346656037ull;
+		found[pass] = 0;
+		const uint64_t starttime = I_nsTime();
+		for (int i = 0; i < traces; i++)
+		{
+			const double angle = randf() * 2 * M_PI;
+			FPathTraverse it(Level, start.X, start.Y, cos(angle) * length, sin(angle) * length, PT_ADDLINES | PT_ADDTHINGS | PT_DELTA);
+			intercept_t *in;
+			while ((in = it.Next()))
+			{
+				uint64_t fracbits;
+				memcpy(&fracbits, &in->frac, sizeof(fracbits));
+				hash[pass] = (hash[pass] ^ fracbits) * 1099511628211ull;
+				hash[pass] = (hash[pass] ^ (uintptr_t)in->d.thing) * 1099511628211ull;
+				found[pass]++;
+			}
+		}
+		ms[pass] = (I_nsTime() - starttime) * 1e-6;
+	}
+	UseLineTree = wasused;
+
+	Printf("%d traces of %g units, %u intercepts: blockmap %.2f ms, line tree %.2f ms (%.1fx)%s\n",
+		traces, length, found[0], ms[0], ms[1], ms[0] / max(ms[1], 1e-6),
+		hash[0] == hash[1] && found[0] == found[1] ? "" : ", results differ");
+}
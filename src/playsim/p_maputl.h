@@ -373,6 +373,9 @@ protected:
 
 	virtual void AddLineIntercepts(int bx, int by);
 	virtual void AddThingIntercepts(int bx, int by, FBlockThingsIterator &it, bool compatible);
+	virtual bool CanUseLineTree() const { return true; }
+	bool InterceptLine(const line_t *ld, double &frac) const;
+	void AddTreeIntercepts(FBlockThingsIterator &it);
 	FPathTraverse(FLevelLocals *l) 
 	{
 		Level = l;
@@ -104,6 +104,13 @@ CVAR(Bool, sv_singleplayerrespawn, false, CVAR_SERVERINFO | CVAR_CHEAT)
 CVAR (Bool, cl_noprediction, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR(Bool, cl_predict_specials, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
+// Keep the predicted state between frames and only re-simulate from the
+// authoritative state once new tics have been run.
+CUSTOM_CVAR(Bool, cl_predict_rollback, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	P_PredictionLerpReset();
+}
+
 CUSTOM_CVAR(Float, cl_predict_lerpscale, 0.05f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 {
 	P_PredictionLerpReset();
@@ -133,6 +140,41 @@ struct PredictPos
 } static PredictionLerpFrom, PredictionLerpResult, PredictionLast;
 static int PredictionLerptics;
 
+// Predicted positions are remembered per tic so that they can be compared
+// against the authoritative result once that tic has actually been run.
+static struct PredictionCheck
+{
+	bool valid;
+	int gametic;
+	DVector2 pos;
+} PredictionHistory[BACKUPTICS];
+
+static struct PredictionStats
+{
+	int Frames;
+	int Tics;
+	int MaxTics;
+	int Checks;
+	int Misses;
+	int Resumed;
+	int Rollbacks;
+	cycle_t Time;
+} PredictionStats;
+
+// With cl_predict_rollback the result of the last prediction is kept, so
+// that frames which do not run any new tics only need to simulate the
+// tics that were added locally since then. It is only valid as long as
+// the authoritative state it was predicted from has not changed.
+static struct PredictionRollback
+{
+	bool valid;
+	int basetic;
+	int tic;
+	AActor *actor;
+	player_t player;
+	TArray<uint8_t> actorstate;
+} PredictionSnapshot;
+
 static player_t PredictionPlayerBackup;
 static AActor *PredictionActor;
 static TArray<uint8_t> PredictionActorBackupArray;
@@ -1279,6 +1321,37 @@ void P_PlayerThink (player_t *player)
 void P_PredictionLerpReset()
 {
 	PredictionLerptics = PredictionLast.gametic = PredictionLerpFrom.gametic = PredictionLerpResult.gametic = 0;
+	PredictionSnapshot.valid = false;
+}
+
+//==========================================================================
+//
+// STAT prediction
+//
+// Shows how far ahead the local player is being predicted and how often
+// the prediction did not match the tic that was eventually run.
+//
+//==========================================================================
+
+ADD_STAT(prediction)
+{
+	FString out;
+	auto &stats = PredictionStats;
+	out.Format("Predicted frames: %d  Avg tics: %.2f  Max tics: %d  Time: %.3f ms/frame\n"
+		"Checked tics: %d  Mispredicted: %d (%.1f%%)  Resumed frames: %d  Rollbacks: %d",
+		stats.Frames, stats.Frames ? double(stats.Tics) / stats.Frames : 0., stats.MaxTics,
+		stats.Frames ? stats.Time.TimeMS() / stats.Frames : 0.,
+		stats.Checks, stats.Misses, stats.Checks ? 100. * stats.Misses / stats.Checks : 0.,
+		stats.Resumed, stats.Rollbacks);
+	return out;
+}
+
+CCMD(resetpredictionstats)
+{
+	PredictionStats.Frames = PredictionStats.Tics = PredictionStats.MaxTics = 0;
+	PredictionStats.Checks = PredictionStats.Misses = 0;
+	PredictionStats.Resumed = PredictionStats.Rollbacks = 0;
+	PredictionStats.Time.Reset();
 }
 
 bool P_LerpCalculate(AActor *pmo, PredictPos from, PredictPos to, PredictPos &result, float scale)
@@ -1391,6 +1464,57 @@ nodetype *RestoreNodeList(AActor *act, nodetype *head, nodetype *linktype::*othe
 	return head;
 }
 
+//==========================================================================
+//
+// ResumePrediction
+//
+// Puts the player back into the state the last prediction ended with.
+// The actor gets relinked at the predicted position the same way as any
+// movement during prediction would do it, and P_UnPredictPlayer will
+// restore the authoritative links afterward.
+//
+//==========================================================================
+
+static void ResumePrediction(player_t *player)
+{
+	AActor *act = player->mo;
+	AActor *savedcamera = player->camera;
+	const bool settings_controller = player->settings_controller;
+	auto &actInvSel = act->PointerVar<AActor*>(NAME_InvSel);
+	auto InvSel = actInvSel;
+	int inventorytics = player->inventorytics;
+
+	player->CopyFrom(PredictionSnapshot.player, false);
+	player->camera = savedcamera;
+	player->settings_controller = settings_controller;
+	player->inventorytics = inventorytics;
+
+	FLinkContext ctx;
+	act->UnlinkFromWorld(&ctx);
+
+	// The link fields belong to the current links, not to the ones the snapshot was taken with.
+	auto snext = act->snext;
+	auto sprev = act->sprev;
+	auto blocknode = act->BlockNode;
+	auto sectorlist = act->touching_sectorlist;
+	auto sectorportallist = act->touching_sectorportallist;
+	auto lineportallist = act->touching_lineportallist;
+	auto rendersectors = act->touching_rendersectors;
+
+	memcpy(&act->snext, PredictionSnapshot.actorstate.Data(), PredictionSnapshot.actorstate.Size() - ((uint8_t *)&act->snext - (uint8_t *)act));
+
+	act->snext = snext;
+	act->sprev = sprev;
+	act->BlockNode = blocknode;
+	act->touching_sectorlist = sectorlist;
+	act->touching_sectorportallist = sectorportallist;
+	act->touching_lineportallist = lineportallist;
+	act->touching_rendersectors = rendersectors;
+
+	act->LinkToWorld(&ctx);
+	actInvSel = InvSel;
+}
+
 void P_PredictPlayer (player_t *player)
 {
 	int maxtic;
@@ -1410,11 +1534,28 @@ void P_PredictPlayer (player_t *player)
 
 	maxtic = maketic;
 
+	// The actor's current position is the authoritative result of the last
+	// tic that was run, so check how well that was predicted.
+	auto &check = PredictionHistory[(gametic - 1 + BACKUPTICS) % BACKUPTICS];
+	if (check.valid && check.gametic == gametic - 1)
+	{
+		// Z is not compared as lifts will alter this with no apparent change
+		PredictionStats.Checks++;
+		if ((int)check.pos.X != (int)player->mo->X() || (int)check.pos.Y != (int)player->mo->Y())
+		{
+			PredictionStats.Misses++;
+		}
+		check.valid = false;
+	}
+
 	if (gametic == maxtic)
 	{
 		return;
 	}
 
+	PredictionStats.Time.Clock();
+	PredictionStats.Frames++;
+
 	// Save original values for restoration later
 	PredictionPlayerBackup.CopyFrom(*player, false);
 
@@ -1461,9 +1602,29 @@ void P_PredictPlayer (player_t *player)
 	}
 	act->BlockNode = NULL;
 
+	int starttic = gametic;
+	if (cl_predict_rollback && PredictionSnapshot.valid && PredictionSnapshot.actor == act)
+	{
+		if (PredictionSnapshot.basetic == gametic && PredictionSnapshot.tic <= maxtic)
+		{
+			// Nothing has been run since the last prediction, so continue where it ended.
+			ResumePrediction(player);
+			starttic = PredictionSnapshot.tic;
+			PredictionStats.Resumed++;
+		}
+		else
+		{
+			// New authoritative tics have been run, so roll back to them and simulate the rest again.
+			PredictionStats.Rollbacks++;
+		}
+	}
+	PredictionSnapshot.valid = false;
+	PredictionStats.Tics += maxtic - starttic;
+	PredictionStats.MaxTics = max(PredictionStats.MaxTics, maxtic - starttic);
+
 	// Values too small to be usable for lerping can be considered "off".
 	bool CanLerp = (!(cl_predict_lerpscale < 0.01f) && (ticdup == 1)), DoLerp = false, NoInterpolateOld = R_GetViewInterpolationStatus();
-	for (int i = gametic; i < maxtic; ++i)
+	for (int i = starttic; i < maxtic; ++i)
 	{
 		if (!NoInterpolateOld)
 			R_RebuildViewInterpolation(player);
@@ -1472,6 +1633,8 @@ void P_PredictPlayer (player_t *player)
 		P_PlayerThink (player);
 		player->mo->Tick ();
 
+		PredictionHistory[i % BACKUPTICS] = { true, i, player->mo->Pos().XY() };
+
 		if (CanLerp && PredictionLast.gametic > 0 && i == PredictionLast.gametic && !NoInterpolateOld)
 		{
 			// Z is not compared as lifts will alter this with no apparent change
@@ -1489,6 +1652,17 @@ void P_PredictPlayer (player_t *player)
 		}
 	}
 
+	if (cl_predict_rollback)
+	{
+		PredictionSnapshot.player.CopyFrom(*player, false);
+		PredictionSnapshot.actorstate.Resize(act->GetClass()->Size);
+		memcpy(PredictionSnapshot.actorstate.Data(), &act->snext, act->GetClass()->Size - ((uint8_t *)&act->snext - (uint8_t *)act));
+		PredictionSnapshot.actor = act;
+		PredictionSnapshot.basetic = gametic;
+		PredictionSnapshot.tic = maxtic;
+		PredictionSnapshot.valid = true;
+	}
+
 	if (CanLerp)
 	{
 		if (NoInterpolateOld)
@@ -1519,6 +1693,7 @@ void P_PredictPlayer (player_t *player)
 			}
 		}
 	}
+	PredictionStats.Time.Unclock();
 }
 
 void P_UnPredictPlayer ()
@@ -830,6 +830,8 @@ void FPolyObj::UpdateLinks()
 				}
 			}
 		}
+		// The portal lines and the displacements have moved.
+		Level->InvalidatePortalQueryCache();
 	}
 }
 
@@ -37,10 +37,16 @@
 #include "p_spec.h"
 #include "g_levellocals.h"
 #include "vm.h"
+#include "d_player.h"
+#include "i_time.h"
 
 // simulation recurions maximum
 CVAR(Int, sv_portal_recursions, 4, CVAR_ARCHIVE|CVAR_SERVERINFO)
 
+// Queries with a larger radius than this don't use the portal query cache.
+static constexpr double PORTAL_QUERY_RADIUS = 256;
+static bool UsePortalQueryCache = true;
+
 DEFINE_FIELD(FSectorPortal, mType);
 DEFINE_FIELD(FSectorPortal, mFlags);
 DEFINE_FIELD(FSectorPortal, mPartner);
@@ -75,6 +81,7 @@ void FLevelLocals::BuildPortalBlockmap()
 
 	PortalBlockmap.Clear();
 	PortalBlockmap.Create(bmapwidth, bmapheight);
+	InvalidatePortalQueryCache();
 	for (int y = 0; y < bmapheight; y++)
 	{
 		for (int x = 0; x < bmapwidth; x++)
@@ -123,6 +130,7 @@ void FLevelLocals::BuildPortalBlockmap()
 class FLinePortalTraverse : public FPathTraverse
 {
 	void AddLineIntercepts(int bx, int by);
+	bool CanUseLineTree() const { return false; }
 
 public:
 	FLinePortalTraverse(FLevelLocals *l) : FPathTraverse(l)
@@ -292,6 +300,7 @@ void FLevelLocals::UpdatePortal(FLinePortal *port)
 
 	// Cache the angle between the two linedefs, for rotating.
 	SetPortalRotation(port);
+	InvalidatePortalQueryCache();
 }
 
 //============================================================================
@@ -369,6 +378,7 @@ bool FLevelLocals::ChangePortalLine(line_t *line, int destid)
 		port->mFlags = port->mDefFlags;
 	}
 	SetPortalRotation(port);
+	InvalidatePortalQueryCache();
 	return true;
 }
 
@@ -1027,6 +1037,8 @@ void FLevelLocals::CreateLinkedPortals()
 		if (sec.PortalIsLinked(sector_t::floor)) sec.planes[sector_t::floor].Flags |= PLANEF_LINKED;
 		if (sec.PortalIsLinked(sector_t::ceiling)) sec.planes[sector_t::ceiling].Flags |= PLANEF_LINKED;
 	}
+	// The displacements are final now.
+	InvalidatePortalQueryCache();
 	if (linkedPortals.Size() > 0)
 	{
 		// We need to relink all actors that may touch a linked line portal
@@ -1050,6 +1062,55 @@ void FLevelLocals::CreateLinkedPortals()
 }
 
 
+//============================================================================
+//
+// Returns the linked portals a box of up to PORTAL_QUERY_RADIUS around
+// the given position may touch, in the same order as linkedPortals, or
+// nullptr if the whole list needs to be checked. The lists are made per
+// blockmap cell on first use and thrown away whenever a portal or a
+// displacement changes. A cell only remembers the group that asked first,
+// so queries from other groups at group borders use the full list.
+//
+//============================================================================
+
+TArray<FLinePortal*> *FLevelLocals::GetPortalQueryList(int startgroup, const DVector3 &position, double checkradius)
+{
+	if (!UsePortalQueryCache || checkradius < 0 || checkradius > PORTAL_QUERY_RADIUS || PortalBlockmap.dx == 0)
+	{
+		return nullptr;
+	}
+	const int bx = (int)floor((position.X - blockmap.bmaporgx) / FBlockmap::MAPBLOCKUNITS);
+	const int by = (int)floor((position.Y - blockmap.bmaporgy) / FBlockmap::MAPBLOCKUNITS);
+	if (bx < 0 || by < 0 || bx >= PortalBlockmap.dx || by >= PortalBlockmap.dy)
+	{
+		return nullptr;
+	}
+
+	if (PortalQueryCache.Size() == 0)
+	{
+		PortalQueryCache.Resize(PortalBlockmap.dx * PortalBlockmap.dy);
+	}
+	FPortalQueryCell &cell = PortalQueryCache[bx + by * PortalBlockmap.dx];
+	if (cell.group == -1)
+	{
+		cell.group = startgroup;
+		const double left = blockmap.bmaporgx + bx * FBlockmap::MAPBLOCKUNITS;
+		const double bottom = blockmap.bmaporgy + by * FBlockmap::MAPBLOCKUNITS;
+		for (auto port : linkedPortals)
+		{
+			line_t *ld = port->mOrigin;
+			FDisplacement &disp = Displacements(startgroup, ld->frontsector->PortalGroup);
+			if (!disp.isSet) continue;
+
+			FBoundingBox box(left + disp.pos.X - PORTAL_QUERY_RADIUS, bottom + disp.pos.Y - PORTAL_QUERY_RADIUS,
+				left + disp.pos.X + FBlockmap::MAPBLOCKUNITS + PORTAL_QUERY_RADIUS, bottom + disp.pos.Y + FBlockmap::MAPBLOCKUNITS + PORTAL_QUERY_RADIUS);
+			if (inRange(box, ld)) cell.portals.Push(port);
+		}
+		cell.portals.ShrinkToFit();
+	}
+	return cell.group == startgroup ? &cell.portals : nullptr;
+}
+
 //============================================================================
 //
 // Collect all portal groups this actor would occupy at the given position
@@ -1078,17 +1139,20 @@ bool FLevelLocals::CollectConnectedGroups(int startgroup, const DVector3 &positi
 		processMask.setBit(thisgroup);
 		//out.Add(thisgroup);
 
-		for (unsigned i = 0; i < linkedPortals.Size(); i++)
+		// Usually only a handful of the level's linked portals can be near the position.
+		auto candidates = GetPortalQueryList(startgroup, position, checkradius);
+		auto &portals = candidates != nullptr ? *candidates : linkedPortals;
+		for (unsigned i = 0; i < portals.Size(); i++)
 		{
-			line_t *ld = linkedPortals[i]->mOrigin;
+			line_t *ld = portals[i]->mOrigin;
 			int othergroup = ld->frontsector->PortalGroup;
 			FDisplacement &disp = Displacements(thisgroup, othergroup);
 			if (!disp.isSet) continue;	// no connection.
 
 			FBoundingBox box(position.X + disp.pos.X, position.Y + disp.pos.Y, checkradius);
 
-			if (!inRange(box, ld) || BoxOnLineSide(box, linkedPortals[i]->mOrigin) != -1) continue;	// not touched
-			foundPortals.Push(linkedPortals[i]);
+			if (!inRange(box, ld) || BoxOnLineSide(box, portals[i]->mOrigin) != -1) continue;	// not touched
+			foundPortals.Push(portals[i]);
 		}
 		bool foundone = true;
 		while (foundone)
@@ -1193,3 +1257,62 @@ bool FLevelLocals::CollectConnectedGroups(int startgroup, const DVector3 &positi
 	}
 	return retval;
 }
+
+//============================================================================
+//
+// CCMD portalquerybench
+//
+// Times the portal group collection for random actor-sized boxes around
+// the player, once over all linked portals and once through the cache.
+//
+// portalquerybench [queries]
+//
+//============================================================================
+
+CCMD(portalquerybench)
+{
+	if (gamestate != GS_LEVEL || players[consoleplayer].mo == nullptr)
+	{
+		Printf("portalquerybench can only be used in a level\n");
+		return;
+	}
+	const int queries = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000000) : 100000;
+	auto Level = primaryLevel;
+	const DVector3 center = players[consoleplayer].mo->Pos();
+
+	uint32_t seed;
+	auto randf = [&](double range) { seed = seed * 1664525u + 1013904223u; return ((seed >> 8) & 0xffff) * (range / 65536.) - range / 2; };
+
+	// Pick the positions up front so that PointInSector isn't part of the timing.
+	TArray<DVector3> positions(queries, true);
+	TArray<int> groups(queries, true);
+	seed = 1;
+	for (int i = 0; i < queries; i++)
+	{
+		positions[i] = center + DVector3(randf(4096.), randf(4096.), 0);
+		groups[i] = Level->PointInSector(positions[i].XY())->PortalGroup;
+	}
+
+	const bool wasused = UsePortalQueryCache;
+	double ms[2];
+	unsigned found[2] = { 0, 0 };
+	Level->InvalidatePortalQueryCache();
+	for (int pass = 0; pass < 2; pass++)
+	{
+		UsePortalQueryCache = pass == 1;
+		FPortalGroupArray check;
+		const uint64_t start = I_nsTime();
+		for (int i = 0; i < queries; i++)
+		{
+			check.Clear();
+			Level->CollectConnectedGroups(groups[i], positions[i], positions[i].Z + 56, 32, check);
+			found[pass] += check.Size();
+		}
+		ms[pass] = (I_nsTime() - start) * 1e-6;
+	}
+	UsePortalQueryCache = wasused;
+
+	Printf("%d queries, %u linked portals: full list %.2f ms, cached %.2f ms (%.1fx)%s\n",
+		queries, Level->linkedPortals.Size(), ms[0], ms[1], ms[0] / max(ms[1], 1e-6),
+		found[0] == found[1] ? "" : ", results differ");
+}
@@ -318,7 +318,7 @@ FVector4 V_CalcBlend(sector_t* viewsector, PalEntry* modulateColor)
 			if (in->IsKindOf(torchtype))
 			{
 				// The software renderer already bakes the torch flickering into its output, so this must be omitted here.
-				float r = vid_rendermode < 4 ? 1.f : (0.8f + (7 - player->fixedlightlevel) / 70.0f);
+				float r = !V_IsHardwareRenderer() ? 1.f : (0.8f + (7 - player->fixedlightlevel) / 70.0f);
 				if (r > 1.0f) r = 1.0f;
 				int rr = (int)(r * 255);
 				int b = rr;
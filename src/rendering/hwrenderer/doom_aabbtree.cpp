@@ -64,6 +64,87 @@ DoomLevelAABBTree::DoomLevelAABBTree(FLevelLocals *lev)
 		nodes.Push({ aabb_min, aabb_max, staticroot, dynamicroot });
 	}
 
+	CreateTreeLines();
+}
+
+DoomLevelAABBTree::DoomLevelAABBTree(FLevelLocals *lev, TArray<AABBTreeNode> &cachednodes, TArray<int> &cachedlines, int dynamicnode, int dynamicline)
+{
+	Level = lev;
+	nodes = std::move(cachednodes);
+	mapLines = std::move(cachedlines);
+	dynamicStartNode = dynamicnode;
+	dynamicStartLine = dynamicline;
+	CreateTreeLines();
+	// The cache was written after the polyobjects had been moved to their start spots, which may be different ones now.
+	RefitNodes();
+}
+
+bool DoomLevelAABBTree::CheckCacheData(FLevelLocals *lev, const TArray<AABBTreeNode> &cachednodes, const TArray<int> &cachedlines, int dynamicnode, int dynamicline)
+{
+	const int numnodes = cachednodes.Size();
+	const int numlines = cachedlines.Size();
+	if (dynamicnode < 0 || dynamicnode > numnodes || dynamicline < 0 || dynamicline > numlines)
+		return false;
+
+	for (int i = 0; i < numlines; i++)
+	{
+		if (cachedlines[i] < 0 || cachedlines[i] >= (int)lev->lines.Size())
+			return false;
+	}
+
+	// Child nodes are always generated before their parent, so every reference must point backwards.
+	for (int i = 0; i < numnodes; i++)
+	{
+		const auto &node = cachednodes[i];
+		if (node.line_index >= 0)
+		{
+			if (node.line_index >= numlines || node.left_node != -1 || node.right_node != -1)
+				return false;
+		}
+		else if (node.left_node < 0 || node.left_node >= i || node.right_node < 0 || node.right_node >= i)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DoomLevelAABBTree::CheckCacheLines(FLevelLocals *lev, const TArray<int> &cachedlines, int dynamicline)
+{
+	auto &maplines = lev->lines;
+	unsigned numstatic = 0, numdynamic = 0;
+	for (auto &line : maplines)
+	{
+		if (!line.backsector)
+		{
+			bool isPolyLine = line.sidedef[0] && (line.sidedef[0]->Flags & WALLF_POLYOBJ);
+			if (isPolyLine) numdynamic++;
+			else numstatic++;
+		}
+	}
+	if (numstatic != (unsigned)dynamicline || numstatic + numdynamic != cachedlines.Size())
+		return false;
+
+	for (unsigned i = 0; i < cachedlines.Size(); i++)
+	{
+		const auto &line = maplines[cachedlines[i]];
+		bool isPolyLine = line.sidedef[0] && (line.sidedef[0]->Flags & WALLF_POLYOBJ);
+		if (line.backsector || isPolyLine != (i >= (unsigned)dynamicline))
+			return false;
+	}
+	return true;
+}
+
+void DoomLevelAABBTree::GetCacheData(TArray<AABBTreeNode> &outnodes, TArray<int> &outlines, int &dynamicnode, int &dynamicline) const
+{
+	outnodes = nodes;
+	outlines = mapLines;
+	dynamicnode = dynamicStartNode;
+	dynamicline = dynamicStartLine;
+}
+
+void DoomLevelAABBTree::CreateTreeLines()
+{
 	// Add the lines referenced by the leaf nodes
 	treelines.Resize(mapLines.Size());
 	for (unsigned int i = 0; i < mapLines.Size(); i++)
@@ -78,6 +159,31 @@ DoomLevelAABBTree::DoomLevelAABBTree(FLevelLocals *lev)
 	}
 }
 
+void DoomLevelAABBTree::RefitNodes()
+{
+	// Children always come before their parent, so one pass is enough.
+	for (auto &node : nodes)
+	{
+		if (node.line_index >= 0)
+		{
+			const auto &treeline = treelines[node.line_index];
+			node.aabb_left = min(treeline.x, treeline.x + treeline.dx);
+			node.aabb_right = max(treeline.x, treeline.x + treeline.dx);
+			node.aabb_top = min(treeline.y, treeline.y + treeline.dy);
+			node.aabb_bottom = max(treeline.y, treeline.y + treeline.dy);
+		}
+		else
+		{
+			const auto &left = nodes[node.left_node];
+			const auto &right = nodes[node.right_node];
+			node.aabb_left = min(left.aabb_left, right.aabb_left);
+			node.aabb_top = min(left.aabb_top, right.aabb_top);
+			node.aabb_right = max(left.aabb_right, right.aabb_right);
+			node.aabb_bottom = max(left.aabb_bottom, right.aabb_bottom);
+		}
+	}
+}
+
 bool DoomLevelAABBTree::GenerateTree(const FVector2 *centroids, bool dynamicsubtree)
 {
 	// Create a list of level lines we want to add:
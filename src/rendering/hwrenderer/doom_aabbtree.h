@@ -9,9 +9,18 @@ class DoomLevelAABBTree : public hwrenderer::LevelAABBTree
 public:
 	// Constructs a tree for the current level
 	DoomLevelAABBTree(FLevelLocals *lev);
+	// Constructs a tree from the data of a previous GetCacheData call, which must have passed CheckCacheData.
+	DoomLevelAABBTree(FLevelLocals *lev, TArray<hwrenderer::AABBTreeNode> &cachednodes, TArray<int> &cachedlines, int dynamicnode, int dynamicline);
 	bool Update() override;
 
+	void GetCacheData(TArray<hwrenderer::AABBTreeNode> &outnodes, TArray<int> &outlines, int &dynamicnode, int &dynamicline) const;
+	static bool CheckCacheData(FLevelLocals *lev, const TArray<hwrenderer::AABBTreeNode> &cachednodes, const TArray<int> &cachedlines, int dynamicnode, int dynamicline);
+	// Checks that the cached lines are split into the static and the dynamic subtree the same way. Needs the polyobjects to be set up.
+	static bool CheckCacheLines(FLevelLocals *lev, const TArray<int> &cachedlines, int dynamicline);
+
 private:
+	void CreateTreeLines();
+	void RefitNodes();
 	bool GenerateTree(const FVector2 *centroids, bool dynamicsubtree);
 
 	// Generate a tree node and its children recursively
@@ -51,8 +51,15 @@
 #include "hwrenderer/scene/hw_clipper.h"
 #include "hwrenderer/scene/hw_portal.h"
 #include "hw_vrmodes.h"
+#include "hw_nullbackend.h"
+#include "hw_models.h"
+#include "model.h"
+#include "sc_man.h"
+#include "c_dispatch.h"
 
 EXTERN_CVAR(Bool, cl_capfps)
+EXTERN_CVAR(Bool, gl_multithread)
+EXTERN_CVAR(Int, gl_bspworkers)
 extern bool NoInterpolateView;
 
 static SWSceneDrawer *swdrawer;
@@ -406,3 +413,319 @@ sector_t* RenderView(player_t* player)
 	return retsec;
 }
 
+
+//===========================================================================
+//
+// CCMD hwbench
+//
+// Flies the camera along a path and builds the hardware renderer's scene
+// for every frame on top of the null backend, so that only the CPU side
+// gets measured. The GPU and the driver never see any of it, so this is
+// comparable across machines with different video hardware.
+//
+// hwbench [path file] [frames per segment] [csv file] [max workers]
+//
+// The path file has one "x y z yaw pitch" key frame per line, with z being
+// the eye height, and the camera moves in a straight line from one to the
+// next. Without one ("-") the camera turns around once at the current
+// view. The CSV file gets the times of every single frame.
+//
+// The times for walls, flats and sprites are summed over all threads. The
+// portal time includes the scenes seen through the portals and the sort
+// time is part of the draw time, which is everything after the scene was
+// set up, so the columns do not add up to the frame time.
+//
+// With a worker count the path gets flown once for every number of BSP
+// workers from 1 up to it, and only the frame and BSP times of each run
+// get printed, to show how the scene setup scales.
+//
+// When the game runs on the null video backend (-nullvideo) that is used
+// directly, so this also works on machines without a GPU. There is no
+// window to type into then, so the map and the bench have to be started
+// from the command line, with a wait for the level to get loaded first:
+//
+//   -nullvideo "+map MAP01; wait 5; hwbench - 70 - 8; quit"
+//
+// The player gets moved along the path, so this is not allowed in netgames
+// and demos.
+//
+//===========================================================================
+
+CCMD(hwbench)
+{
+	struct BenchKey
+	{
+		DVector3 pos;
+		DAngle yaw, pitch;
+	};
+
+	enum
+	{
+		BT_FRAME, BT_BSP, BT_WALLS, BT_FLATS, BT_SPRITES, BT_PORTALS, BT_SORT, BT_DRAW, BT_DRAWCALLS,
+		BT_COUNT
+	};
+	static const char *const names[BT_COUNT] = { "frame", "bsp", "walls", "flats", "sprites", "portals", "sort", "draw", "drawcalls" };
+
+	player_t *player = &players[consoleplayer];
+	AActor *mo = player->mo;
+	auto activenull = dynamic_cast<FNullFrameBuffer*>(screen);
+	if (gamestate != GS_LEVEL || mo == nullptr || (activenull == nullptr && (!V_IsHardwareRenderer() || screen->RenderState() == nullptr)))
+	{
+		Printf("hwbench can only be used in a level with the hardware renderer or the null video backend\n");
+		return;
+	}
+	if (netgame || demoplayback || demorecording)
+	{
+		Printf("hwbench cannot be used in netgames or demos\n");
+		return;
+	}
+
+	const char *pathfile = argv.argc() > 1 && strcmp(argv[1], "-") ? argv[1] : nullptr;
+	const int perseg = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 10000) : 16;
+	const char *csvfile = argv.argc() > 3 && strcmp(argv[3], "-") ? argv[3] : nullptr;
+	const int maxworkers = argv.argc() > 4 ? clamp(atoi(argv[4]), 1, 16) : 0;
+
+	TArray<BenchKey> keys;
+	if (pathfile != nullptr)
+	{
+		FScanner sc;
+		if (!sc.OpenFile(pathfile))
+		{
+			Printf("Could not open %s\n", pathfile);
+			return;
+		}
+		while (sc.GetFloat())
+		{
+			BenchKey key;
+			key.pos.X = sc.Float;
+			sc.MustGetFloat();
+			key.pos.Y = sc.Float;
+			sc.MustGetFloat();
+			key.pos.Z = sc.Float;
+			sc.MustGetFloat();
+			key.yaw = DAngle::fromDeg(sc.Float);
+			sc.MustGetFloat();
+			key.pitch = DAngle::fromDeg(sc.Float);
+			keys.Push(key);
+		}
+	}
+	else
+	{
+		for (int i = 0; i <= 4; i++)
+		{
+			keys.Push({ DVector3(mo->Pos().XY(), player->viewz), mo->Angles.Yaw + DAngle::fromDeg(i * 90.), mo->Angles.Pitch });
+		}
+	}
+	if (keys.Size() == 0)
+	{
+		Printf("No key frames in %s\n", pathfile);
+		return;
+	}
+
+	FileWriter *csv = nullptr;
+	if (csvfile != nullptr)
+	{
+		csv = FileWriter::Open(csvfile);
+		if (csv == nullptr)
+		{
+			Printf("Could not write %s\n", csvfile);
+			return;
+		}
+		csv->Printf("workers,frame,x,y,z,yaw,pitch");
+		for (auto name : names) csv->Printf(",%s", name);
+		csv->Printf(",vertices\n");
+	}
+
+	auto Level = mo->Level;
+	TArray<double> savedheights;
+	DFrameBuffer *realscreen = screen;
+	FNullFrameBuffer *nullscreen = activenull;
+	if (nullscreen == nullptr)
+	{
+		// Models cache their vertex buffers, so they must all have real ones
+		// before the null backend gets the chance to give them one.
+		FModelRenderer *renderer = new FHWModelRenderer(nullptr, *screen->RenderState(), -1);
+		for (auto model : Models)
+		{
+			model->BuildVertexBuffer(renderer);
+		}
+		delete renderer;
+
+		// Only the null vertex buffer gets updated while this runs, so the real
+		// one must find the planes that moved in the meantime afterwards.
+		savedheights.Resize(Level->sectors.Size() * 2);
+		for (unsigned i = 0; i < Level->sectors.Size(); i++)
+		{
+			savedheights[i * 2] = Level->sectors[i].vboheight[0][0];
+			savedheights[i * 2 + 1] = Level->sectors[i].vboheight[0][1];
+		}
+
+		nullscreen = new FNullFrameBuffer(realscreen);
+		screen = nullscreen;
+		nullscreen->InitializeState();
+
+		auto vd = screen->mVertexData;
+		vd->vbo_shadowdata = realscreen->mVertexData->vbo_shadowdata;
+		vd->ibo_data = realscreen->mVertexData->ibo_data;
+		vd->mNumReserved = realscreen->mVertexData->mNumReserved;
+		vd->mCurIndex = vd->mIndex = realscreen->mVertexData->mIndex;
+		vd->Copy(0, vd->mIndex);
+	}
+
+	// Move the player around for the path and put everything back afterwards.
+	const DVector3 savedpos = mo->Pos();
+	const DVector3 savedprev = mo->Prev;
+	const DRotator savedangles = mo->Angles;
+	const DRotator savedprevangles = mo->PrevAngles;
+	const double savedviewz = player->viewz;
+	AActor *savedcamera = player->camera;
+	const bool savedactive = glcycle_t::active;
+	const bool savedmultithread = gl_multithread;
+	const int savedworkers = gl_bspworkers;
+	player->camera = mo;
+	glcycle_t::active = true;
+
+	float fovratio;
+	float ratio = r_viewwindow.WidescreenRatio;
+	if (r_viewwindow.WidescreenRatio >= 1.3f)
+	{
+		fovratio = 1.333333f;
+	}
+	else
+	{
+		fovratio = ratio;
+	}
+	auto &RenderState = *nullscreen->RenderState();
+	const auto &eye = VRMode::GetVRMode(false)->mEyes[0];
+
+	const int numframes = keys.Size() == 1 ? perseg : (keys.Size() - 1) * perseg + 1;
+	const int numruns = maxworkers > 0 ? maxworkers : 1;
+	double sum[BT_COUNT], worst[BT_COUNT];
+	double basetime = 0;
+	int worstframe = 0;
+
+	for (int run = 0; run < numruns; run++)
+	{
+		if (maxworkers > 0)
+		{
+			gl_multithread = true;
+			gl_bspworkers = run + 1;
+		}
+		const int workers = !gl_multithread ? 0 : gl_bspworkers > 0 ? *gl_bspworkers : -1;
+		memset(sum, 0, sizeof(sum));
+		memset(worst, 0, sizeof(worst));
+		worstframe = 0;
+
+		// Frame -1 is not counted. It is there to set up what the first use of
+		// a texture or sector needs.
+		for (int frame = -1; frame < numframes; frame++)
+		{
+			const int seg = min(max(frame, 0) / perseg, (int)keys.Size() - 1);
+			const auto &from = keys[seg];
+			const auto &to = keys[min(seg + 1, (int)keys.Size() - 1)];
+			const double frac = double(max(frame, 0) - seg * perseg) / perseg;
+			const DVector3 pos = from.pos + (to.pos - from.pos) * frac;
+			mo->SetOrigin(DVector3(pos.XY(), pos.Z - (savedviewz - savedpos.Z)), false);
+			mo->Angles.Yaw = from.yaw + deltaangle(from.yaw, to.yaw) * frac;
+			mo->Angles.Pitch = from.pitch + (to.pitch - from.pitch) * frac;
+			mo->ClearInterpolation();
+			player->viewz = pos.Z;
+			r_NoInterpolate = true;
+
+			RenderState.SetVertexBuffer(screen->mVertexData);
+			screen->mVertexData->Reset();
+			hw_ClearFakeFlat();
+			ResetProfilingData();
+			RenderState.ResetCounters();
+			r_viewpoint.TicFrac = 1.;
+			screen->mLights->Clear();
+			screen->mBones->Clear();
+			screen->mViewpoints->Clear();
+
+			const uint64_t start = I_nsTime();
+			R_SetupFrame(r_viewpoint, r_viewwindow, mo);
+			screen->SetAABBTree(nullptr);
+			screen->mShadowMap.SetCollectLights(nullptr);
+			RenderState.SetPassType(NORMAL_PASS);
+
+			auto di = HWDrawInfo::StartDrawInfo(r_viewpoint.ViewLevel, nullptr, r_viewpoint, nullptr);
+			auto &vp = di->Viewpoint;
+			di->Set3DViewport(RenderState);
+			di->SetViewArea();
+			di->SetFullbrightFlags(player);
+			di->VPUniforms.mProjectionMatrix = eye.GetProjection(vp.FieldOfView.Degrees(), ratio, fovratio);
+			di->SetupView(RenderState, vp.Pos.X, vp.Pos.Y, vp.Pos.Z, false, false);
+			di->ProcessScene(true);
+			di->EndDrawInfo();
+			const double frametime = (I_nsTime() - start) * 1e-6;
+			if (frame < 0) continue;
+
+			double times[BT_COUNT];
+			times[BT_FRAME] = frametime;
+			times[BT_BSP] = Bsp.TimeMS();
+			times[BT_WALLS] = SetupWall.TimeMS();
+			times[BT_FLATS] = SetupFlat.TimeMS();
+			times[BT_SPRITES] = SetupSprite.TimeMS();
+			times[BT_PORTALS] = PortalAll.TimeMS();
+			times[BT_SORT] = SortAll.TimeMS();
+			times[BT_DRAW] = RenderAll.TimeMS();
+			times[BT_DRAWCALLS] = RenderState.DrawCalls;
+			for (int i = 0; i < BT_COUNT; i++)
+			{
+				sum[i] += times[i];
+				worst[i] = max(worst[i], times[i]);
+			}
+			if (frametime >= worst[BT_FRAME]) worstframe = frame;
+
+			if (csv != nullptr)
+			{
+				csv->Printf("%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f", workers, frame, pos.X, pos.Y, pos.Z, mo->Angles.Yaw.Degrees(), mo->Angles.Pitch.Degrees());
+				for (int i = 0; i < BT_DRAWCALLS; i++) csv->Printf(",%.3f", times[i]);
+				csv->Printf(",%d,%d\n", RenderState.DrawCalls, RenderState.Vertices);
+			}
+		}
+
+		if (maxworkers > 0)
+		{
+			const double frametime = sum[BT_FRAME] / numframes;
+			if (run == 0)
+			{
+				basetime = frametime;
+				Printf("workers  frame avg (ms)  worst (ms)  bsp avg (ms)  speedup\n");
+			}
+			Printf("%7d %15.3f %11.3f %13.3f %7.2fx\n", run + 1, frametime, worst[BT_FRAME], sum[BT_BSP] / numframes, frametime > 0 ? basetime / frametime : 0.);
+		}
+	}
+
+	if (nullscreen != activenull)
+	{
+		screen = realscreen;
+		delete nullscreen;
+		for (unsigned i = 0; i < Level->sectors.Size(); i++)
+		{
+			Level->sectors[i].vboheight[0][0] = savedheights[i * 2];
+			Level->sectors[i].vboheight[0][1] = savedheights[i * 2 + 1];
+		}
+	}
+
+	mo->SetOrigin(savedpos, false);
+	mo->Prev = savedprev;
+	mo->Angles = savedangles;
+	mo->PrevAngles = savedprevangles;
+	player->viewz = savedviewz;
+	player->camera = savedcamera;
+	glcycle_t::active = savedactive;
+	gl_multithread = savedmultithread;
+	gl_bspworkers = savedworkers;
+	r_NoInterpolate = true;
+	if (csv != nullptr) delete csv;
+
+	if (maxworkers > 0) return;
+
+	Printf("%d frames, worst is frame %d\n", numframes, worstframe);
+	for (int i = 0; i < BT_COUNT; i++)
+	{
+		if (i == BT_DRAWCALLS) Printf("%-9s average %8.1f     worst %8.0f\n", names[i], sum[i] / numframes, worst[i]);
+		else Printf("%-9s average %8.3f ms  worst %8.3f ms\n", names[i], sum[i] / numframes, worst[i]);
+	}
+}
@@ -48,6 +48,7 @@
 #endif // ARCH_IA32
 
 CVAR(Bool, gl_multithread, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, gl_bspworkers, 1, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// 0 = one per core, minus the one doing the traversal
 
 EXTERN_CVAR(Float, r_actorspriteshadowdist)
 
@@ -55,6 +56,34 @@ thread_local bool isWorkerThread;
 ctpl::thread_pool renderPool(1);
 bool inited = false;
 
+thread_local HWWorkerLists *HWDrawInfo::workerLists;
+thread_local int *HWDrawInfo::workerFlats;
+
+//==========================================================================
+//
+// Rules for the jobs that get run by the BSP worker threads
+//
+// - The main thread must prepare every fake sector a job needs before
+//   queuing it (see DoSubsector and AddLine), so that the workers only
+//   ever look them up. hw_FakeFlat asserts this through isWorkerThread.
+// - A worker may never call any GL API.
+// - Parallel jobs (walls, flats) only write to their worker's draw lists,
+//   render data allocator and vertex region. They can be run by any worker
+//   in any order.
+// - Ordered jobs (sprites, particles, portal coverage) depend on state that
+//   changes in processing order, e.g. the things' validcount, so they are
+//   all run by worker 0 in the order they were queued.
+// - Everything else that gets shared, like the portal list and the missing
+//   texture lists, may not be changed by a worker directly while there's more
+//   than one. Such calls get recorded with DeferSharedCall and are replayed by
+//   the main thread in queue order when the workers' lists are merged.
+//
+// With a single worker all jobs run on it in queue order, as they always did.
+// More job types can be moved off the main thread if they fit in one of
+// these two classes.
+//
+//==========================================================================
+
 struct RenderJob
 {
 	enum
@@ -64,32 +93,43 @@ struct RenderJob
 		SpriteJob,
 		ParticleJob,
 		PortalJob,
-		TerminateJob	// inserted when all work is done so that the worker can return.
 	};
 	
 	int type;
+	int seq;	// queue order, for merging the workers' output.
 	subsector_t *sub;
 	seg_t *seg;
+
+	bool IsOrdered() const
+	{
+		return type != FlatJob && type != WallJob;
+	}
 };
 
 
+template<int SIZE>
 class RenderJobQueue
 {
-	RenderJob pool[300000];	// Way more than ever needed. The largest ever seen on a single viewpoint is around 40000.
+	RenderJob pool[SIZE];
 	std::atomic<int> readindex{};
 	std::atomic<int> writeindex{};
 public:
-	void AddJob(int type, subsector_t *sub, seg_t *seg = nullptr)
+	void AddJob(const RenderJob &job)
 	{
 		// This does not check for array overflows. The pool should be large enough that it never hits the limit.
 
-		pool[writeindex] = { type, sub, seg };
+		pool[writeindex] = job;
 		writeindex++;	// update index only after the value has been written.
 	}
 
+	// May be called by several workers at once.
 	RenderJob *GetJob()
 	{
-		if (readindex < writeindex) return &pool[readindex++];
+		int index = readindex;
+		while (index < writeindex)
+		{
+			if (readindex.compare_exchange_weak(index, index + 1)) return &pool[index];
+		}
 		return nullptr;
 	}
 	
@@ -100,19 +140,198 @@ public:
 	}
 };
 
-static RenderJobQueue jobQueue;	// One static queue is sufficient here. This code will never be called recursively.
+// One static set of queues is sufficient here. This code will never be called recursively.
+static RenderJobQueue<300000> jobQueue;		// Way more than ever needed. The largest ever seen on a single viewpoint is around 40000.
+static RenderJobQueue<100000> orderedQueue;	// only used with more than one worker.
+static std::atomic<bool> jobsDone;
+static int jobSeq;
+
+//==========================================================================
+//
+// Per worker data
+//
+//==========================================================================
+
+enum
+{
+	MAX_BSP_WORKERS = 16,
+	NUM_WORKER_LISTS = GLDL_TYPES + 2,	// the draw lists and the two decal lists
+};
+
+// The items one job added to its worker's lists.
+struct WorkerSpan
+{
+	int seq;
+	int worker;
+	unsigned first[NUM_WORKER_LISTS];
+	unsigned last[NUM_WORKER_LISTS];
+	unsigned firstcall, lastcall;	// the shared calls the job made
+};
 
-void HWDrawInfo::WorkerThread()
+struct BSPWorker
 {
-	sector_t *front, *back;
+	HWWorkerLists lists;
+	TArray<WorkerSpan> spans;
+	glcycle_t total, wall, flat;
+	int lines, flats;
+};
+
+static BSPWorker bspWorkers[MAX_BSP_WORKERS];
+static int numWorkers = 1;
+
+static int GetBSPWorkerCount()
+{
+	int count = gl_bspworkers > 0 ? *gl_bspworkers : (int)std::thread::hardware_concurrency() - 1;
+	return clamp(count, 1, (int)MAX_BSP_WORKERS);
+}
+
+static void GetListSizes(HWWorkerLists &lists, unsigned *sizes)
+{
+	for (int i = 0; i < GLDL_TYPES; i++) sizes[i] = lists.drawlists[i].Size();
+	sizes[GLDL_TYPES] = lists.Decals[0].Size();
+	sizes[GLDL_TYPES + 1] = lists.Decals[1].Size();
+}
+
+static void AppendWorkerItems(HWDrawInfo *di, HWWorkerLists &lists, unsigned *pos, const unsigned *end)
+{
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		if (pos[i] < end[i]) di->drawlists[i].AppendItems(lists.drawlists[i], pos[i], end[i]);
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		for (unsigned j = pos[GLDL_TYPES + i]; j < end[GLDL_TYPES + i]; j++)
+		{
+			di->Decals[i].Push(lists.Decals[i][j]);
+		}
+	}
+	memcpy(pos, end, sizeof(unsigned) * NUM_WORKER_LISTS);
+}
+
+static void QueueJob(int type, subsector_t *sub, seg_t *seg = nullptr)
+{
+	RenderJob job = { type, jobSeq++, sub, seg };
+	if (numWorkers > 1 && job.IsOrdered()) orderedQueue.AddJob(job);
+	else jobQueue.AddJob(job);
+}
+
+//==========================================================================
+//
+// Appends everything the workers produced to the draw info's lists,
+// in the order the jobs were queued. This makes the result the same
+// as with one worker, no matter which worker ran which job.
+//
+//==========================================================================
+
+static void MergeWorkerLists(HWDrawInfo *di, int count)
+{
+	static TArray<WorkerSpan *> spans;
+
+	spans.Clear();
+	for (int i = 0; i < count; i++)
+	{
+		for (auto &span : bspWorkers[i].spans) spans.Push(&span);
+	}
+	std::sort(spans.begin(), spans.end(), [](WorkerSpan *a, WorkerSpan *b) { return a->seq < b->seq; });
 
-	WTTotal.Clock();
+	for (auto span : spans)
+	{
+		auto &lists = bspWorkers[span->worker].lists;
+		unsigned pos[NUM_WORKER_LISTS];
+
+		// A shared call goes between the items the job added before and after making it.
+		memcpy(pos, span->first, sizeof(pos));
+		for (unsigned i = span->firstcall; i < span->lastcall; i++)
+		{
+			auto &call = lists.SharedCalls[i];
+			AppendWorkerItems(di, lists, pos, call.listsizes);
+			di->ReplaySharedCall(call);
+		}
+		AppendWorkerItems(di, lists, pos, span->last);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		auto &worker = bspWorkers[i];
+		for (auto &list : worker.lists.drawlists) list.Reset();
+		worker.lists.Decals[0].Clear();
+		worker.lists.Decals[1].Clear();
+		worker.lists.SharedCalls.Clear();
+		worker.spans.Clear();
+	}
+}
+
+//==========================================================================
+//
+// Shared calls made by a worker while there's more than one
+//
+//==========================================================================
+
+void HWDrawInfo::DeferSharedCall(HWSharedCall &call)
+{
+	GetListSizes(*workerLists, call.listsizes);
+	workerLists->SharedCalls.Push(call);
+}
+
+void HWDrawInfo::ReplaySharedCall(const HWSharedCall &call)
+{
+	switch (call.type)
+	{
+	case HWSharedCall::PutPortal:
+		call.wall->AddToPortal(this, call.ptype, call.plane);
+		break;
+
+	case HWSharedCall::UpperMissingTexture:
+		AddUpperMissingTexture(call.side, call.sub, call.backheight);
+		break;
+
+	case HWSharedCall::LowerMissingTexture:
+		AddLowerMissingTexture(call.side, call.sub, call.backheight);
+		break;
+
+	case HWSharedCall::SubsectorToPortal:
+		AddSubsectorToPortal(call.portalgroup, call.sub);
+		break;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void HWDrawInfo::WorkerThread(int index)
+{
+	sector_t *front, *back;
+	auto &worker = bspWorkers[index];
+	const bool shared = numWorkers > 1;
+
+	worker.total.Reset();
+	worker.wall.Reset();
+	worker.flat.Reset();
+	worker.lines = 0;
+	worker.flats = 0;
+	worker.total.Clock();
 	isWorkerThread = true;	// for adding asserts in GL API code. The worker thread may never call any GL API.
+	workerFlats = &worker.flats;
+	if (shared)
+	{
+		workerLists = &worker.lists;
+		UseWorkerDataAllocator(index);
+		screen->mVertexData->BeginThreadRegion();
+	}
 	while (true)
 	{
-		auto job = jobQueue.GetJob();
+		// This must be read before looking at the queues. If it was set, all jobs have been queued,
+		// so once both queues are empty, there's nothing left to do.
+		bool done = jobsDone;
+		RenderJob *job = nullptr;
+		if (shared && index == 0) job = orderedQueue.GetJob();
+		if (job == nullptr) job = jobQueue.GetJob();
 		if (job == nullptr)
 		{
+			if (done) break;
 #ifdef ARCH_IA32
 			// The queue is empty. But yielding would be too costly here and possibly cause further delays down the line if the thread is halted.
 			// So instead add a few pause instructions and retry immediately.
@@ -127,19 +346,24 @@ void HWDrawInfo::WorkerThread()
 			_mm_pause();
 			_mm_pause();
 #endif // ARCH_IA32
+			continue;
+		}
+
+		WorkerSpan span;
+		if (shared)
+		{
+			GetListSizes(worker.lists, span.first);
+			span.firstcall = worker.lists.SharedCalls.Size();
 		}
+
 		// Note that the main thread MUST have prepared the fake sectors that get used below!
 		// This worker thread cannot prepare them itself without costly synchronization.
-		else switch (job->type)
+		switch (job->type)
 		{
-		case RenderJob::TerminateJob:
-			WTTotal.Unclock();
-			return;
-
 		case RenderJob::WallJob:
 		{
 			HWWall wall;
-			SetupWall.Clock();
+			worker.wall.Clock();
 			wall.sub = job->sub;
 
 			front = hw_FakeFlat(job->sub->sector, in_area, false);
@@ -170,28 +394,30 @@ void HWDrawInfo::WorkerThread()
 			else back = nullptr;
 
 			wall.Process(this, job->seg, front, back);
-			rendered_lines++;
-			SetupWall.Unclock();
+			worker.lines++;
+			worker.wall.Unclock();
 			break;
 		}
 
 		case RenderJob::FlatJob:
 		{
 			HWFlat flat;
-			SetupFlat.Clock();
+			worker.flat.Clock();
 			flat.section = job->sub->section;
 			front = hw_FakeFlat(job->sub->render_sector, in_area, false);
 			flat.ProcessSector(this, front);
-			SetupFlat.Unclock();
+			worker.flat.Unclock();
 			break;
 		}
 
 		case RenderJob::SpriteJob:
+		{
 			SetupSprite.Clock();
 			front = hw_FakeFlat(job->sub->sector, in_area, false);
 			RenderThings(job->sub, front);
 			SetupSprite.Unclock();
 			break;
+		}
 
 		case RenderJob::ParticleJob:
 			SetupSprite.Clock();
@@ -205,7 +431,26 @@ void HWDrawInfo::WorkerThread()
 			break;
 		}
 
+		if (shared)
+		{
+			GetListSizes(worker.lists, span.last);
+			span.lastcall = worker.lists.SharedCalls.Size();
+			if (memcmp(span.first, span.last, sizeof(span.first)) || span.firstcall != span.lastcall)
+			{
+				span.seq = job->seq;
+				span.worker = index;
+				worker.spans.Push(span);
+			}
+		}
 	}
+	if (shared)
+	{
+		screen->mVertexData->EndThreadRegion();
+		UseWorkerDataAllocator(-1);
+		workerLists = nullptr;
+	}
+	workerFlats = nullptr;
+	worker.total.Unclock();
 }
 
 
@@ -343,7 +588,7 @@ void HWDrawInfo::AddLine (seg_t *seg, bool portalclip)
 		{
 			if (multithread)
 			{
-				jobQueue.AddJob(RenderJob::WallJob, seg->Subsector, seg);
+				QueueJob(RenderJob::WallJob, seg->Subsector, seg);
 			}
 			else
 			{
@@ -594,7 +839,7 @@ void HWDrawInfo::RenderThings(subsector_t * sub, sector_t * sector)
 void HWDrawInfo::RenderParticles(subsector_t *sub, sector_t *front)
 {
 	SetupSprite.Clock();
-	for (int i = Level->ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = Level->Particles[i].snext)
+	for (uint32_t i = Level->ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = Level->Particles[i].snext)
 	{
 		if (mClipPortal)
 		{
@@ -670,7 +915,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 	{
 		if (multithread)
 		{
-			jobQueue.AddJob(RenderJob::ParticleJob, sub, nullptr);
+			QueueJob(RenderJob::ParticleJob, sub);
 		}
 		else
 		{
@@ -696,7 +941,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 		{
 			if (multithread)
 			{
-				jobQueue.AddJob(RenderJob::SpriteJob, sub, nullptr);
+				QueueJob(RenderJob::SpriteJob, sub);
 			}
 			else
 			{
@@ -733,7 +978,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 
 					if (multithread)
 					{
-						jobQueue.AddJob(RenderJob::FlatJob, sub);
+						QueueJob(RenderJob::FlatJob, sub);
 					}
 					else
 					{
@@ -762,7 +1007,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 				{
 					if (multithread)
 					{
-						jobQueue.AddJob(RenderJob::PortalJob, sub, (seg_t *)portal);
+						QueueJob(RenderJob::PortalJob, sub, (seg_t *)portal);
 					}
 					else
 					{
@@ -775,7 +1020,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 				{
 					if (multithread)
 					{
-						jobQueue.AddJob(RenderJob::PortalJob, sub, (seg_t *)portal);
+						QueueJob(RenderJob::PortalJob, sub, (seg_t *)portal);
 					}
 					else
 					{
@@ -844,16 +1089,37 @@ void HWDrawInfo::RenderBSP(void *node, bool drawpsprites)
 	multithread = gl_multithread;
 	if (multithread)
 	{
+		std::future<void> futures[MAX_BSP_WORKERS];
+
+		numWorkers = GetBSPWorkerCount();
 		jobQueue.ReleaseAll();
-		auto future = renderPool.push([&](int id) {
-			WorkerThread();
-		});
+		orderedQueue.ReleaseAll();
+		jobsDone = false;
+		jobSeq = 0;
+		if (numWorkers > 1) SetupWorkerDataAllocators(numWorkers);
+		if (renderPool.size() != numWorkers) renderPool.resize(numWorkers);
+		for (int i = 0; i < numWorkers; i++)
+		{
+			futures[i] = renderPool.push([=](int id) {
+				WorkerThread(i);
+			});
+		}
 		RenderBSPNode(node);
 
-		jobQueue.AddJob(RenderJob::TerminateJob, nullptr, nullptr);
+		jobsDone = true;
 		Bsp.Unclock();
 		MTWait.Clock();
-		future.wait();
+		for (int i = 0; i < numWorkers; i++)
+		{
+			futures[i].wait();
+			auto &worker = bspWorkers[i];
+			WTTotal += worker.total;
+			SetupWall += worker.wall;
+			SetupFlat += worker.flat;
+			rendered_lines += worker.lines;
+			rendered_flats += worker.flats;
+		}
+		if (numWorkers > 1) MergeWorkerLists(this, numWorkers);
 		MTWait.Unclock();
 	}
 	else
@@ -38,21 +38,469 @@
 #include "hw_clipper.h"
 #include "g_levellocals.h"
 #include "basics.h"
+#include "memarena.h"
+#include "c_dispatch.h"
+#include "i_time.h"
 
 unsigned Clipper::starttime;
 
+// clipbench recording state. The recording covers whole scenes, i.e.
+// it starts and ends with a call to Clear.
+static TArray<FClipOp> RecordedOps;
+static FString RecordFile;
+static int RecordScenes;	// scenes still to record, 0 if not recording.
+static bool Recording;
+
+static void RecordOp(uint32_t type, angle_t start = 0, angle_t end = 0)
+{
+	if (Recording) RecordedOps.Push({ type, start, end });
+}
+
 Clipper::Clipper()
 {
 	starttime++;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Returns the index of the first range for which pred is false.
+// pred must be true for some prefix of the array and false for the rest.
+//
+//-----------------------------------------------------------------------------
+
+template<class Pred>
+static unsigned FindRange(const TArray<ClipRange> &ranges, Pred pred)
+{
+	unsigned lo = 0, hi = ranges.Size();
+	while (lo < hi)
+	{
+		unsigned mid = (lo + hi) / 2;
+		if (pred(ranges[mid])) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Clear
+//
+//-----------------------------------------------------------------------------
+
+void Clipper::Clear()
+{
+	blocked = false;
+	ranges.Clear();
+	silhouette.Clear();
+	starttime++;
+
+	if (RecordScenes > 0)
+	{
+		if (!Recording)
+		{
+			Recording = true;
+		}
+		else if (--RecordScenes == 0)
+		{
+			Recording = false;
+			auto fw = FileWriter::Open(RecordFile);
+			if (fw != nullptr)
+			{
+				fw->Write(RecordedOps.Data(), RecordedOps.Size() * sizeof(FClipOp));
+				delete fw;
+				Printf("Recorded %u clipper operations to %s\n", RecordedOps.Size(), RecordFile.GetChars());
+			}
+			else
+			{
+				Printf("Could not write %s\n", RecordFile.GetChars());
+			}
+			RecordedOps.Reset();
+		}
+	}
+	RecordOp(FClipOp::Clear);
+}
+
+//-----------------------------------------------------------------------------
+//
+// SetSilhouette
+//
+//-----------------------------------------------------------------------------
+
+void Clipper::SetSilhouette()
+{
+	RecordOp(FClipOp::Silhouette);
+	// Only the first silhouette after a Clear counts.
+	if (silhouette.Size() == 0) silhouette = ranges;
+}
+
+//-----------------------------------------------------------------------------
+//
+// IsRangeVisible
+//
+//-----------------------------------------------------------------------------
+
+bool Clipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
+{
+	bool visible;
+
+	if (endAngle == 0)
+	{
+		visible = ranges.Size() == 0 || ranges[0].start != 0;
+	}
+	else
+	{
+		// Only ranges that start before endAngle count. Of those, only the last
+		// one that starts at or before startAngle can cover the whole range,
+		// because all others end before it starts.
+		const angle_t limit = min(startAngle, endAngle - 1);
+		const unsigned index = FindRange(ranges, [=](const ClipRange &r) { return r.start <= limit; });
+		visible = index == 0 || ranges[index - 1].end < endAngle;
+	}
+	RecordOp(visible ? FClipOp::Visible : FClipOp::Hidden, startAngle, endAngle);
+	return visible;
+}
+
+//-----------------------------------------------------------------------------
+//
+// AddClipRange
+//
+//-----------------------------------------------------------------------------
+
+void Clipper::AddClipRange(angle_t start, angle_t end)
+{
+	RecordOp(FClipOp::Add, start, end);
+
+	// Ranges that end before this one starts are not affected.
+	const unsigned first = FindRange(ranges, [=](const ClipRange &r) { return r.end < start; });
+
+	//check to see if range contains any old ranges
+	unsigned i = first;
+	while (i < ranges.Size() && ranges[i].start < end)
+	{
+		if (ranges[i].start >= start && ranges[i].end <= end)
+		{
+			ranges.Delete(i);
+		}
+		else if (ranges[i].start <= start && ranges[i].end >= end)
+		{
+			return;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	//check to see if range overlaps a range (or possibly 2)
+	if (first < ranges.Size() && ranges[first].start <= end)
+	{
+		auto &range = ranges[first];
+		if (range.start > start) range.start = start;
+		if (range.end < end) range.end = end;
+
+		unsigned last = first + 1;
+		while (last < ranges.Size() && ranges[last].start <= range.end)
+		{
+			if (ranges[last].end > range.end) range.end = ranges[last].end;
+			last++;
+		}
+		ranges.Delete(first + 1, last - first - 1);
+		return;
+	}
+
+	//just add range
+	ranges.Insert(first, { start, end });
+}
+
+
+//-----------------------------------------------------------------------------
+//
+// RemoveClipRange
+//
+//-----------------------------------------------------------------------------
+
+void Clipper::RemoveClipRange(angle_t start, angle_t end)
+{
+	RecordOp(FClipOp::Remove, start, end);
+
+	if (silhouette.Size() > 0)
+	{
+		unsigned i = FindRange(silhouette, [=](const ClipRange &r) { return r.end <= start; });
+		if (i < silhouette.Size() && silhouette[i].start <= start)
+		{
+			if (silhouette[i].end >= end) return;
+			start = silhouette[i].end;
+			i++;
+		}
+		while (i < silhouette.Size() && silhouette[i].start < end)
+		{
+			DoRemoveClipRange(start, silhouette[i].start);
+			start = silhouette[i].end;
+			i++;
+		}
+		if (start >= end) return;
+	}
+	DoRemoveClipRange(start, end);
+}
+	
+//-----------------------------------------------------------------------------
+//
+// RemoveClipRange worker function
+//
+//-----------------------------------------------------------------------------
+
+void Clipper::DoRemoveClipRange(angle_t start, angle_t end)
+{
+	// Ranges that end before this one starts are not affected.
+	const unsigned first = FindRange(ranges, [=](const ClipRange &r) { return r.end < start; });
+
+	//check to see if range contains any old ranges
+	unsigned i = first;
+	while (i < ranges.Size() && ranges[i].start < end)
+	{
+		if (ranges[i].start >= start && ranges[i].end <= end)
+		{
+			ranges.Delete(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	//check to see if range overlaps a range (or possibly 2)
+	for (i = first; i < ranges.Size() && ranges[i].start <= end; i++)
+	{
+		auto &range = ranges[i];
+		if (range.start >= start)
+		{
+			range.start = end;
+			break;
+		}
+		else if (range.end >= start && range.end <= end)
+		{
+			range.end = start;
+		}
+		else if (range.end > end)
+		{
+			const ClipRange split = { end, range.end };
+			range.end = start;
+			ranges.Insert(i + 1, split);
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//
+// Replays one recorded operation. Returns false if a range check
+// does not give the recorded result.
+//
+//-----------------------------------------------------------------------------
+
+bool Clipper::Replay(const FClipOp &op)
+{
+	switch (op.type)
+	{
+	case FClipOp::Clear:
+		ranges.Clear();
+		silhouette.Clear();
+		break;
+
+	case FClipOp::Silhouette:
+		if (silhouette.Size() == 0) silhouette = ranges;
+		break;
+
+	case FClipOp::Add:
+		AddClipRange(op.start, op.end);
+		break;
+
+	case FClipOp::Remove:
+		RemoveClipRange(op.start, op.end);
+		break;
+
+	case FClipOp::Visible:
+	case FClipOp::Hidden:
+		return IsRangeVisible(op.start, op.end) == (op.type == FClipOp::Visible);
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+//
+// 
+//
+//-----------------------------------------------------------------------------
+
+angle_t Clipper::AngleToPseudo(angle_t ang)
+{
+	double vecx = cos(ang * M_PI / ANGLE_180);
+	double vecy = sin(ang * M_PI / ANGLE_180);
+
+	double result = vecy / (fabs(vecx) + fabs(vecy));
+	if (vecx < 0)
+	{
+		result = 2.f - result;
+	}
+	return xs_Fix<30>::ToFix(result);
+}
+
+//-----------------------------------------------------------------------------
+//
+// ! Returns the pseudoangle between the line p1 to (infinity, p1.y) and the 
+// line from p1 to p2. The pseudoangle has the property that the ordering of 
+// points by true angle around p1 and ordering of points by pseudoangle are the 
+// same.
+//
+// For clipping exact angles are not needed. Only the ordering matters.
+// This is about as fast as the fixed point R_PointToAngle2 but without
+// the precision issues associated with that function.
+//
+//-----------------------------------------------------------------------------
+
+angle_t Clipper::PointToPseudoAngle(double x, double y)
+{
+	double vecx = x - viewpoint->Pos.X;
+	double vecy = y - viewpoint->Pos.Y;
+
+	if (vecx == 0 && vecy == 0)
+	{
+		return 0;
+	}
+	else
+	{
+		double result = vecy / (fabs(vecx) + fabs(vecy));
+		if (vecx < 0)
+		{
+			result = 2. - result;
+		}
+		return xs_Fix<30>::ToFix(result);
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+//
+// R_CheckBBox
+// Checks BSP node/subtree bounding box.
+// Returns true
+//  if some part of the bbox might be visible.
+//
+//-----------------------------------------------------------------------------
+	static const uint8_t checkcoord[12][4] = // killough -- static const
+	{
+	  {3,0,2,1},
+	  {3,0,2,0},
+	  {3,1,2,0},
+	  {0},
+	  {2,0,2,1},
+	  {0,0,0,0},
+	  {3,1,3,0},
+	  {0},
+	  {2,0,3,1},
+	  {2,1,3,1},
+	  {2,1,3,0}
+	};
+
+bool Clipper::CheckBox(const float *bspcoord) 
+{
+	angle_t angle1, angle2;
+
+	int        boxpos;
+	const uint8_t* check;
+	
+	// Find the corners of the box
+	// that define the edges from current viewpoint.
+    auto &vp = viewpoint;
+	boxpos = (vp->Pos.X <= bspcoord[BOXLEFT] ? 0 : vp->Pos.X < bspcoord[BOXRIGHT ] ? 1 : 2) +
+		(vp->Pos.Y >= bspcoord[BOXTOP ] ? 0 : vp->Pos.Y > bspcoord[BOXBOTTOM] ? 4 : 8);
+	
+	if (boxpos == 5) return true;
+	
+	check = checkcoord[boxpos];
+	angle1 = PointToPseudoAngle (bspcoord[check[0]], bspcoord[check[1]]);
+	angle2 = PointToPseudoAngle (bspcoord[check[2]], bspcoord[check[3]]);
+	
+	return SafeCheckRange(angle2, angle1);
+}
+
+
+//-----------------------------------------------------------------------------
+//
+// The clipper as it was before it kept its ranges in a sorted array.
+// clipbench uses it as the reference for times and results.
+//
+//-----------------------------------------------------------------------------
+
+struct ListClipNode
+{
+	ListClipNode *prev, *next;
+	angle_t start, end;
+};
+
+class FListClipper
+{
+	FMemArena nodearena;
+	ListClipNode * freelist = nullptr;
+	ListClipNode * cliphead = nullptr;
+	ListClipNode * silhouette = nullptr;
+
+	void Free(ListClipNode *node)
+	{
+		node->next = freelist;
+		freelist = node;
+	}
+
+	ListClipNode * NewRange(angle_t start, angle_t end)
+	{
+		ListClipNode * c;
+		if (freelist)
+		{
+			c = freelist;
+			freelist = c->next;
+		}
+		else c = (ListClipNode*)nodearena.Alloc(sizeof(ListClipNode));
+
+		c->start = start;
+		c->end = end;
+		c->next = c->prev = NULL;
+		return c;
+	}
+
+	void RemoveRange(ListClipNode * cn);
+	void DoRemoveClipRange(angle_t start, angle_t end);
+
+public:
+	void Clear();
+	void SetSilhouette();
+	bool IsRangeVisible(angle_t startangle, angle_t endangle);
+	void AddClipRange(angle_t startangle, angle_t endangle);
+	void RemoveClipRange(angle_t startangle, angle_t endangle);
+
+	bool Replay(const FClipOp &op)
+	{
+		switch (op.type)
+		{
+		case FClipOp::Clear: Clear(); break;
+		case FClipOp::Silhouette: SetSilhouette(); break;
+		case FClipOp::Add: AddClipRange(op.start, op.end); break;
+		case FClipOp::Remove: RemoveClipRange(op.start, op.end); break;
+		case FClipOp::Visible:
+		case FClipOp::Hidden: return IsRangeVisible(op.start, op.end) == (op.type == FClipOp::Visible);
+		}
+		return true;
+	}
+};
+
 //-----------------------------------------------------------------------------
 //
 // RemoveRange
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::RemoveRange(ClipNode * range)
+void FListClipper::RemoveRange(ListClipNode * range)
 {
 	if (range == cliphead)
 	{
@@ -73,12 +521,11 @@ void Clipper::RemoveRange(ClipNode * range)
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::Clear()
+void FListClipper::Clear()
 {
-	ClipNode *node = cliphead;
-	ClipNode *temp;
+	ListClipNode *node = cliphead;
+	ListClipNode *temp;
 	
-	blocked = false;
 	while (node != NULL)
 	{
 		temp = node;
@@ -96,7 +543,6 @@ void Clipper::Clear()
 	
 	cliphead = NULL;
 	silhouette = NULL;
-	starttime++;
 }
 
 //-----------------------------------------------------------------------------
@@ -105,14 +551,14 @@ void Clipper::Clear()
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::SetSilhouette()
+void FListClipper::SetSilhouette()
 {
-	ClipNode *node = cliphead;
-	ClipNode *last = NULL;
+	ListClipNode *node = cliphead;
+	ListClipNode *last = NULL;
 
 	while (node != NULL)
 	{
-		ClipNode *snode = NewRange(node->start, node->end);
+		ListClipNode *snode = NewRange(node->start, node->end);
 		if (silhouette == NULL) silhouette = snode;
 		snode->prev = last;
 		if (last != NULL) last->next = snode;
@@ -127,9 +573,9 @@ void Clipper::SetSilhouette()
 //
 //-----------------------------------------------------------------------------
 
-bool Clipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
+bool FListClipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
 {
-	ClipNode *ci;
+	ListClipNode *ci;
 	ci = cliphead;
 	
 	if (endAngle==0 && ci && ci->start==0) return false;
@@ -152,9 +598,9 @@ bool Clipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::AddClipRange(angle_t start, angle_t end)
+void FListClipper::AddClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node, *temp, *prevNode;
+	ListClipNode *node, *temp, *prevNode;
 
 	if (cliphead)
 	{
@@ -196,11 +642,11 @@ void Clipper::AddClipRange(angle_t start, angle_t end)
 					node->end = end;
 				}
 
-				ClipNode *node2 = node->next;
+				ListClipNode *node2 = node->next;
 				while (node2 && node2->start <= node->end)
 				{
 					if (node2->end > node->end) node->end = node2->end;
-					ClipNode *delnode = node2;
+					ListClipNode *delnode = node2;
 					node2 = node2->next;
 					RemoveRange(delnode);
 				}
@@ -257,9 +703,9 @@ void Clipper::AddClipRange(angle_t start, angle_t end)
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::RemoveClipRange(angle_t start, angle_t end)
+void FListClipper::RemoveClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node;
+	ListClipNode *node;
 
 	if (silhouette)
 	{
@@ -287,13 +733,13 @@ void Clipper::RemoveClipRange(angle_t start, angle_t end)
 	
 //-----------------------------------------------------------------------------
 //
-// RemoveClipRange worker function
+// DoRemoveClipRange
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::DoRemoveClipRange(angle_t start, angle_t end)
+void FListClipper::DoRemoveClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node, *temp;
+	ListClipNode *node, *temp;
 
 	if (cliphead)
 	{
@@ -344,100 +790,93 @@ void Clipper::DoRemoveClipRange(angle_t start, angle_t end)
 
 //-----------------------------------------------------------------------------
 //
-// 
-//
-//-----------------------------------------------------------------------------
-
-angle_t Clipper::AngleToPseudo(angle_t ang)
-{
-	double vecx = cos(ang * M_PI / ANGLE_180);
-	double vecy = sin(ang * M_PI / ANGLE_180);
-
-	double result = vecy / (fabs(vecx) + fabs(vecy));
-	if (vecx < 0)
-	{
-		result = 2.f - result;
-	}
-	return xs_Fix<30>::ToFix(result);
-}
-
-//-----------------------------------------------------------------------------
+// CCMD clipbench
 //
-// ! Returns the pseudoangle between the line p1 to (infinity, p1.y) and the 
-// line from p1 to p2. The pseudoangle has the property that the ordering of 
-// points by true angle around p1 and ordering of points by pseudoangle are the 
-// same.
+// clipbench record <file> [scenes]
+// Records what the clipper does in the next scenes that get rendered
+// (default 100). Every view and every portal is a scene of its own.
 //
-// For clipping exact angles are not needed. Only the ordering matters.
-// This is about as fast as the fixed point R_PointToAngle2 but without
-// the precision issues associated with that function.
+// clipbench <file> [repeats]
+// Replays a recording with the clipper and with the linked list clipper
+// above, prints the times of both and checks that every range check
+// still gives the recorded result.
 //
 //-----------------------------------------------------------------------------
 
-angle_t Clipper::PointToPseudoAngle(double x, double y)
+CCMD(clipbench)
 {
-	double vecx = x - viewpoint->Pos.X;
-	double vecy = y - viewpoint->Pos.Y;
-
-	if (vecx == 0 && vecy == 0)
+	if (argv.argc() < 2)
 	{
-		return 0;
+		Printf("Usage: clipbench record <file> [scenes]\n       clipbench <file> [repeats]\n");
+		return;
 	}
-	else
+	if (!stricmp(argv[1], "record"))
 	{
-		double result = vecy / (fabs(vecx) + fabs(vecy));
-		if (vecx < 0)
+		if (argv.argc() < 3)
 		{
-			result = 2. - result;
+			Printf("No file name given\n");
+			return;
 		}
-		return xs_Fix<30>::ToFix(result);
+		RecordFile = argv[2];
+		RecordScenes = argv.argc() > 3 ? clamp(atoi(argv[3]), 1, 100000) : 100;
+		Recording = false;
+		RecordedOps.Clear();
+		return;
+	}
+	if (RecordScenes > 0)
+	{
+		Printf("clipbench cannot replay while recording\n");
+		return;
 	}
-}
 
+	FileReader fr;
+	if (!fr.OpenFile(argv[1]))
+	{
+		Printf("Could not open %s\n", argv[1]);
+		return;
+	}
+	const int repeats = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 10000) : 10;
+	TArray<FClipOp> ops((unsigned)(fr.GetLength() / sizeof(FClipOp)), true);
+	if (ops.Size() == 0 || fr.Read(ops.Data(), ops.Size() * sizeof(FClipOp)) != (long)(ops.Size() * sizeof(FClipOp)))
+	{
+		Printf("%s is not a clipper recording\n", argv[1]);
+		return;
+	}
 
+	unsigned scenes = 0, checks = 0;
+	for (auto &op : ops)
+	{
+		if (op.type == FClipOp::Clear) scenes++;
+		else if (op.type == FClipOp::Visible || op.type == FClipOp::Hidden) checks++;
+	}
 
-//-----------------------------------------------------------------------------
-//
-// R_CheckBBox
-// Checks BSP node/subtree bounding box.
-// Returns true
-//  if some part of the bbox might be visible.
-//
-//-----------------------------------------------------------------------------
-	static const uint8_t checkcoord[12][4] = // killough -- static const
+	Clipper clipper;
+	FListClipper listclipper;
+	uint64_t time = 0, listtime = 0;
+	int mismatches = 0, listmismatches = 0;
+	for (int r = 0; r < repeats; r++)
 	{
-	  {3,0,2,1},
-	  {3,0,2,0},
-	  {3,1,2,0},
-	  {0},
-	  {2,0,2,1},
-	  {0,0,0,0},
-	  {3,1,3,0},
-	  {0},
-	  {2,0,3,1},
-	  {2,1,3,1},
-	  {2,1,3,0}
-	};
+		uint64_t start = I_nsTime();
+		for (auto &op : ops)
+		{
+			if (!clipper.Replay(op)) mismatches++;
+		}
+		time += I_nsTime() - start;
 
-bool Clipper::CheckBox(const float *bspcoord) 
-{
-	angle_t angle1, angle2;
+		start = I_nsTime();
+		for (auto &op : ops)
+		{
+			if (!listclipper.Replay(op)) listmismatches++;
+		}
+		listtime += I_nsTime() - start;
+	}
 
-	int        boxpos;
-	const uint8_t* check;
-	
-	// Find the corners of the box
-	// that define the edges from current viewpoint.
-    auto &vp = viewpoint;
-	boxpos = (vp->Pos.X <= bspcoord[BOXLEFT] ? 0 : vp->Pos.X < bspcoord[BOXRIGHT ] ? 1 : 2) +
-		(vp->Pos.Y >= bspcoord[BOXTOP ] ? 0 : vp->Pos.Y > bspcoord[BOXBOTTOM] ? 4 : 8);
-	
-	if (boxpos == 5) return true;
-	
-	check = checkcoord[boxpos];
-	angle1 = PointToPseudoAngle (bspcoord[check[0]], bspcoord[check[1]]);
-	angle2 = PointToPseudoAngle (bspcoord[check[2]], bspcoord[check[3]]);
-	
-	return SafeCheckRange(angle2, angle1);
+	Printf("%u operations in %u scenes, %u range checks\n", ops.Size(), scenes, checks);
+	Printf("sorted array: %.3f ms per replay\n", time * 1e-6 / repeats);
+	Printf("linked list:  %.3f ms per replay\n", listtime * 1e-6 / repeats);
+	if (time > 0) Printf("speedup %.2fx\n", double(listtime) / time);
+	if (mismatches > 0 || listmismatches > 0)
+	{
+		Printf(TEXTCOLOR_RED "%d range checks differ from the recording, %d with the linked list\n", mismatches / repeats, listmismatches / repeats);
+	}
 }
-
@@ -4,37 +4,45 @@
 #include "doomtype.h"
 #include "xs_Float.h"
 #include "r_utility.h"
-#include "memarena.h"
+#include "tarray.h"
 
-class ClipNode
+// A range of pseudo angles that is occluded.
+struct ClipRange
 {
-	friend class Clipper;
-	
-	ClipNode *prev, *next;
 	angle_t start, end;
+};
 
-	bool operator== (const ClipNode &other)
+// One clipper operation, as recorded and replayed by clipbench.
+struct FClipOp
+{
+	enum
 	{
-		return other.start == start && other.end == end;
-	}
+		Clear,
+		Silhouette,
+		Add,
+		Remove,
+		Visible,	// a range check and its result
+		Hidden,
+	};
+
+	uint32_t type;
+	angle_t start, end;
 };
 
 
 class Clipper
 {
 	static unsigned starttime;
-	FMemArena nodearena;
-	ClipNode * freelist = nullptr;
 
-	ClipNode * clipnodes = nullptr;
-	ClipNode * cliphead = nullptr;
-	ClipNode * silhouette = nullptr;	// will be preserved even when RemoveClipRange is called
+	// Sorted by start. A range may touch the next one but never overlaps it,
+	// so the ends are sorted as well and both can be binary searched.
+	TArray<ClipRange> ranges;
+	TArray<ClipRange> silhouette;	// will be preserved even when RemoveClipRange is called
     const FRenderViewpoint *viewpoint = nullptr;
 	bool blocked = false;
 
 	static angle_t AngleToPseudo(angle_t ang);
 	bool IsRangeVisible(angle_t startangle, angle_t endangle);
-	void RemoveRange(ClipNode * cn);
 	void AddClipRange(angle_t startangle, angle_t endangle);
 	void RemoveClipRange(angle_t startangle, angle_t endangle);
 	void DoRemoveClipRange(angle_t start, angle_t end);
@@ -44,33 +52,7 @@ public:
 	Clipper();
 
 	void Clear();
-
-	void Free(ClipNode *node)
-	{
-		node->next = freelist;
-		freelist = node;
-	}
-
-	ClipNode * GetNew()
-	{
-		if (freelist)
-		{
-			ClipNode * p = freelist;
-			freelist = p->next;
-			return p;
-		}
-		else return (ClipNode*)nodearena.Alloc(sizeof(ClipNode));
-	}
-
-	ClipNode * NewRange(angle_t start, angle_t end)
-	{
-		ClipNode * c = GetNew();
-
-		c->start = start;
-		c->end = end;
-		c->next = c->prev = NULL;
-		return c;
-	}
+	bool Replay(const FClipOp &op);
     
     void SetViewpoint(const FRenderViewpoint &vp)
     {
@@ -421,8 +421,8 @@ HWPortal * HWDrawInfo::FindPortal(const void * src)
 
 HWDecal *HWDrawInfo::AddDecal(bool onmirror)
 {
-	auto decal = (HWDecal*)RenderDataAllocator.Alloc(sizeof(HWDecal));
-	Decals[onmirror ? 1 : 0].Push(decal);
+	auto decal = (HWDecal*)AllocRenderData(sizeof(HWDecal));
+	(workerLists ? workerLists->Decals : Decals)[onmirror ? 1 : 0].Push(decal);
 	return decal;
 }
 
@@ -876,6 +876,14 @@ void HWDrawInfo::ProcessScene(bool toscreen)
 
 void HWDrawInfo::AddSubsectorToPortal(FSectorPortalGroup *ptg, subsector_t *sub)
 {
+	if (workerLists)
+	{
+		HWSharedCall call = { HWSharedCall::SubsectorToPortal };
+		call.portalgroup = ptg;
+		call.sub = sub;
+		DeferSharedCall(call);
+		return;
+	}
 	auto portal = FindPortal(ptg);
 	if (!portal)
 	{
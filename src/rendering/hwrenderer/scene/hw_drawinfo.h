@@ -95,6 +95,37 @@ enum DrawListType
 	GLDL_TYPES,
 };
 
+// A call that changes state the BSP workers share, like the portal list.
+// While there's more than one worker these get recorded and replayed on the
+// main thread when merging the workers' lists, in the order the jobs were queued.
+struct HWSharedCall
+{
+	enum
+	{
+		PutPortal,
+		UpperMissingTexture,
+		LowerMissingTexture,
+		SubsectorToPortal,
+	};
+
+	int type;
+	unsigned listsizes[GLDL_TYPES + 2];	// the worker's list sizes when this was called.
+	HWWall *wall;
+	int ptype, plane;
+	side_t *side;
+	subsector_t *sub;
+	float backheight;
+	FSectorPortalGroup *portalgroup;
+};
+
+// What one BSP worker thread produces while there's more than one.
+// These get merged into the draw info's lists after the traversal.
+struct HWWorkerLists
+{
+	HWDrawList drawlists[GLDL_TYPES];
+	TArray<HWDecal *> Decals[2];
+	TArray<HWSharedCall> SharedCalls;
+};
 
 struct HWDrawInfo
 {
@@ -182,6 +213,17 @@ struct HWDrawInfo
 	fixed_t viewx, viewy;	// since the nodes are still fixed point, keeping the view position  also fixed point for node traversal is faster.
 	bool multithread;
 
+	static thread_local HWWorkerLists *workerLists;	// set on BSP worker threads while there's more than one.
+	static thread_local int *workerFlats;			// the worker's flat count, for the same reason.
+
+	void DeferSharedCall(HWSharedCall &call);
+	void ReplaySharedCall(const HWSharedCall &call);
+
+	HWDrawList &DrawList(int list)
+	{
+		return workerLists ? workerLists->drawlists[list] : drawlists[list];
+	}
+
 private:
     // For ProcessLowerMiniseg
     bool inview;
@@ -191,7 +233,7 @@ private:
 	subsector_t *currentsubsector;	// used by the line processing code.
 	sector_t *currentsector;
 
-	void WorkerThread();
+	void WorkerThread(int index);
 
 	void UnclipSubsector(subsector_t *sub);
 	
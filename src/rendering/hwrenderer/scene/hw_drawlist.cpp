@@ -37,12 +37,41 @@
 #include "hw_renderstate.h"
 #include "hw_drawinfo.h"
 #include "hw_fakeflat.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "ctpl.h"
+#include <mutex>
 
 FMemArena RenderDataAllocator(1024*1024);	// Use large blocks to reduce allocation time.
 
+// The BSP workers cannot share an arena, so each one gets its own while there's more than one.
+static TDeletingArray<FMemArena*> WorkerDataAllocators;
+static thread_local FMemArena *ThreadDataAllocator = &RenderDataAllocator;
+
 void ResetRenderDataAllocator()
 {
 	RenderDataAllocator.FreeAll();
+	for (auto arena : WorkerDataAllocators) arena->FreeAll();
+}
+
+// Must be called on the main thread before the workers get started.
+void SetupWorkerDataAllocators(int count)
+{
+	while ((int)WorkerDataAllocators.Size() < count)
+	{
+		WorkerDataAllocators.Push(new FMemArena(256*1024));
+	}
+}
+
+// -1 returns the calling thread to the shared allocator.
+void UseWorkerDataAllocator(int worker)
+{
+	ThreadDataAllocator = worker < 0 ? &RenderDataAllocator : WorkerDataAllocators[worker];
+}
+
+void *AllocRenderData(size_t size)
+{
+	return ThreadDataAllocator->Alloc(size);
 }
 
 //==========================================================================
@@ -73,6 +102,42 @@ SortNode * StaticSortNodeArray::GetNew()
 
 static StaticSortNodeArray SortNodes;
 
+//==========================================================================
+//
+// Sorting the translucent list can hand the two halves of a split off to
+// different threads once they are large enough. The halves share nothing
+// but the list's arrays, which only grow when an item gets split, so
+// splitting is the only part that needs to lock.
+//
+//==========================================================================
+
+CVAR(Int, gl_sortthreads, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// 0 = one per core
+CVAR(Bool, gl_sortreuse, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+enum
+{
+	SORT_MT_MIN = 128,		// don't hand off subtrees smaller than this
+};
+
+static ctpl::thread_pool SortPool;
+static std::mutex SortMutex;
+
+static int SortThreadDepth()
+{
+	int threads = gl_sortthreads > 0 ? *gl_sortthreads : (int)std::thread::hardware_concurrency();
+	threads = clamp(threads, 1, 16);
+	int depth = 0;
+	while ((2 << depth) <= threads) depth++;
+
+	// A thread that handed off a subtree waits for it, so every subtree
+	// that can be handed off at the same time needs a thread of its own.
+	if (SortPool.size() != (1 << depth) - 1)
+	{
+		SortPool.resize((1 << depth) - 1);
+	}
+	return depth;
+}
+
 //==========================================================================
 //
 //
@@ -169,6 +234,13 @@ void HWDrawList::MakeSortList()
 	for(i=0;i<drawitems.Size();i++)
 	{
 		n->itemindex=(int)i;
+		n->rendertype=drawitems[i].rendertype;
+		switch (n->rendertype)
+		{
+		case DrawType_WALL: n->wall=walls[drawitems[i].index]; break;
+		case DrawType_FLAT: n->flat=flats[drawitems[i].index]; break;
+		case DrawType_SPRITE: n->sprite=sprites[drawitems[i].index]; break;
+		}
 		n->left=n->equal=n->right=NULL;
 		n->parent=p;
 		p=n;
@@ -185,6 +257,114 @@ void HWDrawList::MakeSortList()
 	}
 }
 
+//==========================================================================
+//
+// Collects everything the sort looks at. If this is the same as for the
+// last sort of this list, the last sort's splits and tree can be reused.
+//
+// The walls' view distances are left out on purpose: they only select
+// which wall splits a subtree, and any of them gives a valid order.
+// So as long as the camera only moves a little, i.e. it sees the same items,
+// does not cross a translucent plane and no sprite changes, the old sort
+// can be kept.
+//
+//==========================================================================
+
+EXTERN_CVAR(Int, gl_billboard_mode)
+EXTERN_CVAR(Bool, gl_billboard_faces_camera)
+EXTERN_CVAR(Bool, gl_billboard_particles)
+
+void HWDrawList::MakeSortKey()
+{
+	auto putf = [&](float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		SortKey.Push(bits);
+	};
+
+	SortKey.Clear();
+	SortKey.Push(uint32_t(reverseSort) | ((*gl_billboard_mode & 3) << 1) | (uint32_t(*gl_billboard_faces_camera) << 3) |
+		(uint32_t(*gl_billboard_particles) << 4) | (uint32_t(!!(screen->hwcaps & RFL_NO_CLIP_PLANES)) << 5) |
+		(uint32_t(screen->BuffersArePersistent()) << 6));
+	for (auto &item : drawitems)
+	{
+		switch (item.rendertype)
+		{
+		case DrawType_WALL:
+		{
+			HWWall *w = walls[item.index];
+			SortKey.Push(DrawType_WALL | (w->type << 8));
+			putf(w->glseg.x1);
+			putf(w->glseg.y1);
+			putf(w->glseg.x2);
+			putf(w->glseg.y2);
+			putf(w->ztop[0]);
+			putf(w->ztop[1]);
+			putf(w->zbottom[0]);
+			putf(w->zbottom[1]);
+			break;
+		}
+
+		case DrawType_FLAT:
+		{
+			HWFlat *f = flats[item.index];
+			SortKey.Push(DrawType_FLAT | (f->ceiling << 8) | ((f->z > SortZ) << 9));
+			putf(f->z);
+			break;
+		}
+
+		case DrawType_SPRITE:
+		{
+			HWSprite *s = sprites[item.index];
+			uint32_t flags = s->actor ? uint32_t(s->actor->renderflags & (RF_FORCEYBILLBOARD | RF_FORCEXYBILLBOARD | RF_ROLLSPRITE | RF_WALLSPRITE | RF_FLATSPRITE)) : 0;
+			SortKey.Push(DrawType_SPRITE | ((s->modelframe != nullptr) << 8) | ((s->particle != nullptr) << 9));
+			SortKey.Push(flags);
+			SortKey.Push(s->index);
+			putf(s->depth);
+			putf(s->x);
+			putf(s->y);
+			putf(s->x1);
+			putf(s->y1);
+			putf(s->z1);
+			putf(s->x2);
+			putf(s->y2);
+			putf(s->z2);
+			break;
+		}
+		}
+	}
+}
+
+//==========================================================================
+//
+// Adds the second half of a split item to the list.
+// This is the only place where sorting modifies the list.
+//
+//==========================================================================
+
+SortNode * HWDrawList::NewSplitNode(SortNode * head, SortNode * sort)
+{
+	std::lock_guard<std::mutex> lock(SortMutex);
+
+	SortNode * node = SortNodes.GetNew();
+	memset(node, 0, sizeof(SortNode));
+	node->rendertype = sort->rendertype;
+	if (sort->rendertype == DrawType_WALL)
+	{
+		node->wall = NewWall();
+		*node->wall = *sort->wall;
+	}
+	else
+	{
+		node->sprite = NewSprite();
+		*node->sprite = *sort->sprite;
+	}
+	node->itemindex = drawitems.Size() - 1;
+	SortSplits.Push({ head->itemindex, sort->itemindex });
+	return node;
+}
+
 
 //==========================================================================
 //
@@ -193,9 +373,9 @@ void HWDrawList::MakeSortList()
 //==========================================================================
 SortNode * HWDrawList::FindSortPlane(SortNode * head)
 {
-	while (head->next && drawitems[head->itemindex].rendertype!=DrawType_FLAT) 
+	while (head->next && head->rendertype!=DrawType_FLAT) 
 		head=head->next;
-	if (drawitems[head->itemindex].rendertype==DrawType_FLAT) return head;
+	if (head->rendertype==DrawType_FLAT) return head;
 	return NULL;
 }
 
@@ -215,10 +395,9 @@ SortNode * HWDrawList::FindSortWall(SortNode * head)
 
 	while (node)
 	{
-		HWDrawItem * it = &drawitems[node->itemindex];
-		if (it->rendertype == DrawType_WALL)
+		if (node->rendertype == DrawType_WALL)
 		{
-			float d = walls[it->index]->ViewDistance;
+			float d = node->wall->ViewDistance;
 			if (d > farthest) farthest = d;
 			if (d < nearest) nearest = d;
 		}
@@ -229,10 +408,9 @@ SortNode * HWDrawList::FindSortWall(SortNode * head)
 	farthest = (farthest + nearest) / 2;
 	while (node)
 	{
-		HWDrawItem * it = &drawitems[node->itemindex];
-		if (it->rendertype == DrawType_WALL)
+		if (node->rendertype == DrawType_WALL)
 		{
-			float di = fabsf(walls[it->index]->ViewDistance - farthest);
+			float di = fabsf(node->wall->ViewDistance - farthest);
 			if (!best || di < bestdist)
 			{
 				best = node;
@@ -251,8 +429,8 @@ SortNode * HWDrawList::FindSortWall(SortNode * head)
 //==========================================================================
 void HWDrawList::SortPlaneIntoPlane(SortNode * head,SortNode * sort)
 {
-	HWFlat * fh= flats[drawitems[head->itemindex].index];
-	HWFlat * fs= flats[drawitems[sort->itemindex].index];
+	HWFlat * fh= head->flat;
+	HWFlat * fs= sort->flat;
 
 	if (fh->z==fs->z) 
 		head->AddToEqual(sort);
@@ -270,8 +448,8 @@ void HWDrawList::SortPlaneIntoPlane(SortNode * head,SortNode * sort)
 //==========================================================================
 void HWDrawList::SortWallIntoPlane(HWDrawInfo* di, SortNode * head, SortNode * sort)
 {
-	HWFlat * fh = flats[drawitems[head->itemindex].index];
-	HWWall * ws = walls[drawitems[sort->itemindex].index];
+	HWFlat * fh = head->flat;
+	HWWall * ws = sort->wall;
 
 	bool ceiling = fh->z > SortZ;
 
@@ -279,8 +457,8 @@ void HWDrawList::SortWallIntoPlane(HWDrawInfo* di, SortNode * head, SortNode * s
 	{
 		// We have to split this wall!
 
-		HWWall *w = NewWall();
-		*w = *ws;
+		SortNode * sort2 = NewSplitNode(head, sort);
+		HWWall *w = sort2->wall;
 
 		// Splitting is done in the shader with clip planes, if available
 		if (screen->hwcaps & RFL_NO_CLIP_PLANES)
@@ -308,10 +486,6 @@ void HWDrawList::SortWallIntoPlane(HWDrawInfo* di, SortNode * head, SortNode * s
 			ws->MakeVertices(di, false);
 		}
 
-		SortNode * sort2 = SortNodes.GetNew();
-		memset(sort2, 0, sizeof(SortNode));
-		sort2->itemindex = drawitems.Size() - 1;
-
 		head->AddToLeft(sort);
 		head->AddToRight(sort2);
 	}
@@ -333,8 +507,8 @@ void HWDrawList::SortWallIntoPlane(HWDrawInfo* di, SortNode * head, SortNode * s
 //==========================================================================
 void HWDrawList::SortSpriteIntoPlane(SortNode * head, SortNode * sort)
 {
-	HWFlat * fh = flats[drawitems[head->itemindex].index];
-	HWSprite * ss = sprites[drawitems[sort->itemindex].index];
+	HWFlat * fh = head->flat;
+	HWSprite * ss = sort->sprite;
 
 	bool ceiling = fh->z > SortZ;
 
@@ -344,8 +518,8 @@ void HWDrawList::SortSpriteIntoPlane(SortNode * head, SortNode * sort)
 	if ((hiz > fh->z && loz < fh->z) || ss->modelframe)
 	{
 		// We have to split this sprite
-		HWSprite *s = NewSprite();
-		*s = *ss;
+		SortNode * sort2 = NewSplitNode(head, sort);
+		HWSprite *s = sort2->sprite;
 
 		// Splitting is done in the shader with clip planes, if available.
 		// The fallback here only really works for non-y-billboarded sprites.
@@ -365,10 +539,6 @@ void HWDrawList::SortSpriteIntoPlane(SortNode * head, SortNode * sort)
 			}
 		}
 
-		SortNode * sort2 = SortNodes.GetNew();
-		memset(sort2, 0, sizeof(SortNode));
-		sort2->itemindex = drawitems.Size() - 1;
-
 		head->AddToLeft(sort);
 		head->AddToRight(sort2);
 	}
@@ -401,8 +571,8 @@ inline double CalcIntersectionVertex(HWWall *w1, HWWall * w2)
 
 void HWDrawList::SortWallIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sort)
 {
-	HWWall * wh= walls[drawitems[head->itemindex].index];
-	HWWall * ws= walls[drawitems[sort->itemindex].index];
+	HWWall * wh= head->wall;
+	HWWall * ws= sort->wall;
 	float v1=wh->PointOnSide(ws->glseg.x1,ws->glseg.y1);
 	float v2=wh->PointOnSide(ws->glseg.x2,ws->glseg.y2);
 
@@ -441,8 +611,8 @@ void HWDrawList::SortWallIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sor
 		float izb=(float)(ws->zbottom[0]+r*(ws->zbottom[1]-ws->zbottom[0]));
 
 		ws->vertcount = 0;	// invalidate current vertices.
-		HWWall *w= NewWall();
-		*w = *ws;
+		SortNode * sort2=NewSplitNode(head, sort);
+		HWWall *w= sort2->wall;
 
 		w->glseg.x1=ws->glseg.x2=ix;
 		w->glseg.y1=ws->glseg.y2=iy;
@@ -454,10 +624,6 @@ void HWDrawList::SortWallIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sor
 		ws->MakeVertices(di, false);
 		w->MakeVertices(di, false);
 
-		SortNode * sort2=SortNodes.GetNew();
-		memset(sort2,0,sizeof(SortNode));
-		sort2->itemindex=drawitems.Size()-1;
-
 		if (v1>0)
 		{
 			head->AddToLeft(sort2);
@@ -477,10 +643,6 @@ void HWDrawList::SortWallIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sor
 // 
 //
 //==========================================================================
-EXTERN_CVAR(Int, gl_billboard_mode)
-EXTERN_CVAR(Bool, gl_billboard_faces_camera)
-EXTERN_CVAR(Bool, gl_billboard_particles)
-
 inline double CalcIntersectionVertex(HWSprite *s, HWWall * w2)
 {
 	float ax = s->x1, ay = s->y1;
@@ -492,8 +654,8 @@ inline double CalcIntersectionVertex(HWSprite *s, HWWall * w2)
 
 void HWDrawList::SortSpriteIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sort)
 {
-	HWWall *wh= walls[drawitems[head->itemindex].index];
-	HWSprite * ss= sprites[drawitems[sort->itemindex].index];
+	HWWall *wh= head->wall;
+	HWSprite * ss= sort->sprite;
 
 	float v1 = wh->PointOnSide(ss->x1, ss->y1);
 	float v2 = wh->PointOnSide(ss->x2, ss->y2);
@@ -546,17 +708,13 @@ void HWDrawList::SortSpriteIntoWall(HWDrawInfo *di, SortNode * head,SortNode * s
 		float iy=(float)(ss->y1 + r * (ss->y2-ss->y1));
 		float iu=(float)(ss->ul + r * (ss->ur-ss->ul));
 
-		HWSprite *s = NewSprite();
-		*s = *ss;
+		SortNode * sort2=NewSplitNode(head, sort);
+		HWSprite *s = sort2->sprite;
 
 		s->x1=ss->x2=ix;
 		s->y1=ss->y2=iy;
 		s->ul=ss->ur=iu;
 
-		SortNode * sort2=SortNodes.GetNew();
-		memset(sort2,0,sizeof(SortNode));
-		sort2->itemindex=drawitems.Size()-1;
-
 		if (v1>0)
 		{
 			head->AddToLeft(sort2);
@@ -589,8 +747,8 @@ void HWDrawList::SortSpriteIntoWall(HWDrawInfo *di, SortNode * head,SortNode * s
 
 inline int HWDrawList::CompareSprites(SortNode * a,SortNode * b)
 {
-	HWSprite * s1= sprites[drawitems[a->itemindex].index];
-	HWSprite * s2= sprites[drawitems[b->itemindex].index];
+	HWSprite * s1= a->sprite;
+	HWSprite * s2= b->sprite;
 
 	if (s1->depth < s2->depth) return 1;
 	if (s1->depth > s2->depth) return -1;
@@ -608,7 +766,7 @@ SortNode * HWDrawList::SortSpriteList(SortNode * head)
 	int count;
 	unsigned i;
 
-	static TArray<SortNode*> sortspritelist;
+	thread_local TArray<SortNode*> sortspritelist;
 
 	SortNode * parent=head->parent;
 
@@ -633,7 +791,7 @@ SortNode * HWDrawList::SortSpriteList(SortNode * head)
 //
 //
 //==========================================================================
-SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
+SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head, int threaddepth)
 {
 	SortNode * node, * sn, * next;
 
@@ -647,7 +805,7 @@ SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
 		while (node)
 		{
 			next=node->next;
-			switch(drawitems[node->itemindex].rendertype)
+			switch(node->rendertype)
 			{
 			case DrawType_FLAT:
 				SortPlaneIntoPlane(head,node);
@@ -676,7 +834,7 @@ SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
 			while (node)
 			{
 				next=node->next;
-				switch(drawitems[node->itemindex].rendertype)
+				switch(node->rendertype)
 				{
 				case DrawType_WALL:
 					SortWallIntoWall(di, head,node);
@@ -696,11 +854,90 @@ SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
 			return SortSpriteList(head);
 		}
 	}
-	if (head->left) head->left=DoSort(di, head->left);
-	if (head->right) head->right=DoSort(di, head->right);
+
+	auto chainlength = [](SortNode * node)
+	{
+		int count = 0;
+		for (; node && count < SORT_MT_MIN; node = node->next) count++;
+		return count;
+	};
+	if (threaddepth > 0 && chainlength(head->left) >= SORT_MT_MIN && chainlength(head->right) >= SORT_MT_MIN)
+	{
+		auto job = SortPool.push([=](int) { head->left = DoSort(di, head->left, threaddepth - 1); });
+		head->right = DoSort(di, head->right, threaddepth - 1);
+		job.wait();
+	}
+	else
+	{
+		if (head->left) head->left=DoSort(di, head->left, threaddepth);
+		if (head->right) head->right=DoSort(di, head->right, threaddepth);
+	}
 	return sn;
 }
 
+//==========================================================================
+//
+// Repeats the splits of the last sort and restores its tree.
+// Only valid if the sort key is the same as last time, because then every
+// split happens exactly as it did then, in the order of the new items.
+//
+//==========================================================================
+
+SortNode * HWDrawList::ReplaySort(HWDrawInfo *di)
+{
+	SortSplits.Clear();
+	for (auto &split : LastSortSplits)
+	{
+		SortNode * head = SortNodes[SortNodeStart + split.head];
+		SortNode * sort = SortNodes[SortNodeStart + split.sort];
+		if (head->rendertype == DrawType_FLAT)
+		{
+			if (sort->rendertype == DrawType_WALL) SortWallIntoPlane(di, head, sort);
+			else SortSpriteIntoPlane(head, sort);
+		}
+		else
+		{
+			if (sort->rendertype == DrawType_WALL) SortWallIntoWall(di, head, sort);
+			else SortSpriteIntoWall(di, head, sort);
+		}
+	}
+	assert(SortSplits.Size() == LastSortSplits.Size() && drawitems.Size() == LastSortTree.Size());
+
+	auto getnode = [=](int index) { return index < 0 ? nullptr : SortNodes[SortNodeStart + index]; };
+	for (unsigned i = 0; i < drawitems.Size(); i++)
+	{
+		SortNode * node = SortNodes[SortNodeStart + i];
+		node->parent = node->next = nullptr;
+		node->left = getnode(LastSortTree[i].left);
+		node->equal = getnode(LastSortTree[i].equal);
+		node->right = getnode(LastSortTree[i].right);
+	}
+	return getnode(LastSortRoot);
+}
+
+//==========================================================================
+//
+// Keeps the result of a full sort for ReplaySort.
+// Splitting creates the new items and their nodes together, so item i
+// always has the node at SortNodeStart + i.
+//
+//==========================================================================
+
+void HWDrawList::SaveSort()
+{
+	auto getindex = [](SortNode * node) { return node ? node->itemindex : -1; };
+	LastSortTree.Resize(drawitems.Size());
+	for (unsigned i = 0; i < drawitems.Size(); i++)
+	{
+		SortNode * node = SortNodes[SortNodeStart + i];
+		assert(node->itemindex == (int)i);
+		LastSortTree[i] = { getindex(node->left), getindex(node->equal), getindex(node->right) };
+	}
+	LastSortRoot = sorted->itemindex;
+	LastSortKey.Swap(SortKey);
+	LastSortSplits.Swap(SortSplits);
+}
+
 //==========================================================================
 //
 //
@@ -711,7 +948,25 @@ void HWDrawList::Sort(HWDrawInfo *di)
 	reverseSort = !!(di->Level->i_compatflags & COMPATF_SPRITESORT);
     SortZ = di->Viewpoint.Pos.Z;
 	MakeSortList();
-	sorted = DoSort(di, SortNodes[SortNodeStart]);
+	if (gl_sortreuse)
+	{
+		MakeSortKey();
+		if (SortKey.Size() == LastSortKey.Size() && !memcmp(SortKey.Data(), LastSortKey.Data(), SortKey.Size() * sizeof(uint32_t)))
+		{
+			sorted = ReplaySort(di);
+			return;
+		}
+	}
+	SortSplits.Clear();
+	sorted = DoSort(di, SortNodes[SortNodeStart], drawitems.Size() >= 2 * SORT_MT_MIN ? SortThreadDepth() : 0);
+	if (gl_sortreuse)
+	{
+		SaveSort();
+	}
+	else
+	{
+		LastSortKey.Clear();
+	}
 }
 
 //==========================================================================
@@ -758,7 +1013,7 @@ void HWDrawList::SortFlats()
 
 HWWall *HWDrawList::NewWall()
 {
-	auto wall = (HWWall*)RenderDataAllocator.Alloc(sizeof(HWWall));
+	auto wall = (HWWall*)AllocRenderData(sizeof(HWWall));
 	drawitems.Push(HWDrawItem(DrawType_WALL, walls.Push(wall)));
 	return wall;
 }
@@ -770,7 +1025,7 @@ HWWall *HWDrawList::NewWall()
 //==========================================================================
 HWFlat *HWDrawList::NewFlat()
 {
-	auto flat = (HWFlat*)RenderDataAllocator.Alloc(sizeof(HWFlat));
+	auto flat = (HWFlat*)AllocRenderData(sizeof(HWFlat));
 	drawitems.Push(HWDrawItem(DrawType_FLAT,flats.Push(flat)));
 	return flat;
 }
@@ -782,11 +1037,40 @@ HWFlat *HWDrawList::NewFlat()
 //==========================================================================
 HWSprite *HWDrawList::NewSprite()
 {	
-	auto sprite = (HWSprite*)RenderDataAllocator.Alloc(sizeof(HWSprite));
+	auto sprite = (HWSprite*)AllocRenderData(sizeof(HWSprite));
 	drawitems.Push(HWDrawItem(DrawType_SPRITE, sprites.Push(sprite)));
 	return sprite;
 }
 
+//==========================================================================
+//
+// Appends the items [first, last) of another list. The items themselves
+// are not copied, so they must stay allocated as long as this list.
+//
+//==========================================================================
+
+void HWDrawList::AppendItems(HWDrawList &src, unsigned first, unsigned last)
+{
+	for (unsigned i = first; i < last; i++)
+	{
+		auto &item = src.drawitems[i];
+		switch (item.rendertype)
+		{
+		case DrawType_WALL:
+			drawitems.Push(HWDrawItem(DrawType_WALL, walls.Push(src.walls[item.index])));
+			break;
+
+		case DrawType_FLAT:
+			drawitems.Push(HWDrawItem(DrawType_FLAT, flats.Push(src.flats[item.index])));
+			break;
+
+		case DrawType_SPRITE:
+			drawitems.Push(HWDrawItem(DrawType_SPRITE, sprites.Push(src.sprites[item.index])));
+			break;
+		}
+	}
+}
+
 //==========================================================================
 //
 //
@@ -939,9 +1223,11 @@ void HWDrawList::DrawSorted(HWDrawInfo *di, FRenderState &state)
 
 	if (!sorted)
 	{
+		SortAll.Clock();
 		screen->mVertexData->Map();
 		Sort(di);
 		screen->mVertexData->Unmap();
+		SortAll.Unclock();
 	}
 	state.ClearClipSplit();
 	state.EnableClipDistance(1, true);
@@ -952,3 +1238,182 @@ void HWDrawList::DrawSorted(HWDrawInfo *di, FRenderState &state)
 	state.ClearClipSplit();
 }
 
+
+//==========================================================================
+//
+// CCMD gl_sortbench
+//
+// Sorts a made up translucent list of walls, planes and sprites around
+// the origin the way DrawSorted does, but without drawing anything, so
+// it does not matter what the render state is. The sort is timed with
+// one thread, with gl_sortthreads and when reusing the last sort.
+//
+// gl_sortbench [items] [sorts]
+//
+//==========================================================================
+
+static void HashSortedList(SortNode * head, uint32_t &hash)
+{
+	auto add = [&](float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		hash = (hash ^ bits) * 16777619u;
+	};
+
+	if (head->left) HashSortedList(head->left, hash);
+	for (SortNode * node = head; node; node = node->equal)
+	{
+		switch (node->rendertype)
+		{
+		case DrawType_WALL:
+			add(node->wall->glseg.x1);
+			add(node->wall->glseg.x2);
+			add(node->wall->ztop[0]);
+			add(node->wall->zbottom[0]);
+			break;
+
+		case DrawType_FLAT:
+			add(node->flat->z);
+			break;
+
+		case DrawType_SPRITE:
+			add(node->sprite->x1);
+			add(node->sprite->x2);
+			add(node->sprite->z1);
+			add(node->sprite->z2);
+			break;
+		}
+	}
+	if (head->right) HashSortedList(head->right, hash);
+}
+
+CCMD(gl_sortbench)
+{
+	if (gamestate != GS_LEVEL || screen->mVertexData == nullptr)
+	{
+		Printf("gl_sortbench can only be used in a level\n");
+		return;
+	}
+	const int numitems = argv.argc() > 1 ? clamp(atoi(argv[1]), 16, 100000) : 2000;
+	const int numsorts = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 10000) : 100;
+
+	uint32_t seed = 1;
+	auto rand = [&](float range) { seed = seed * 1664525u + 1013904223u; return (seed >> 16) * (range / 65536.f); };
+
+	// The walls need a seg, but one without a sidedef is never split at vertices.
+	seg_t seg;
+	memset(&seg, 0, sizeof(seg));
+
+	const int numflats = numitems / 50 + 1;
+	const int numsprites = numitems * 3 / 10;
+	const int numwalls = numitems - numflats - numsprites;
+	std::vector<HWWall> walls(numwalls);
+	std::vector<HWFlat> flats(numflats);
+	std::vector<HWSprite> sprites(numsprites);
+	for (auto &w : walls)
+	{
+		memset(&w, 0, sizeof(w));
+		const float cx = rand(4096.f) - 2048.f, cy = rand(4096.f) - 2048.f;
+		const float angle = rand(6.2831853f), len = 16.f + rand(112.f);
+		w.glseg.x1 = cx - cosf(angle) * len;
+		w.glseg.y1 = cy - sinf(angle) * len;
+		w.glseg.x2 = cx + cosf(angle) * len;
+		w.glseg.y2 = cy + sinf(angle) * len;
+		w.glseg.fracright = 1.f;
+		w.zbottom[0] = w.zbottom[1] = rand(256.f) - 128.f;
+		w.ztop[0] = w.ztop[1] = w.zbottom[0] + 32.f + rand(224.f);
+		w.tcs[HWWall::UPRGT].u = w.tcs[HWWall::LORGT].u = 1.f;
+		w.tcs[HWWall::LOLFT].v = w.tcs[HWWall::LORGT].v = 1.f;
+		w.type = RENDERWALL_M2S;
+		w.seg = &seg;
+		w.ViewDistance = cx * cx + cy * cy;
+	}
+	for (auto &f : flats)
+	{
+		memset(&f, 0, sizeof(f));
+		f.z = rand(512.f) - 256.f;
+		f.ceiling = f.z > 0;
+	}
+	for (unsigned i = 0; i < sprites.size(); i++)
+	{
+		auto &s = sprites[i];
+		memset(&s, 0, sizeof(s));
+		s.x = rand(4096.f) - 2048.f;
+		s.y = rand(4096.f) - 2048.f;
+		const float dist = max(sqrtf(s.x * s.x + s.y * s.y), 1.f);
+		const float width = 8.f + rand(24.f);
+		s.x1 = s.x - s.y / dist * width;
+		s.y1 = s.y + s.x / dist * width;
+		s.x2 = s.x + s.y / dist * width;
+		s.y2 = s.y - s.x / dist * width;
+		s.z = s.z1 = rand(256.f) - 128.f;
+		s.z2 = s.z1 + 16.f + rand(80.f);
+		s.ur = s.vb = 1.f;
+		s.depth = dist;
+		s.index = i;
+	}
+
+	// Mix the items like the BSP traversal would.
+	TArray<HWDrawItem> items;
+	for (int i = 0; i < numwalls; i++) items.Push(HWDrawItem(DrawType_WALL, i));
+	for (int i = 0; i < numflats; i++) items.Push(HWDrawItem(DrawType_FLAT, i));
+	for (int i = 0; i < numsprites; i++) items.Push(HWDrawItem(DrawType_SPRITE, i));
+	for (unsigned i = items.Size() - 1; i > 0; i--)
+	{
+		std::swap(items[i], items[unsigned(rand(65536.f)) % (i + 1)]);
+	}
+
+	FRenderViewpoint vp = r_viewpoint;
+	vp.Pos = DVector3(0, 0, 0);
+	auto di = HWDrawInfo::StartDrawInfo(primaryLevel, nullptr, vp, nullptr);
+	auto &list = di->drawlists[GLDL_TRANSLUCENT];
+
+	const int savedthreads = gl_sortthreads;
+	const bool savedreuse = gl_sortreuse;
+	double ms[3];
+	uint32_t hash[3];
+	int splits = 0, threads = 1;
+	for (int pass = 0; pass < 3; pass++)
+	{
+		gl_sortthreads = pass == 0 ? 1 : savedthreads;
+		gl_sortreuse = pass == 2;
+		list.LastSortKey.Clear();
+		hash[pass] = 2166136261u;
+		uint64_t time = 0;
+		for (int n = 0; n < numsorts; n++)
+		{
+			// This is the only draw info, so nothing else is in the allocator.
+			list.Reset();
+			ResetRenderDataAllocator();
+			for (auto &item : items)
+			{
+				switch (item.rendertype)
+				{
+				case DrawType_WALL: *list.NewWall() = walls[item.index]; break;
+				case DrawType_FLAT: *list.NewFlat() = flats[item.index]; break;
+				case DrawType_SPRITE: *list.NewSprite() = sprites[item.index]; break;
+				}
+			}
+
+			screen->mVertexData->Map();
+			const uint64_t start = I_nsTime();
+			list.Sort(di);
+			time += I_nsTime() - start;
+			screen->mVertexData->Unmap();
+			screen->mVertexData->Reset();
+			HashSortedList(list.sorted, hash[pass]);
+		}
+		ms[pass] = time * 1e-6;
+		splits = list.Size() - items.Size();
+		if (pass == 1) threads = SortPool.size() + 1;
+	}
+	gl_sortthreads = savedthreads;
+	gl_sortreuse = savedreuse;
+	list.Reset();
+	di->EndDrawInfo();
+
+	Printf("%d items, %d splits, %d sorts: 1 thread %.2f ms, %d threads %.2f ms (%.1fx), reused %.2f ms (%.1fx)%s\n",
+		numitems, splits, numsorts, ms[0], threads, ms[1], ms[0] / max(ms[1], 1e-6), ms[2], ms[0] / max(ms[2], 1e-6),
+		hash[0] == hash[1] && hash[0] == hash[2] ? "" : ", results differ");
+}
@@ -4,6 +4,9 @@
 
 extern FMemArena RenderDataAllocator;
 void ResetRenderDataAllocator();
+void SetupWorkerDataAllocators(int count);
+void UseWorkerDataAllocator(int worker);
+void *AllocRenderData(size_t size);
 struct HWDrawInfo;
 class HWWall;
 class HWFlat;
@@ -38,6 +41,13 @@ struct HWDrawItem
 struct SortNode
 {
 	int itemindex;
+	HWDrawItemType rendertype;
+	union					// the item itself, so that sorting never has to look into the list's arrays,
+	{						// which another sort thread may be reallocating.
+		HWWall * wall;
+		HWFlat * flat;
+		HWSprite * sprite;
+	};
 	SortNode * parent;
 	SortNode * next;		// unsorted successor
 	SortNode * left;		// left side of this node
@@ -69,6 +79,20 @@ struct HWDrawList
     float SortZ;
 	SortNode * sorted;
 	bool reverseSort;
+
+	// The last sort of this list, for reusing it as long as nothing the sort looks at changes.
+	struct SortSplit
+	{
+		int head, sort;			// item indices of the splitter and the split item
+	};
+	struct SortLinks
+	{
+		int left, equal, right;	// item indices, -1 if none
+	};
+	TArray<uint32_t> SortKey, LastSortKey;
+	TArray<SortSplit> SortSplits, LastSortSplits;
+	TArray<SortLinks> LastSortTree;
+	int LastSortRoot;
 	
 public:
 	HWDrawList()
@@ -76,6 +100,7 @@ public:
 		next=NULL;
 		SortNodeStart=-1;
 		sorted=NULL;
+		LastSortRoot=-1;
 	}
 	
 	~HWDrawList()
@@ -91,12 +116,15 @@ public:
 	HWWall *NewWall();
 	HWFlat *NewFlat();
 	HWSprite *NewSprite();
+	void AppendItems(HWDrawList &src, unsigned first, unsigned last);
 	void Reset();
 	void SortWalls();
 	void SortFlats();
 	
 	
 	void MakeSortList();
+	void MakeSortKey();
+	SortNode * NewSplitNode(SortNode * head, SortNode * sort);
 	SortNode * FindSortPlane(SortNode * head);
 	SortNode * FindSortWall(SortNode * head);
 	void SortPlaneIntoPlane(SortNode * head,SortNode * sort);
@@ -106,7 +134,9 @@ public:
 	void SortSpriteIntoWall(HWDrawInfo *di, SortNode * head,SortNode * sort);
 	int CompareSprites(SortNode * a,SortNode * b);
 	SortNode * SortSpriteList(SortNode * head);
-	SortNode * DoSort(HWDrawInfo *di, SortNode * head);
+	SortNode * DoSort(HWDrawInfo *di, SortNode * head, int threaddepth);
+	SortNode * ReplaySort(HWDrawInfo *di);
+	void SaveSort();
 	void Sort(HWDrawInfo *di);
 
 	void DoDraw(HWDrawInfo *di, FRenderState &state, bool translucent, int i);
@@ -206,6 +206,7 @@ public:
 
 	void PutWall(HWDrawInfo *di, bool translucent);
 	void PutPortal(HWDrawInfo *di, int ptype, int plane);
+	void AddToPortal(HWDrawInfo *di, int ptype, int plane);
 	void CheckTexturePosition(FTexCoordInfo *tci);
 
 	void Put3DWall(HWDrawInfo *di, lightlist_t * lightlist, bool translucent);
@@ -440,7 +440,8 @@ void HWFlat::Process(HWDrawInfo *di, sector_t * model, int whichplane, bool fog)
 
 	// For hacks this won't go into a render list.
 	PutFlat(di, fog);
-	rendered_flats++;
+	if (HWDrawInfo::workerFlats) (*HWDrawInfo::workerFlats)++;
+	else rendered_flats++;
 }
 
 //==========================================================================
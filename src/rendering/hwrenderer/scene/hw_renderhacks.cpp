@@ -195,6 +195,15 @@ void HWDrawInfo::AddOtherCeilingPlane(int sector, gl_subsectorrendernode * node)
 void HWDrawInfo::AddUpperMissingTexture(side_t * side, subsector_t *sub, float Backheight)
 {
 	if (!side->segs[0]->backsector) return;
+	if (workerLists)
+	{
+		HWSharedCall call = { HWSharedCall::UpperMissingTexture };
+		call.side = side;
+		call.sub = sub;
+		call.backheight = Backheight;
+		DeferSharedCall(call);
+		return;
+	}
 
 	for (int i = 0; i < side->numsegs; i++)
 	{
@@ -254,6 +263,15 @@ void HWDrawInfo::AddLowerMissingTexture(side_t * side, subsector_t *sub, float B
 		// process the missing texture for them.
 		if (backsec->transdoorheight == backsec->GetPlaneTexZ(sector_t::floor)) return;
 	}
+	if (workerLists)
+	{
+		HWSharedCall call = { HWSharedCall::LowerMissingTexture };
+		call.side = side;
+		call.sub = sub;
+		call.backheight = Backheight;
+		DeferSharedCall(call);
+		return;
+	}
 
 	// we need to check all segs of this sidedef
 	for (int i = 0; i < side->numsegs; i++)
@@ -564,10 +564,38 @@ void HWWall::PutWall(HWDrawInfo *di, bool translucent)
 //==========================================================================
 
 void HWWall::PutPortal(HWDrawInfo *di, int ptype, int plane)
+{
+	MakeVertices(di, false);
+	if (!di->workerLists)
+	{
+		AddToPortal(di, ptype, plane);
+		return;
+	}
+	if (ptype == PORTALTYPE_LINETOLINE && !lineportal) return;
+
+	// The portal gets added when the workers' lists are merged, so this needs a copy
+	// of the wall and of the horizon or sky info that are only on the caller's stack.
+	auto wall = new (AllocRenderData(sizeof(HWWall))) HWWall(*this);
+	if (ptype == PORTALTYPE_HORIZON)
+	{
+		wall->horizon = new (AllocRenderData(sizeof(HWHorizonInfo))) HWHorizonInfo(*horizon);
+	}
+	else if (ptype == PORTALTYPE_SKY)
+	{
+		wall->sky = new (AllocRenderData(sizeof(HWSkyInfo))) HWSkyInfo(*sky);
+	}
+	HWSharedCall call = { HWSharedCall::PutPortal };
+	call.wall = wall;
+	call.ptype = ptype;
+	call.plane = plane;
+	di->DeferSharedCall(call);
+	vertcount = 0;
+}
+
+void HWWall::AddToPortal(HWDrawInfo *di, int ptype, int plane)
 {
 	HWPortal * portal = nullptr;
 
-	MakeVertices(di, false);
 	switch (ptype)
 	{
 		// portals don't go into the draw list.
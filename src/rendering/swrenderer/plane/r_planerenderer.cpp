@@ -40,8 +40,36 @@
 #include "swrenderer/plane/r_visibleplane.h"
 #include "swrenderer/plane/r_planerenderer.h"
 
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
+
 namespace swrenderer
 {
+	// Returns the first column at or left of x whose top or bottom differs
+	// from the column to its right, or left - 1 if there is none. Such runs
+	// of equal columns neither open nor close any spans, and they are long
+	// on open maps where a plane often spans most of the screen.
+	static int LastChangedColumn(const uint16_t *top, const uint16_t *bottom, int left, int x)
+	{
+#ifndef NO_SSE
+		while (x - 7 >= left)
+		{
+			__m128i t1 = _mm_loadu_si128((const __m128i*)(top + x - 7));
+			__m128i t2 = _mm_loadu_si128((const __m128i*)(top + x - 6));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(bottom + x - 7));
+			__m128i b2 = _mm_loadu_si128((const __m128i*)(bottom + x - 6));
+			__m128i same = _mm_and_si128(_mm_cmpeq_epi16(t1, t2), _mm_cmpeq_epi16(b1, b2));
+			if (_mm_movemask_epi8(same) != 0xffff)
+				break;
+			x -= 8;
+		}
+#endif
+		while (x >= left && top[x] == top[x + 1] && bottom[x] == bottom[x + 1])
+			x--;
+		return x;
+	}
+
 	void PlaneRenderer::RenderLines(VisiblePlane *pl)
 	{
 		// t1/b1 are at x
@@ -59,6 +87,10 @@ namespace swrenderer
 
 		for (--x; x >= pl->left; --x)
 		{
+			x = LastChangedColumn(pl->top, pl->bottom, pl->left, x);
+			if (x < pl->left)
+				break;
+
 			int t1 = pl->top[x];
 			int b1 = pl->bottom[x];
 			const int xr = x + 1;
@@ -50,6 +50,8 @@ namespace swrenderer
 		void Render(RenderThread *thread, fixed_t alpha, bool additive, bool masked);
 
 		VisiblePlane *next = nullptr;		// Next visplane in hash chain -- killough
+		VisiblePlane *indexnext = nullptr;	// Next visplane in the same VisiblePlaneList index bucket
+		unsigned chain = 0;					// Hash chain the visplane is in
 
 		FDynamicColormap *colormap = nullptr;		// [RH] Support multiple colormaps
 		FSectorPortal *portal = nullptr;			// [RH] Support sky boxes
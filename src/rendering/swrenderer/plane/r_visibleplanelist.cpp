@@ -52,8 +52,22 @@
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/r_renderthread.h"
 
+CVAR(Bool, r_planeindex, true, 0)
+
 namespace swrenderer
 {
+	// Main thread plane statistics of the last frame.
+	static int planesearches, planeprobes, planecount;
+	static int lastsearches, lastprobes, lastcount;
+
+	ADD_STAT(visplanes)
+	{
+		FString out;
+		out.Format("visplanes=%d  lookups=%d  probes/lookup=%.2f  index %s", lastcount, lastsearches,
+			lastsearches > 0 ? double(lastprobes) / lastsearches : 0., r_planeindex ? "on" : "off");
+		return out;
+	}
+
 	VisiblePlaneList::VisiblePlaneList(RenderThread *thread)
 	{
 		Thread = thread;
@@ -69,14 +83,54 @@ namespace swrenderer
 	{
 		VisiblePlane *newplane = Thread->FrameMemory->NewObject<VisiblePlane>(Thread);
 		newplane->next = visplanes[hash];
+		newplane->chain = hash;
 		visplanes[hash] = newplane;
+		if (Thread->MainThread) planecount++;
 		return newplane;
 	}
 
+	unsigned VisiblePlaneList::CalcIndexHash(unsigned chain, int picnum, int lightlevel, const secplane_t &height, int sky, int portaluniq, FDynamicColormap *colormap)
+	{
+		unsigned hash = (unsigned)picnum * 2654435761u + chain * 668265263u;
+		hash ^= (unsigned)lightlevel * 40503u + (unsigned)sky * 97u + (unsigned)portaluniq * 8191u;
+		hash ^= (unsigned)FLOAT2FIXED(height.fD()) * 2246822519u;
+		hash ^= (unsigned)FLOAT2FIXED(height.fC()) * 3266489917u;
+		hash ^= (unsigned)((uintptr_t)colormap >> 4);
+		hash ^= hash >> 15;
+		return hash & (PLANEINDEXSIZE - 1);
+	}
+
+	unsigned VisiblePlaneList::CalcIndexHash(const VisiblePlane *pl)
+	{
+		return CalcIndexHash(pl->chain, pl->picnum.GetIndex(), pl->lightlevel, pl->height, pl->sky, pl->CurrentPortalUniq, pl->colormap);
+	}
+
+	void VisiblePlaneList::AddToIndex(VisiblePlane *pl)
+	{
+		unsigned hash = CalcIndexHash(pl);
+		pl->indexnext = planeindex[hash];
+		planeindex[hash] = pl;
+	}
+
 	void VisiblePlaneList::Clear()
 	{
 		for (int i = 0; i <= MAXVISPLANES; i++)
 			visplanes[i] = nullptr;
+
+		UseIndex = r_planeindex;
+		if (UseIndex)
+		{
+			for (auto &pl : planeindex)
+				pl = nullptr;
+		}
+
+		if (Thread->MainThread)
+		{
+			lastsearches = planesearches;
+			lastprobes = planeprobes;
+			lastcount = planecount;
+			planesearches = planeprobes = planecount = 0;
+		}
 	}
 
 	void VisiblePlaneList::ClearKeepFakePlanes()
@@ -97,6 +151,23 @@ namespace swrenderer
 				}
 			}
 		}
+
+		if (UseIndex)
+		{
+			// Reindex the fake planes that are left, oldest first so the buckets stay newest first.
+			for (auto &pl : planeindex)
+				pl = nullptr;
+
+			TArray<VisiblePlane *> chain;
+			for (int i = 0; i < MAXVISPLANES; i++)
+			{
+				chain.Clear();
+				for (VisiblePlane *pl = visplanes[i]; pl != nullptr; pl = pl->next)
+					chain.Push(pl);
+				for (int j = (int)chain.Size() - 1; j >= 0; j--)
+					AddToIndex(chain[j]);
+			}
+		}
 	}
 
 	VisiblePlane *VisiblePlaneList::FindPlane(const secplane_t &height, FTextureID picnum, int lightlevel, bool foggy, double Alpha, bool additive, const FTransform &xxform, int sky, FSectorPortal *portal, FDynamicColormap *basecolormap, Fake3DOpaque::Type fakeFloorType, fixed_t fakeAlpha)
@@ -150,62 +221,91 @@ namespace swrenderer
 
 		// New visplane algorithm uses hash table -- killough
 		hash = isskybox ? ((unsigned)MAXVISPLANES) : CalcHash(picnum.GetIndex(), lightlevel, height);
-		
-		for (check = visplanes[hash]; check; check = check->next)	// killough
+
+		if (Thread->MainThread) planesearches++;
+
+		if (UseIndex && !isskybox)
+		{
+			unsigned indexhash = CalcIndexHash(hash, picnum.GetIndex(), lightlevel, plane, sky, renderportal->CurrentPortalUniq, basecolormap);
+			for (check = planeindex[indexhash]; check; check = check->indexnext)
+			{
+				if (Thread->MainThread) planeprobes++;
+				if (hash == check->chain &&
+					plane == check->height &&
+					picnum == check->picnum &&
+					lightlevel == check->lightlevel &&
+					basecolormap == check->colormap &&
+					*xform == check->xform &&
+					sky == check->sky &&
+					renderportal->CurrentPortalUniq == check->CurrentPortalUniq &&
+					renderportal->MirrorFlags == check->MirrorFlags &&
+					Thread->Clip3D->CurrentSkybox == check->CurrentSkybox &&
+					Thread->Viewport->viewpoint.Pos == check->viewpos
+					)
+				{
+					return check;
+				}
+			}
+		}
+		else
 		{
-			if (isskybox)
+			for (check = visplanes[hash]; check; check = check->next)	// killough
 			{
-				if (portal == check->portal && plane == check->height)
+				if (Thread->MainThread) planeprobes++;
+				if (isskybox)
 				{
-					if (portal->mType != PORTS_SKYVIEWPOINT)
-					{ // This skybox is really a stacked sector, so we need to
-					  // check even more.
-						if (check->extralight == renderportal->stacked_extralight &&
-							check->visibility == renderportal->stacked_visibility &&
-							check->viewpos == renderportal->stacked_viewpos &&
-							(
-								// headache inducing logic... :(
-								(portal->mType != PORTS_STACKEDSECTORTHING) ||
+					if (portal == check->portal && plane == check->height)
+					{
+						if (portal->mType != PORTS_SKYVIEWPOINT)
+						{ // This skybox is really a stacked sector, so we need to
+						  // check even more.
+							if (check->extralight == renderportal->stacked_extralight &&
+								check->visibility == renderportal->stacked_visibility &&
+								check->viewpos == renderportal->stacked_viewpos &&
 								(
-									check->Alpha == alpha &&
-									check->Additive == additive &&
-									(alpha == 0 ||	// if alpha is > 0 everything needs to be checked
-									(plane == check->height &&
-										picnum == check->picnum &&
-										lightlevel == check->lightlevel &&
-										basecolormap == check->colormap &&	// [RH] Add more checks
-										*xform == check->xform
+									// headache inducing logic... :(
+									(portal->mType != PORTS_STACKEDSECTORTHING) ||
+									(
+										check->Alpha == alpha &&
+										check->Additive == additive &&
+										(alpha == 0 ||	// if alpha is > 0 everything needs to be checked
+										(plane == check->height &&
+											picnum == check->picnum &&
+											lightlevel == check->lightlevel &&
+											basecolormap == check->colormap &&	// [RH] Add more checks
+											*xform == check->xform
+											)
+											) &&
+										check->viewangle == renderportal->stacked_angle.Yaw
 										)
-										) &&
-									check->viewangle == renderportal->stacked_angle.Yaw
 									)
 								)
-							)
+							{
+								return check;
+							}
+						}
+						else
 						{
 							return check;
 						}
 					}
-					else
+				}
+				else
+					if (plane == check->height &&
+						picnum == check->picnum &&
+						lightlevel == check->lightlevel &&
+						basecolormap == check->colormap &&	// [RH] Add more checks
+						*xform == check->xform &&
+						sky == check->sky &&
+						renderportal->CurrentPortalUniq == check->CurrentPortalUniq &&
+						renderportal->MirrorFlags == check->MirrorFlags &&
+						Thread->Clip3D->CurrentSkybox == check->CurrentSkybox &&
+						Thread->Viewport->viewpoint.Pos == check->viewpos
+						)
 					{
 						return check;
 					}
-				}
 			}
-			else
-				if (plane == check->height &&
-					picnum == check->picnum &&
-					lightlevel == check->lightlevel &&
-					basecolormap == check->colormap &&	// [RH] Add more checks
-					*xform == check->xform &&
-					sky == check->sky &&
-					renderportal->CurrentPortalUniq == check->CurrentPortalUniq &&
-					renderportal->MirrorFlags == check->MirrorFlags &&
-					Thread->Clip3D->CurrentSkybox == check->CurrentSkybox &&
-					Thread->Viewport->viewpoint.Pos == check->viewpos
-					)
-				{
-					return check;
-				}
 		}
 
 		check = Add(hash);		// killough
@@ -227,6 +327,9 @@ namespace swrenderer
 		check->MirrorFlags = renderportal->MirrorFlags;
 		check->CurrentSkybox = Thread->Clip3D->CurrentSkybox;
 
+		if (UseIndex && !isskybox)
+			AddToIndex(check);
+
 		return check;
 	}
 
@@ -274,10 +377,12 @@ namespace swrenderer
 		{
 			// make a new visplane
 			unsigned hash;
+			bool isskybox = false;
 
 			if (pl->portal != nullptr && !Thread->Portal->InSkyBox(pl->portal) && viewactive)
 			{
 				hash = MAXVISPLANES;
+				isskybox = true;
 			}
 			else
 			{
@@ -302,6 +407,8 @@ namespace swrenderer
 			new_pl->MirrorFlags = pl->MirrorFlags;
 			new_pl->CurrentSkybox = pl->CurrentSkybox;
 			new_pl->lights = pl->lights;
+			if (UseIndex && !isskybox)
+				AddToIndex(new_pl);
 			pl = new_pl;
 			pl->left = start;
 			pl->right = stop;
@@ -55,10 +55,27 @@ namespace swrenderer
 	private:
 		VisiblePlaneList();
 		VisiblePlane *Add(unsigned hash);
+		void AddToIndex(VisiblePlane *pl);
 
 		enum { MAXVISPLANES = 128 }; // must be a power of 2
 		VisiblePlane *visplanes[MAXVISPLANES + 1];
 
 		static unsigned CalcHash(int picnum, int lightlevel, const secplane_t &height) { return (unsigned)((picnum) * 3 + (lightlevel)+(FLOAT2FIXED((height).fD())) * 7) & (MAXVISPLANES - 1); }
+
+		// Finer index over the planes in visplanes[0..MAXVISPLANES-1]. Open maps
+		// can have thousands of visplanes, which makes the chains above long.
+		// The bucket depends on the hash chain as well as on the compared fields,
+		// because the chain is keyed by the sector's height while sky planes are
+		// stored with D=0. Skies at different heights go to different chains, so
+		// they must not be found through the index either. Planes that FindPlane
+		// would consider equal and that share a chain always share a bucket, and
+		// each bucket is newest first like the chains, so the index finds the
+		// same plane a chain walk would.
+		enum { PLANEINDEXSIZE = 2048 }; // must be a power of 2
+		VisiblePlane *planeindex[PLANEINDEXSIZE];
+		bool UseIndex = false;
+
+		static unsigned CalcIndexHash(const VisiblePlane *pl);
+		static unsigned CalcIndexHash(unsigned chain, int picnum, int lightlevel, const secplane_t &height, int sky, int portaluniq, FDynamicColormap *colormap);
 	};
 }
@@ -54,6 +54,11 @@
 #include "imagehelpers.h"
 #include "texturemanager.h"
 #include "d_main.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "c_dispatch.h"
+#include "sc_man.h"
+#include "i_time.h"
 
 // [BB] Use ZDoom's freelook limit for the software renderer.
 // Note: ZDoom's limit is chosen such that the sky is rendered properly.
@@ -214,6 +219,17 @@ void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int wi
 	DoWriteSavePic(file, SS_PAL, pic.GetPixels(), width, height, r_viewpoint.sector, false);
 }
 
+// Returns the number of threads the view was rendered with.
+int FSoftwareRenderer::RenderBenchmarkView(AActor *actor, DCanvas *canvas)
+{
+	mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
+	mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
+	mScene.RenderViewToCanvas(actor, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight());
+	r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
+	r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
+	return mScene.NumThreads();
+}
+
 void FSoftwareRenderer::DrawRemainingPlayerSprites()
 {
 	mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
@@ -277,3 +293,206 @@ void FSoftwareRenderer::SetColormap(FLevelLocals *Level)
 	}
 }
 
+//==========================================================================
+//
+// CCMD swbench
+//
+// Renders a list of views into offscreen canvases with the palette drawers
+// and then with the truecolor ones, and prints where the time went. This
+// works no matter which renderer is active, so it needs no software
+// video mode.
+//
+// swbench [camera file] [golden prefix] [width] [height] [repeats]
+//
+// The camera file has one "x y z yaw pitch" view per line, with z being the
+// eye height. Without one ("-") the current view is turned around in 8
+// steps. With a golden prefix every frame is compared with the one stored
+// as <prefix>_<view>_<pal|rgb>.raw, which is written if it doesn't exist
+// yet. For scripts: +map MAP01 +wait 1 +swbench views.txt golden/map01 +quit
+//
+// The views are set up by moving the player, which changes the order of
+// the sector and blockmap links, so this is refused in netgames and
+// demos. With several scene threads the pass times only cover the main
+// thread's slice, and waiting for the other threads ends up in "other".
+//
+//==========================================================================
+
+CCMD(swbench)
+{
+	struct BenchView
+	{
+		DVector3 pos;
+		DAngle yaw, pitch;
+	};
+
+	player_t *player = &players[consoleplayer];
+	AActor *mo = player->mo;
+	if (gamestate != GS_LEVEL || mo == nullptr || SWRenderer == nullptr)
+	{
+		Printf("swbench can only be used in a level\n");
+		return;
+	}
+	if (netgame || demoplayback || demorecording)
+	{
+		Printf("swbench cannot be used in netgames or demos\n");
+		return;
+	}
+
+	const char *viewfile = argv.argc() > 1 && strcmp(argv[1], "-") ? argv[1] : nullptr;
+	const char *golden = argv.argc() > 2 ? argv[2] : nullptr;
+	const int width = argv.argc() > 3 ? clamp(atoi(argv[3]), 64, MAXWIDTH) : 640;
+	const int height = argv.argc() > 4 ? clamp(atoi(argv[4]), 48, MAXHEIGHT) : 400;
+	const int repeats = argv.argc() > 5 ? clamp(atoi(argv[5]), 1, 1000) : 4;
+
+	TArray<BenchView> views;
+	if (viewfile != nullptr)
+	{
+		FScanner sc;
+		if (!sc.OpenFile(viewfile))
+		{
+			Printf("Could not open %s\n", viewfile);
+			return;
+		}
+		while (sc.GetFloat())
+		{
+			BenchView view;
+			view.pos.X = sc.Float;
+			sc.MustGetFloat();
+			view.pos.Y = sc.Float;
+			sc.MustGetFloat();
+			view.pos.Z = sc.Float;
+			sc.MustGetFloat();
+			view.yaw = DAngle::fromDeg(sc.Float);
+			sc.MustGetFloat();
+			view.pitch = DAngle::fromDeg(sc.Float);
+			views.Push(view);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			views.Push({ DVector3(mo->Pos().XY(), player->viewz), mo->Angles.Yaw + DAngle::fromDeg(i * 45.), mo->Angles.Pitch });
+		}
+	}
+	if (views.Size() == 0)
+	{
+		Printf("No views in %s\n", viewfile);
+		return;
+	}
+
+	// Move the player around for the views and put everything back afterwards.
+	const DVector3 savedpos = mo->Pos();
+	const DVector3 savedprev = mo->Prev;
+	const DRotator savedangles = mo->Angles;
+	const DRotator savedprevangles = mo->PrevAngles;
+	const double savedviewz = player->viewz;
+	AActor *savedcamera = player->camera;
+	player->camera = mo;
+
+	auto renderer = static_cast<FSoftwareRenderer *>(SWRenderer);
+	int mismatches = 0;
+	for (int bgra = 0; bgra < 2; bgra++)
+	{
+		const char *mode = bgra ? "rgb" : "pal";
+		const int pixelsize = bgra ? 4 : 1;
+		DCanvas canvas(width, height, !!bgra);
+		double total = 0, opaque = 0, planes = 0, translucent = 0;
+		const char *passes = "";
+
+		for (unsigned v = 0; v < views.Size(); v++)
+		{
+			auto &view = views[v];
+			mo->SetOrigin(DVector3(view.pos.XY(), view.pos.Z - (savedviewz - savedpos.Z)), false);
+			mo->Angles.Yaw = view.yaw;
+			mo->Angles.Pitch = view.pitch;
+			mo->ClearInterpolation();
+			player->viewz = view.pos.Z;
+
+			double frame = 0, frameopaque = 0, frameplanes = 0, frametranslucent = 0;
+			for (int r = 0; r < repeats; r++)
+			{
+				r_NoInterpolate = true;
+				const uint64_t start = I_nsTime();
+				passes = renderer->RenderBenchmarkView(mo, &canvas) > 1 ? "main thread: " : "";
+				frame += (I_nsTime() - start) * 1e-6;
+				frameopaque += swrenderer::WallCycles.TimeMS();
+				frameplanes += swrenderer::PlaneCycles.TimeMS();
+				frametranslucent += swrenderer::MaskedCycles.TimeMS();
+			}
+			frame /= repeats;
+			frameopaque /= repeats;
+			frameplanes /= repeats;
+			frametranslucent /= repeats;
+			Printf("%s view %d: %.2f ms  %sopaque %.2f  planes %.2f  translucent %.2f  other %.2f\n", mode, v,
+				frame, passes, frameopaque, frameplanes, frametranslucent, max(frame - frameopaque - frameplanes - frametranslucent, 0.));
+			total += frame;
+			opaque += frameopaque;
+			planes += frameplanes;
+			translucent += frametranslucent;
+
+			if (golden == nullptr) continue;
+
+			const unsigned rowsize = width * pixelsize;
+			TArray<uint8_t> pixels(rowsize * height, true);
+			for (int y = 0; y < height; y++)
+			{
+				memcpy(&pixels[y * rowsize], canvas.GetPixels() + y * canvas.GetPitch() * pixelsize, rowsize);
+			}
+
+			FString filename;
+			filename.Format("%s_%02d_%s.raw", golden, v, mode);
+			FileReader fr;
+			if (fr.OpenFile(filename))
+			{
+				TArray<uint8_t> expected(pixels.Size(), true);
+				if (fr.GetLength() != (long)pixels.Size() || fr.Read(expected.Data(), expected.Size()) != (long)expected.Size())
+				{
+					Printf(TEXTCOLOR_RED "%s has the wrong size for %dx%d\n", filename.GetChars(), width, height);
+					mismatches++;
+					continue;
+				}
+				int differ = 0;
+				for (unsigned i = 0; i < pixels.Size(); i += pixelsize)
+				{
+					if (memcmp(&pixels[i], &expected[i], pixelsize)) differ++;
+				}
+				if (differ > 0)
+				{
+					Printf(TEXTCOLOR_RED "%s view %d: %d pixels differ from %s\n", mode, v, differ, filename.GetChars());
+					mismatches++;
+				}
+			}
+			else
+			{
+				auto fw = FileWriter::Open(filename);
+				if (fw == nullptr)
+				{
+					Printf(TEXTCOLOR_RED "Could not write %s\n", filename.GetChars());
+					continue;
+				}
+				fw->Write(pixels.Data(), pixels.Size());
+				delete fw;
+				Printf("Stored %s\n", filename.GetChars());
+			}
+		}
+
+		const double count = views.Size();
+		Printf("%s average of %d views at %dx%d: %.2f ms  %sopaque %.2f  planes %.2f  translucent %.2f  other %.2f\n", mode, views.Size(), width, height,
+			total / count, passes, opaque / count, planes / count, translucent / count, max(total - opaque - planes - translucent, 0.) / count);
+	}
+
+	mo->SetOrigin(savedpos, false);
+	mo->Prev = savedprev;
+	mo->Angles = savedangles;
+	mo->PrevAngles = savedprevangles;
+	player->viewz = savedviewz;
+	player->camera = savedcamera;
+	r_NoInterpolate = true;
+
+	if (golden != nullptr)
+	{
+		if (mismatches == 0) Printf("All frames match the golden images\n");
+		else Printf(TEXTCOLOR_RED "%d frames differ from the golden images\n", mismatches);
+	}
+}
@@ -23,6 +23,9 @@ struct FSoftwareRenderer : public FRenderer
 	void SetClearColor(int color) override;
 	void RenderTextureView (FCanvasTexture *tex, AActor *viewpoint, double fov);
 
+	// renders an actor's view into a canvas for the swbench command
+	int RenderBenchmarkView(AActor *actor, DCanvas *canvas);
+
 	void SetColormap(FLevelLocals *Level) override;
 	void Init() override;
 
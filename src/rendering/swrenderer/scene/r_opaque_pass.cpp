@@ -336,6 +336,19 @@ namespace swrenderer
 	// Checks BSP node/subtree bounding box.
 	// Returns true if some part of the bbox might be visible.
 	bool RenderOpaquePass::CheckBBox(float *bspcoord)
+	{
+		int sx1, sx2;
+		switch (ProjectBBox(bspcoord, sx1, sx2))
+		{
+		case BBoxVisibility::Always: return true;
+		case BBoxVisibility::Partial: return Thread->ClipSegments->IsVisible(sx1, sx2);
+		default: return false;
+		}
+	}
+
+	// Finds the screen columns covered by a bbox. This part of the check
+	// doesn't depend on what has been drawn so far.
+	BBoxVisibility RenderOpaquePass::ProjectBBox(float *bspcoord, int &sx1, int &sx2)
 	{
 		static const int checkcoord[12][4] =
 		{
@@ -358,7 +371,6 @@ namespace swrenderer
 
 		double	 			x1, y1, x2, y2;
 		double				rx1, ry1, rx2, ry2;
-		int					sx1, sx2;
 
 		// Find the corners of the box
 		// that define the edges from current viewpoint.
@@ -378,7 +390,7 @@ namespace swrenderer
 
 		boxpos = (boxy << 2) + boxx;
 		if (boxpos == 5)
-			return true;
+			return BBoxVisibility::Always;
 
 		x1 = bspcoord[checkcoord[boxpos][0]] - Thread->Viewport->viewpoint.Pos.X;
 		y1 = bspcoord[checkcoord[boxpos][1]] - Thread->Viewport->viewpoint.Pos.Y;
@@ -389,7 +401,7 @@ namespace swrenderer
 
 		// Sitting on a line?
 		if (y1 * (x1 - x2) + x1 * (y2 - y1) >= -EQUAL_EPSILON)
-			return true;
+			return BBoxVisibility::Always;
 
 		rx1 = x1 * Thread->Viewport->viewpoint.Sin - y1 * Thread->Viewport->viewpoint.Cos;
 		rx2 = x2 * Thread->Viewport->viewpoint.Sin - y2 * Thread->Viewport->viewpoint.Cos;
@@ -408,34 +420,35 @@ namespace swrenderer
 
 		if (rx1 >= -ry1)
 		{
-			if (rx1 > ry1) return false;	// left edge is off the right side
-			if (ry1 == 0) return false;
+			if (rx1 > ry1) return BBoxVisibility::Culled;	// left edge is off the right side
+			if (ry1 == 0) return BBoxVisibility::Culled;
 			sx1 = xs_RoundToInt(viewport->CenterX + rx1 * viewport->CenterX / ry1);
 		}
 		else
 		{
-			if (rx2 < -ry2) return false;	// wall is off the left side
-			if (rx1 - rx2 - ry2 + ry1 == 0) return false;	// wall does not intersect view volume
+			if (rx2 < -ry2) return BBoxVisibility::Culled;	// wall is off the left side
+			if (rx1 - rx2 - ry2 + ry1 == 0) return BBoxVisibility::Culled;	// wall does not intersect view volume
 			sx1 = 0;
 		}
 
 		if (rx2 <= ry2)
 		{
-			if (rx2 < -ry2) return false;	// right edge is off the left side
-			if (ry2 == 0) return false;
+			if (rx2 < -ry2) return BBoxVisibility::Culled;	// right edge is off the left side
+			if (ry2 == 0) return BBoxVisibility::Culled;
 			sx2 = xs_RoundToInt(viewport->CenterX + rx2 * viewport->CenterX / ry2);
 		}
 		else
 		{
-			if (rx1 > ry1) return false;	// wall is off the right side
-			if (ry2 - ry1 - rx2 + rx1 == 0) return false;	// wall does not intersect view volume
+			if (rx1 > ry1) return BBoxVisibility::Culled;	// wall is off the right side
+			if (ry2 - ry1 - rx2 + rx1 == 0) return BBoxVisibility::Culled;	// wall does not intersect view volume
 			sx2 = viewwidth;
 		}
 
-		// Find the first clippost that touches the source post
-		//	(adjacent pixels are touching).
+		// Does not cross a pixel.
+		if (sx2 <= sx1)
+			return BBoxVisibility::Culled;
 
-		return Thread->ClipSegments->IsVisible(sx1, sx2);
+		return BBoxVisibility::Partial;
 	}
 
 	void RenderOpaquePass::AddPolyobjs(subsector_t *sub)
@@ -612,7 +625,7 @@ namespace swrenderer
 		if ((unsigned int)(sub->Index()) < Level->subsectors.Size())
 		{ // Only do it for the main BSP.
 			int lightlevel = (floorlightlevel + ceilinglightlevel) / 2;
-			for (int i = frontsector->Level->ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = frontsector->Level->Particles[i].snext)
+			for (uint32_t i = frontsector->Level->ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = frontsector->Level->Particles[i].snext)
 			{
 				RenderParticle::Project(Thread, &frontsector->Level->Particles[i], sub->sector, lightlevel, FakeSide, foggy);
 			}
@@ -815,7 +828,7 @@ namespace swrenderer
 		}
 	}
 
-	void RenderOpaquePass::RenderScene(FLevelLocals *Level)
+	void RenderOpaquePass::RenderScene(FLevelLocals *Level, const std::vector<BSPWalkEntry> *walk)
 	{
 		if (Thread->MainThread)
 			WallCycles.Clock();
@@ -829,12 +842,89 @@ namespace swrenderer
 		SeenActors.clear();
 
 		InSubsector = nullptr;
-		RenderBSPNode(Level->HeadNode());	// The head node is the last node output.
+		if (walk == nullptr)
+		{
+			RenderBSPNode(Level->HeadNode());	// The head node is the last node output.
+		}
+		else
+		{
+			// Same order and culling as RenderBSPNode, minus the work every thread would repeat.
+			const int x1 = Thread->X1;
+			const int x2 = Thread->X2;
+			const int count = (int)walk->size();
+			int i = 0;
+			while (i < count)
+			{
+				const BSPWalkEntry &entry = (*walk)[i];
+				if (entry.Sub != nullptr)
+				{
+					RenderSubsector(entry.Sub);
+					i++;
+				}
+				else if (entry.SX2 > x1 && entry.SX1 < x2 && Thread->ClipSegments->IsVisible(entry.SX1, entry.SX2))
+				{
+					i++;
+				}
+				else
+				{
+					i = entry.Skip;
+				}
+			}
+		}
 
 		if (Thread->MainThread)
 			WallCycles.Unclock();
 	}
 
+	//
+	// BuildBSPWalk
+	// Records the order RenderBSPNode would visit the subsectors in, keeping
+	// the boxes whose culling depends on the clip segments as guards. The
+	// render threads of a frame all share the same walk.
+	//
+
+	void RenderOpaquePass::BuildBSPWalk(FLevelLocals *Level, std::vector<BSPWalkEntry> &walk)
+	{
+		walk.clear();
+		if (Level->nodes.Size() == 0)
+		{
+			walk.push_back({ &Level->subsectors[0], 0, 0, 1 });
+		}
+		else
+		{
+			AddBSPWalkNode(Level->HeadNode(), walk);
+		}
+	}
+
+	void RenderOpaquePass::AddBSPWalkNode(void *node, std::vector<BSPWalkEntry> &walk)
+	{
+		while (!((size_t)node & 1))
+		{
+			node_t *bsp = (node_t *)node;
+
+			int side = R_PointOnSide(Thread->Viewport->viewpoint.Pos, bsp);
+			AddBSPWalkNode(bsp->children[side], walk);
+
+			side ^= 1;
+			int sx1, sx2;
+			BBoxVisibility visibility = ProjectBBox(bsp->bbox[side], sx1, sx2);
+			if (visibility == BBoxVisibility::Culled)
+				return;
+
+			if (visibility == BBoxVisibility::Partial)
+			{
+				int guard = (int)walk.size();
+				walk.push_back({ nullptr, sx1, sx2, 0 });
+				AddBSPWalkNode(bsp->children[side], walk);
+				walk[guard].Skip = (int)walk.size();
+				return;
+			}
+
+			node = bsp->children[side];
+		}
+		walk.push_back({ (subsector_t *)((uint8_t *)node - 1), 0, 0, 0 });
+	}
+
 	//
 	// RenderBSPNode
 	// Renders all subsectors below a given node, traversing subtree recursively.
@@ -58,13 +58,31 @@ namespace swrenderer
 		int renderflags;
 	};
 
+	enum class BBoxVisibility
+	{
+		Culled,
+		Partial,	// visible if the clip segments leave anything of sx1 to sx2 open
+		Always
+	};
+
+	// One step of a front to back walk of the BSP as seen from the main view.
+	// A box entry guards the entries after it up to Skip, which a thread can
+	// jump over if its clip segments cover SX1 to SX2.
+	struct BSPWalkEntry
+	{
+		subsector_t *Sub;	// nullptr for a box
+		int SX1, SX2;
+		int Skip;
+	};
+
 	class RenderOpaquePass
 	{
 	public:
 		RenderOpaquePass(RenderThread *thread);
 
 		void ClearClip();
-		void RenderScene(FLevelLocals *Level);
+		void RenderScene(FLevelLocals *Level, const std::vector<BSPWalkEntry> *walk = nullptr);
+		void BuildBSPWalk(FLevelLocals *Level, std::vector<BSPWalkEntry> &walk);
 
 		void ResetFakingUnderwater() { r_fakingunderwater = false; }
 		sector_t *FakeFlat(sector_t *sec, sector_t *tempsec, int *floorlightlevel, int *ceilinglightlevel, seg_t *backline, int backx1, int backx2, double frontcz1, double frontcz2);
@@ -82,6 +100,8 @@ namespace swrenderer
 		void RenderBSPNode(void *node);
 		void RenderSubsector(subsector_t *sub);
 		bool CheckBBox(float *bspcoord);
+		BBoxVisibility ProjectBBox(float *bspcoord, int &sx1, int &sx2);
+		void AddBSPWalkNode(void *node, std::vector<BSPWalkEntry> &walk);
 
 		void AddPolyobjs(subsector_t *sub);
 
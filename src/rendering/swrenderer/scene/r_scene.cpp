@@ -57,17 +57,29 @@
 #include "r_memory.h"
 #include "swrenderer/r_renderthread.h"
 #include "swrenderer/things/r_playersprite.h"
+#include "i_time.h"
 #include <chrono>
 
 EXTERN_CVAR(Int, r_clearbuffer)
 EXTERN_CVAR(Int, r_debug_draw)
 
 CVAR(Int, r_scene_multithreaded, 1, 0);
+CVAR(Bool, r_scene_balance, true, 0);
+CVAR(Bool, r_scene_sharedbsp, true, 0);
 CVAR(Bool, r_models, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 
 namespace swrenderer
 {
 	cycle_t WallCycles, PlaneCycles, MaskedCycles;
+
+	struct SliceStat
+	{
+		int x1, x2;
+		uint64_t time;
+	};
+	static std::vector<SliceStat> slicestats;
+	static uint64_t bspwalktime;
+	static size_t bspwalksize;
 	
 	RenderScene::RenderScene()
 	{
@@ -188,12 +200,22 @@ namespace swrenderer
 
 		// Setup threads:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
+		SetupSlices(numThreads);
 		for (int i = 0; i < numThreads; i++)
 		{
 			*Threads[i]->Viewport = *MainThread()->Viewport;
 			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+		}
+
+		// With one thread there is nothing to share.
+		UseBSPWalk = r_scene_sharedbsp && numThreads > 1;
+		if (UseBSPWalk)
+		{
+			uint64_t start = I_nsTime();
+			MainThread()->Portal->SetMainPortal();
+			MainThread()->OpaquePass->BuildBSPWalk(MainThread()->Viewport->Level(), BSPWalk);
+			bspwalktime = I_nsTime() - start;
+			bspwalksize = BSPWalk.size();
 		}
 		run_id++;
 		FSoftwareTexture::CurrentUpdate = run_id;
@@ -221,13 +243,97 @@ namespace swrenderer
 			finished_threads = 0;
 		}
 
+		if (!MainThread()->Viewport->RenderingToCanvas)
+		{
+			SliceBounds.resize(numThreads + 1);
+			SliceTimes.resize(numThreads);
+			slicestats.resize(numThreads);
+			for (int i = 0; i < numThreads; i++)
+			{
+				SliceBounds[i] = Threads[i]->X1;
+				SliceTimes[i] = Threads[i]->SliceTime;
+				slicestats[i] = { Threads[i]->X1, Threads[i]->X2, Threads[i]->SliceTime };
+			}
+			SliceBounds[numThreads] = viewwidth;
+		}
+
 		// Change main thread back to covering the whole screen for player sprites
 		MainThread()->X1 = 0;
 		MainThread()->X2 = viewwidth;
 	}
 
+	//==========================================================================
+	//
+	// Picks the columns each thread renders. With r_scene_balance the strips
+	// of the main view are sized so that every thread would have taken the
+	// same time on the last frame, assuming the cost is spread evenly over
+	// each strip. The boundaries only move half way there per frame, so that
+	// one odd frame doesn't throw the balance off.
+	//
+	//==========================================================================
+
+	void RenderScene::SetupSlices(int numThreads)
+	{
+		auto equalSlices = [&]()
+		{
+			for (int i = 0; i < numThreads; i++)
+			{
+				Threads[i]->X1 = viewwidth * i / numThreads;
+				Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			}
+		};
+
+		if (!r_scene_balance || numThreads == 1 || viewwidth < numThreads * 2 || MainThread()->Viewport->RenderingToCanvas ||
+			SliceBounds.size() != size_t(numThreads + 1) || SliceBounds.back() != viewwidth)
+		{
+			equalSlices();
+			return;
+		}
+
+		double total = 0;
+		for (int i = 0; i < numThreads; i++)
+		{
+			total += max(SliceTimes[i], (uint64_t)1);
+		}
+
+		const int minwidth = max(1, viewwidth / (numThreads * 8));
+		std::vector<int> bounds(numThreads + 1);
+		bounds[0] = 0;
+		bounds[numThreads] = viewwidth;
+		int strip = 0;
+		double stripstart = 0;
+		for (int i = 1; i < numThreads; i++)
+		{
+			double target = total * i / numThreads;
+			while (strip < numThreads - 1 && stripstart + max(SliceTimes[strip], (uint64_t)1) < target)
+			{
+				stripstart += max(SliceTimes[strip], (uint64_t)1);
+				strip++;
+			}
+			double frac = clamp((target - stripstart) / max(SliceTimes[strip], (uint64_t)1), 0., 1.);
+			double x = SliceBounds[strip] + frac * (SliceBounds[strip + 1] - SliceBounds[strip]);
+			x = SliceBounds[i] + (x - SliceBounds[i]) * 0.5;
+			bounds[i] = int(x + 0.5);
+		}
+		for (int i = 1; i < numThreads; i++)
+		{
+			bounds[i] = max(bounds[i], bounds[i - 1] + minwidth);
+		}
+		for (int i = numThreads - 1; i > 0; i--)
+		{
+			bounds[i] = min(bounds[i], bounds[i + 1] - minwidth);
+		}
+
+		for (int i = 0; i < numThreads; i++)
+		{
+			Threads[i]->X1 = bounds[i];
+			Threads[i]->X2 = bounds[i + 1];
+		}
+	}
+
 	void RenderScene::RenderThreadSlice(RenderThread *thread)
 	{
+		uint64_t start = I_nsTime();
 		thread->FrameMemory->Clear();
 		thread->Clip3D->Cleanup();
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
@@ -247,7 +353,7 @@ namespace swrenderer
 		if (thread->X2 < viewwidth)
 			thread->ClipSegments->Clip(thread->X2, viewwidth, true, &visitor);
 
-		thread->OpaquePass->RenderScene(thread->Viewport->Level());
+		thread->OpaquePass->RenderScene(thread->Viewport->Level(), UseBSPWalk ? &BSPWalk : nullptr);
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
 
 		if (viewactive)
@@ -291,6 +397,7 @@ namespace swrenderer
 			}
 		}
 #endif
+		thread->SliceTime = I_nsTime() - start;
 	}
 
 	void RenderScene::StartThreads(size_t numThreads)
@@ -413,6 +520,29 @@ namespace swrenderer
 		return out;
 	}
 
+	ADD_STAT(swthreads)
+	{
+		FString out;
+		if (slicestats.size() == 0)
+		{
+			return "No multithreaded software frame rendered yet";
+		}
+		uint64_t total = 0, longest = 0;
+		for (size_t i = 0; i < slicestats.size(); i++)
+		{
+			auto &slice = slicestats[i];
+			out.AppendFormat("thread %d: columns %d-%d (%d)  %.2f ms\n", (int)i, slice.x1, slice.x2 - 1, slice.x2 - slice.x1, slice.time * 1e-6);
+			total += slice.time;
+			longest = max(longest, slice.time);
+		}
+		out.AppendFormat("slowest thread %.0f%% of the average\n", 100. * longest * slicestats.size() / max(total, (uint64_t)1));
+		if (r_scene_sharedbsp)
+			out.AppendFormat("shared BSP walk: %d entries, %.2f ms", (int)bspwalksize, bspwalktime * 1e-6);
+		else
+			out.AppendFormat("shared BSP walk off");
+		return out;
+	}
+
 	static double bestwallcycles = HUGE_VAL;
 
 	ADD_STAT(wallcycles)
@@ -37,6 +37,7 @@ namespace swrenderer
 	extern cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
 
 	class RenderThread;
+	struct BSPWalkEntry;
 	
 	class RenderScene
 	{
@@ -54,11 +55,13 @@ namespace swrenderer
 		bool DontMapLines() const { return dontmaplines; }
 
 		RenderThread *MainThread() { return Threads.front().get(); }
+		int NumThreads() const { return (int)Threads.size(); }
 
 	private:
 		void RenderActorView(AActor *actor,bool renderplayersprite, bool dontmaplines);
 		void RenderThreadSlices();
 		void RenderThreadSlice(RenderThread *thread);
+		void SetupSlices(int numThreads);
 		void RenderPSprites();
 
 		void StartThreads(size_t numThreads);
@@ -67,6 +70,14 @@ namespace swrenderer
 		bool dontmaplines = false;
 		int clearcolor = 0;
 
+		// Slice boundaries and times of the last main view, for balancing the next one.
+		std::vector<int> SliceBounds;
+		std::vector<uint64_t> SliceTimes;
+
+		// Front to back BSP walk of the main view, built once and shared by the threads.
+		std::vector<BSPWalkEntry> BSPWalk;
+		bool UseBSPWalk = false;
+
 		std::vector<std::unique_ptr<RenderThread>> Threads;
 		std::mutex start_mutex;
 		std::condition_variable start_condition;
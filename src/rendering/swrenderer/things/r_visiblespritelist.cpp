@@ -33,9 +33,78 @@
 #include "swrenderer/things/r_visiblesprite.h"
 #include "swrenderer/things/r_visiblespritelist.h"
 #include "r_memory.h"
+#include "c_dispatch.h"
+#include "i_time.h"
 
 namespace swrenderer
 {
+	// Below this many sprites std::stable_sort is faster than the radix sort.
+	enum { RADIX_SORT_MIN = 256 };
+
+	// Maps a sort distance to an unsigned key whose ascending order is the
+	// descending order of the distances.
+	static uint32_t SpriteSortKey(float dist)
+	{
+		if (dist == 0.f) dist = 0.f;	// -0 and 0 are equal to the comparison sort
+		uint32_t bits;
+		memcpy(&bits, &dist, sizeof(bits));
+		bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+		return ~bits;
+	}
+
+	// Stable LSD radix sort by descending distance, 11 bits per pass. Being
+	// stable, it puts equal distances in the same order std::stable_sort does.
+	template<typename T, typename Dist>
+	static void RadixSortByDist(T *items, unsigned count, Dist dist)
+	{
+		static thread_local TArray<T> itemscratch;
+		static thread_local TArray<uint32_t> keys, keyscratch;
+		itemscratch.Resize(count);
+		keys.Resize(count);
+		keyscratch.Resize(count);
+
+		unsigned histogram[3][2048] = {};
+		for (unsigned i = 0; i < count; i++)
+		{
+			uint32_t key = SpriteSortKey(dist(items[i]));
+			keys[i] = key;
+			histogram[0][key & 2047]++;
+			histogram[1][(key >> 11) & 2047]++;
+			histogram[2][key >> 22]++;
+		}
+
+		T *src = items, *dst = itemscratch.Data();
+		uint32_t *srckeys = keys.Data(), *dstkeys = keyscratch.Data();
+		for (int pass = 0; pass < 3; pass++)
+		{
+			const int shift = pass * 11;
+			unsigned *offsets = histogram[pass];
+			if (offsets[(srckeys[0] >> shift) & 2047] == count)
+				continue;	// every key has the same digit
+
+			unsigned sum = 0;
+			for (int digit = 0; digit < 2048; digit++)
+			{
+				unsigned n = offsets[digit];
+				offsets[digit] = sum;
+				sum += n;
+			}
+			for (unsigned i = 0; i < count; i++)
+			{
+				unsigned pos = offsets[(srckeys[i] >> shift) & 2047]++;
+				dst[pos] = src[i];
+				dstkeys[pos] = srckeys[i];
+			}
+			std::swap(src, dst);
+			std::swap(srckeys, dstkeys);
+		}
+		if (src != items)
+		{
+			for (unsigned i = 0; i < count; i++)
+				items[i] = src[i];
+		}
+	}
+
 	void VisibleSpriteList::Clear()
 	{
 		Sprites.Clear();
@@ -83,12 +152,17 @@ namespace swrenderer
 				SortedSprites[i] = Sprites[first + count - i - 1];
 		}
 
+		if (count < RADIX_SORT_MIN)
 		{
 			std::stable_sort(&SortedSprites[0], &SortedSprites[count], [](VisibleSprite *a, VisibleSprite *b) -> bool
 			{
 				return a->SortDist() > b->SortDist();
 			});
 		}
+		else
+		{
+			RadixSortByDist(&SortedSprites[0], count, [](VisibleSprite *sprite) { return sprite->SortDist(); });
+		}
 	}
 
 	uint32_t VisibleSpriteList::FindSubsectorDepth(RenderThread *thread, const DVector2 &worldPos)
@@ -122,4 +196,63 @@ namespace swrenderer
 		subsector_t *sub = (subsector_t *)((uint8_t *)node - 1);
 		return thread->OpaquePass->GetSubsectorDepth(sub->Index());
 	}
+
+	//==========================================================================
+	//
+	// CCMD spritesortbench
+	//
+	// Sorts made up sprite distances with std::stable_sort and with the
+	// radix sort. Many sprites share a distance, like the ones of a
+	// particle cloud or of a monster horde standing in line.
+	//
+	// spritesortbench [sprites] [iterations]
+	//
+	//==========================================================================
+
+	CCMD(spritesortbench)
+	{
+		struct BenchSprite
+		{
+			float dist;
+			int index;
+		};
+
+		const int count = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 1000000) : 5000;
+		const int iterations = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 100000) : 100;
+
+		uint32_t seed = 1;
+		TArray<BenchSprite> input(count, true);
+		for (int i = 0; i < count; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			input[i].dist = (seed >> 8) % 4 == 0 ? 1.f / 256.f : (seed >> 8) * (1.f / 16777216.f);
+			input[i].index = i;
+		}
+
+		TArray<BenchSprite> sorted[2];
+		double ms[2];
+		for (int pass = 0; pass < 2; pass++)
+		{
+			TArray<BenchSprite> work(count, true);
+			const uint64_t start = I_nsTime();
+			for (int it = 0; it < iterations; it++)
+			{
+				memcpy(work.Data(), input.Data(), count * sizeof(BenchSprite));
+				if (pass == 0)
+				{
+					std::stable_sort(&work[0], &work[0] + count, [](const BenchSprite &a, const BenchSprite &b) { return a.dist > b.dist; });
+				}
+				else
+				{
+					RadixSortByDist(&work[0], count, [](const BenchSprite &sprite) { return sprite.dist; });
+				}
+			}
+			ms[pass] = (I_nsTime() - start) * 1e-6;
+			sorted[pass] = std::move(work);
+		}
+
+		bool same = memcmp(sorted[0].Data(), sorted[1].Data(), count * sizeof(BenchSprite)) == 0;
+		Printf("%d sprites, %d sorts: stable_sort %.2f ms, radix %.2f ms (%.1fx)%s\n", count, iterations,
+			ms[0], ms[1], ms[0] / max(ms[1], 1e-6), same ? "" : ", results differ");
+	}
 }
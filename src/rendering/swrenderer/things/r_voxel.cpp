@@ -55,11 +55,16 @@
 #include "swrenderer/viewport/r_spritedrawer.h"
 #include "r_memory.h"
 #include "swrenderer/r_renderthread.h"
+#include "swrenderer/r_swrenderer.h"
+#include "c_dispatch.h"
+#include "d_player.h"
 
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor)
 
 namespace swrenderer
 {
+	static bool UseOccupiedRanges = true;
+
 	void RenderVoxel::Project(RenderThread *thread, AActor *thing, DVector3 pos, FVoxelDef *voxel, const DVector2 &spriteScale, int renderflags, WaterFakeSide fakeside, F3DFloor *fakefloor, F3DFloor *fakeceiling, sector_t *current_sector, int lightlevel, bool foggy, FDynamicColormap *basecolormap)
 	{
 		// transform the origin point
@@ -464,7 +469,32 @@ namespace swrenderer
 
 				nx = MulScale(ggxstart + ggxinc[x], viewport->viewingrangerecip, 16) + x1;
 				ny = ggystart + ggyinc[x];
-				for (y = ys; y != ye; y += yi, nx += dagyinc, ny -= dagxinc)
+
+				// Start and stop at the first and last y that have slabs. The
+				// columns skipped are empty and would not draw anything.
+				int ystart = ys, yend = ye;
+				if (UseOccupiedRanges && (yi == 1 || yi == -1))
+				{
+					const int ylo = mip->OccupiedY[x * 2];
+					const int yhi = mip->OccupiedY[x * 2 + 1];
+					if (yi == 1)
+					{
+						ystart = max(ys, ylo);
+						yend = min(ye, yhi);
+						if (ystart >= yend) continue;
+					}
+					else
+					{
+						ystart = min(ys, yhi - 1);
+						yend = max(ye, ylo - 1);
+						if (ystart <= yend) continue;
+					}
+					const unsigned skipped = abs(ystart - ys);
+					nx = int(unsigned(nx) + skipped * unsigned(dagyinc));
+					ny = int(unsigned(ny) - skipped * unsigned(dagxinc));
+				}
+
+				for (y = ystart; y != yend; y += yi, nx += dagyinc, ny -= dagxinc)
 				{
 					if ((ny <= nytooclose) || (ny >= nytoofar)) continue;
 					voxptr = (kvxslab_t *)(slabxoffs + xyoffs[y]);
@@ -1047,4 +1077,52 @@ namespace swrenderer
 		}
 	}
 #endif
+
+	//==========================================================================
+	//
+	// CCMD voxelbench
+	//
+	// Renders the current view offscreen with and without skipping the empty
+	// voxel columns, and compares both the time and the pixels. Use it on a
+	// map with many voxel actors in view.
+	//
+	// voxelbench [frames] [width] [height]
+	//
+	//==========================================================================
+
+	CCMD(voxelbench)
+	{
+		player_t *player = &players[consoleplayer];
+		if (gamestate != GS_LEVEL || player->mo == nullptr || SWRenderer == nullptr)
+		{
+			Printf("voxelbench can only be used in a level\n");
+			return;
+		}
+
+		const int frames = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 1000) : 20;
+		const int width = argv.argc() > 2 ? clamp(atoi(argv[2]), 64, MAXWIDTH) : 640;
+		const int height = argv.argc() > 3 ? clamp(atoi(argv[3]), 48, MAXHEIGHT) : 400;
+
+		auto renderer = static_cast<FSoftwareRenderer *>(SWRenderer);
+		DCanvas canvas[2] = { { width, height, false }, { width, height, false } };
+		double ms[2], maskedms[2];
+		for (int pass = 0; pass < 2; pass++)
+		{
+			UseOccupiedRanges = pass == 1;
+			ms[pass] = maskedms[pass] = 0;
+			for (int i = 0; i < frames; i++)
+			{
+				r_NoInterpolate = true;
+				const uint64_t start = I_nsTime();
+				renderer->RenderBenchmarkView(player->mo, &canvas[pass]);
+				ms[pass] += (I_nsTime() - start) * 1e-6;
+				maskedms[pass] += MaskedCycles.TimeMS();
+			}
+		}
+		UseOccupiedRanges = true;
+
+		bool same = memcmp(canvas[0].GetPixels(), canvas[1].GetPixels(), canvas[0].GetPitch() * height) == 0;
+		Printf("%d frames at %dx%d: full walk %.2f ms (translucent %.2f), occupied ranges %.2f ms (translucent %.2f) per frame%s\n",
+			frames, width, height, ms[0] / frames, maskedms[0] / frames, ms[1] / frames, maskedms[1] / frames, same ? "" : ", results differ");
+	}
 }
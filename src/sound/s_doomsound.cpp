@@ -903,6 +903,8 @@ void S_SerializeSounds(FSerializer &arc)
 				arc(nullptr, *chan);
 				// Sounds always start out evicted when restored from a save.
 				chan->ChanFlags |= CHANF_EVICTED | CHANF_ABSTIME;
+				// The channel was indexed before its sound and priority were read.
+				soundEngine->ReindexChannel(chan);
 			}
 			arc.EndArray();
 		}